@@ -1307,6 +1307,7 @@ bool do_user_addr_fault(struct pt_regs *regs,
 	vm_fault_t fault, major = 0;
 	unsigned int flags = FAULT_FLAG_ALLOW_RETRY | FAULT_FLAG_KILLABLE;
 	bool is_huge = false;
+	bool should_promote;
 	int ret;
 
 	tsk = current;
@@ -1468,7 +1469,7 @@ bool do_user_addr_fault(struct pt_regs *regs,
 	is_huge = !(fault & (VM_FAULT_OOM | VM_FAULT_BASE_PAGE));
 
 	if (is_huge) {
-		mm_register_promotion(address & HPAGE_PMD_MASK);
+		mm_register_promotion(mm, address & HPAGE_PMD_MASK);
 	}
 
 	/*
@@ -1494,17 +1495,25 @@ bool do_user_addr_fault(struct pt_regs *regs,
 		return is_huge;
 	}
 
+	// markm: check if we should promote the recently created page. Check
+	// while we still hold mmap_sem, since the vma may go away after.
+	should_promote = !is_huge && huge_addr_enabled(vma, address);
+
 	up_read(&mm->mmap_sem);
 	if (unlikely(fault & VM_FAULT_ERROR)) {
 		mm_fault_error(regs, hw_error_code, address, fault);
 		return is_huge;
 	}
 
-	// markm: check if we should promote the recently created page.
-	if (!is_huge && huge_addr_enabled(vma, address)) {
+	// Hand the promotion off to the per-node promotion worker, so that we
+	// return as soon as the base page is mapped. If that isn't possible,
+	// do it here.
+	if (should_promote
+		&& !promote_to_huge_async(mm, address & HPAGE_PMD_MASK))
+	{
 		ret = promote_to_huge(mm, vma, address & HPAGE_PMD_MASK, pftrace);
 		if (ret == SCAN_SUCCEED) {
-			mm_register_promotion(address & HPAGE_PMD_MASK);
+			mm_register_promotion(mm, address & HPAGE_PMD_MASK);
 		}
 	}
 
@@ -1590,6 +1599,6 @@ do_page_fault(struct pt_regs *regs, unsigned long error_code, unsigned long addr
 			pftrace.end_tsc - pftrace.start_tsc);
     }
 
-    mm_stats_pftrace_submit(&pftrace, regs);
+    mm_stats_pftrace_submit(&pftrace, regs, address);
 }
 NOKPROBE_SYMBOL(do_page_fault);
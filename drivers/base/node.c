@@ -373,6 +373,7 @@ static ssize_t node_read_meminfo(struct device *dev,
 	n = sprintf(buf,
 		       "Node %d MemTotal:       %8lu kB\n"
 		       "Node %d MemFree:        %8lu kB\n"
+		       "Node %d MemFreeZeroed:  %8lu kB\n"
 		       "Node %d MemUsed:        %8lu kB\n"
 		       "Node %d Active:         %8lu kB\n"
 		       "Node %d Inactive:       %8lu kB\n"
@@ -384,6 +385,7 @@ static ssize_t node_read_meminfo(struct device *dev,
 		       "Node %d Mlocked:        %8lu kB\n",
 		       nid, K(i.totalram),
 		       nid, K(i.freeram),
+		       nid, K(sum_zone_node_page_state(nid, NR_FREE_ZEROED_PAGES)),
 		       nid, K(i.totalram - i.freeram),
 		       nid, K(node_page_state(pgdat, NR_ACTIVE_ANON) +
 				node_page_state(pgdat, NR_ACTIVE_FILE)),
@@ -1386,7 +1386,7 @@ void setup_new_exec(struct linux_binprm * bprm)
 	}
 
 	/* Check if we need to enable badger trap for this process*/
-	if(is_badger_trap_process(current->comm)) {
+	if(is_badger_trap_process(current)) {
 		badger_trap_walk(current->mm, 0, ~0ull, true);
 	}
 
@@ -20,6 +20,7 @@
 #include <linux/ratelimit.h>
 #include <linux/list_lru.h>
 #include <linux/iversion.h>
+#include <linux/mm_econ.h>
 #include <trace/events/writeback.h>
 #include "internal.h"
 
@@ -583,6 +584,10 @@ static void evict(struct inode *inode)
 
 	remove_inode_hash(inode);
 
+#ifdef CONFIG_MM_ECON
+	mm_drop_file_profile(inode);
+#endif
+
 	spin_lock(&inode->i_lock);
 	wake_up_bit(&inode->i_state, __I_NEW);
 	BUG_ON(inode->i_state != (I_FREEING | I_CLEAR));
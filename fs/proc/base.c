@@ -71,6 +71,7 @@
 #include <linux/stacktrace.h>
 #include <linux/resource.h>
 #include <linux/mm_econ.h>
+#include <linux/badger_trap.h>
 #include <linux/module.h>
 #include <linux/mount.h>
 #include <linux/security.h>
@@ -3103,10 +3104,14 @@ static const struct pid_entry tgid_base_stuff[] = {
 #ifdef CONFIG_PROC_PID_ARCH_STATUS
 	ONE("arch_status", S_IRUGO, proc_pid_arch_status),
 #endif
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	REG("huge_addr_ranges", S_IRUGO|S_IWUSR, proc_huge_addr_ranges_operations),
+#endif
 #ifdef CONFIG_MM_ECON
     REG("mmap_filters", S_IRUGO|S_IWUSR, proc_mmap_filters_operations),
     REG("mem_ranges", S_IRUGO, proc_mem_ranges_operations),
 #endif
+	ONE("badger_trap_vmas", S_IRUGO, proc_pid_badger_trap_vmas),
 };
 
 static int proc_tgid_base_readdir(struct file *file, struct dir_context *ctx)
@@ -3497,10 +3502,14 @@ static const struct pid_entry tid_base_stuff[] = {
 #ifdef CONFIG_PROC_PID_ARCH_STATUS
 	ONE("arch_status", S_IRUGO, proc_pid_arch_status),
 #endif
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	REG("huge_addr_ranges", S_IRUGO|S_IWUSR, proc_huge_addr_ranges_operations),
+#endif
 #ifdef CONFIG_MM_ECON
     REG("mmap_filters", S_IRUGO|S_IWUSR, proc_mmap_filters_operations),
     REG("mem_ranges", S_IRUGO, proc_mem_ranges_operations),
 #endif
+	ONE("badger_trap_vmas", S_IRUGO, proc_pid_badger_trap_vmas),
 };
 
 static int proc_tid_base_readdir(struct file *file, struct dir_context *ctx)
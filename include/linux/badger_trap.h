@@ -7,10 +7,30 @@
 
 #define MAX_NAME_LEN	16
 
-extern char badger_trap_process[CONFIG_NR_CPUS][MAX_NAME_LEN];
+// The ways a process can be selected for badger trap at exec time.
+enum badger_trap_target_type {
+	BT_TARGET_COMM,
+	BT_TARGET_PID,
+	BT_TARGET_CGROUP, // cgroup id on the default hierarchy
+
+	// NOTE: must be the last value in the enum.
+	BT_NR_TARGET_TYPES,
+};
+
+struct task_struct;
+struct seq_file;
+struct pid_namespace;
+struct pid;
 
 void silence(void);
-bool is_badger_trap_process(const char* proc_name);
+int badger_trap_register_comm(const char *comm);
+int badger_trap_unregister_comm(const char *comm);
+int badger_trap_register_pid(pid_t pid);
+int badger_trap_unregister_pid(pid_t pid);
+int badger_trap_register_cgroup(u64 cgrp_id);
+int badger_trap_unregister_cgroup(u64 cgrp_id);
+void badger_trap_clear_targets(enum badger_trap_target_type type);
+bool is_badger_trap_process(struct task_struct *tsk);
 bool is_badger_trap_enabled(const struct mm_struct *mm, u64 address);
 inline pte_t pte_mkreserve(pte_t pte);
 inline pte_t pte_unreserve(pte_t pte);
@@ -22,7 +42,42 @@ inline pud_t pud_mkreserve(pud_t pud);
 inline pud_t pud_unreserve(pud_t pud);
 inline int is_pud_reserved(pud_t pud);
 void badger_trap_set_stats_loc(struct mm_struct *mm, struct badger_trap_stats *stats);
+
+// Per-VMA miss counts, see vm_area_struct::bt_stats.
+struct badger_trap_vma_stats {
+	struct badger_trap_stats stats;
+	// The jiffies at which counting started, for computing rates.
+	unsigned long start;
+};
+
+void badger_trap_vma_stats_alloc(struct vm_area_struct *vma);
+void badger_trap_vma_stats_dup(struct vm_area_struct *new,
+		const struct vm_area_struct *orig);
+void badger_trap_vma_stats_split(struct vm_area_struct *vma,
+		struct vm_area_struct *new);
+void badger_trap_vma_stats_clear(struct vm_area_struct *vma);
+void badger_trap_vma_stats_free(struct vm_area_struct *vma);
+
+typedef void (*badger_trap_vma_event_fn_t)(struct mm_struct *mm,
+		unsigned long start, unsigned long end);
+void badger_trap_set_vma_event_fn(struct mm_struct *mm,
+		badger_trap_vma_event_fn_t fn);
+
+/*
+ * Report that [start, end) of mm now has a VMA that may be new to kbadgerd
+ * (mmap, brk, stack growth, mremap). Caller must hold mmap_sem.
+ */
+static inline void badger_trap_vma_event(struct mm_struct *mm,
+		unsigned long start, unsigned long end)
+{
+	badger_trap_vma_event_fn_t fn = READ_ONCE(mm->bt_vma_event);
+
+	if (unlikely(fn))
+		fn(mm, start, end);
+}
 void badger_trap_walk(struct mm_struct *mm, u64 lower, u64 upper, bool init);
 void print_badger_trap_stats(const struct mm_struct *mm);
+int proc_pid_badger_trap_vmas(struct seq_file *m, struct pid_namespace *ns,
+		struct pid *pid, struct task_struct *task);
 
 #endif /* _LINUX_BADGER_TRAP_H */
@@ -14,7 +14,7 @@ struct mm_stats_pftrace;
 
 extern vm_fault_t do_huge_pmd_anonymous_page(struct vm_fault *vmf,
 					     struct mm_stats_pftrace *pftrace,
-					     bool require_prezeroed);
+					     bool require_prezeroed, int nid);
 extern int copy_huge_pmd(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 			 pmd_t *dst_pmd, pmd_t *src_pmd, unsigned long addr,
 			 struct vm_area_struct *vma);
@@ -105,10 +105,16 @@ extern char huge_addr_comm[MAX_HUGE_ADDR_COMM];
 
 bool huge_addr_enabled(struct vm_area_struct *vma, unsigned long address);
 
+bool huge_addr_mm_in_range(struct mm_struct *mm, unsigned long address);
+void huge_addr_mm_dup(struct mm_struct *mm, struct mm_struct *oldmm);
+void huge_addr_mm_free(struct mm_struct *mm);
+extern const struct file_operations proc_huge_addr_ranges_operations;
+
 int promote_to_huge(struct mm_struct *mm,
 		struct vm_area_struct *vma,
 		unsigned long address,
 		struct mm_stats_pftrace *pftrace);
+bool promote_to_huge_async(struct mm_struct *mm, unsigned long address);
 
 enum scan_result {
 	SCAN_FAIL,
@@ -455,6 +461,15 @@ static inline bool thp_migration_supported(void)
 {
 	return false;
 }
+
+static inline void huge_addr_mm_dup(struct mm_struct *mm,
+				    struct mm_struct *oldmm)
+{
+}
+
+static inline void huge_addr_mm_free(struct mm_struct *mm)
+{
+}
 #endif /* CONFIG_TRANSPARENT_HUGEPAGE */
 
 #endif /* _LINUX_HUGE_MM_H */
@@ -430,6 +430,12 @@ struct hstate {
 	unsigned int nr_huge_pages_node[MAX_NUMNODES];
 	unsigned int free_huge_pages_node[MAX_NUMNODES];
 	unsigned int surplus_huge_pages_node[MAX_NUMNODES];
+	/* background zeroing of the free pool, see hugetlb_prezero_workfn() */
+	bool prezero;
+	/* free pages being zeroed right now, protected by hugetlb_lock */
+	unsigned int zeroing_huge_pages;
+	atomic_long_t prezero_hits;
+	atomic_long_t prezero_misses;
 #ifdef CONFIG_CGROUP_HUGETLB
 	/* cgroup control files */
 	struct cftype cgroup_files[5];
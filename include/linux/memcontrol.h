@@ -194,6 +194,35 @@ struct memcg_cgwb_frn {
 	struct wb_completion done;	/* tracks in-flight foreign writebacks */
 };
 
+#ifdef CONFIG_MM_ECON
+/* Values for memcg_econ.mode */
+#define MEMCG_ECON_INHERIT	-1	/* use the parent's mode, or the global one */
+#define MEMCG_ECON_OFF		0
+#define MEMCG_ECON_ON		1
+#define MEMCG_ECON_BUDGETED	2	/* on, within the global per-LTU budget */
+
+/*
+ * mm_econ policy and accounting for the tasks in a cgroup. Decisions are
+ * charged to the faulting task's memcg and all of its ancestors, and are
+ * refused if any of them is out of budget for the current LTU. See
+ * mm_decide() in mm/estimator.c.
+ */
+struct memcg_econ {
+	int mode;
+	u64 budget;			/* cycles per LTU, U64_MAX if unlimited */
+
+	unsigned long ltu_start;	/* jiffies */
+	atomic64_t ltu_spent;		/* cycles charged since ltu_start */
+
+	atomic64_t decisions;
+	atomic64_t decisions_yes;
+	atomic64_t decisions_over_budget;
+	atomic64_t cost_charged;	/* cycles */
+	atomic64_t hp_promotions;
+	atomic64_t eager_bytes;
+};
+#endif
+
 /*
  * The memory controller data structure. The memory controller controls both
  * page cache and RSS per cgroup. We would eventually like to provide
@@ -322,6 +351,10 @@ struct mem_cgroup {
 	struct deferred_split deferred_split_queue;
 #endif
 
+#ifdef CONFIG_MM_ECON
+	struct memcg_econ econ;
+#endif
+
 	struct mem_cgroup_per_node *nodeinfo[0];
 	/* WARNING: nodeinfo must be the last member here */
 };
@@ -2842,6 +2842,11 @@ extern long copy_huge_page_from_user(struct page *dst_page,
 				const void __user *usr_src,
 				unsigned int pages_per_huge_page,
 				bool allow_pagefault);
+extern bool process_huge_page_mt(unsigned long addr_hint,
+				 unsigned int pages_per_huge_page,
+				 void (*process_subpage)(unsigned long addr,
+							 int idx, void *arg),
+				 void *arg, int nid);
 #endif /* CONFIG_TRANSPARENT_HUGEPAGE || CONFIG_HUGETLBFS */
 
 #ifdef CONFIG_DEBUG_PAGEALLOC
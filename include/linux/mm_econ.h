@@ -14,6 +14,7 @@
 #define MM_ACTION_EAGER_PAGING  (1 <<  4)
 #define MM_ACTION_RUN_PREZEROING (1 <<  5) // asynczero
 #define MM_ACTION_RUN_PROMOTION (1 <<  6) // khugepaged
+#define MM_ACTION_PROMOTE_HUGE_FILE (1 << 7) // shmem/tmpfs and file THP
 
 // The length of one Long Time Unit (LTU), the fundamental time accounting unit
 // of mm_econ. This value is in milliseconds (1 LTU = MM_ECON_LTU ms).
@@ -42,6 +43,11 @@ struct mm_action {
         // What is the length of a memory region
         u64 len;
     };
+
+    // Only for MM_ACTION_PROMOTE_HUGE_FILE: the file whose page cache would
+    // be huge. `address` is then the byte offset in the file rather than a
+    // virtual address.
+    struct inode *inode;
 };
 
 enum mm_memory_section {
@@ -59,6 +65,23 @@ typedef u64 (*mm_econ_tlb_miss_estimator_fn_t)(const struct mm_action *);
 
 void register_mm_econ_tlb_miss_estimator(mm_econ_tlb_miss_estimator_fn_t f);
 
+// Like mm_econ_tlb_miss_estimator_fn_t, but estimated from the coarse per-VMA
+// BadgerTrap counts of the current process. Returns false if there is nothing
+// to go on, and otherwise stores the estimate for the whole huge page (of any
+// order) in `misses`, in units of `misses per LTU`.
+typedef bool (*mm_econ_vma_miss_estimator_fn_t)(const struct mm_action *,
+        u64 *misses);
+
+void register_mm_econ_vma_miss_estimator(mm_econ_vma_miss_estimator_fn_t f);
+
+// Where the benefit in a `struct mm_cost_delta` came from.
+enum mm_econ_benefit_source {
+    MM_ECON_BENEFIT_NONE,
+    MM_ECON_BENEFIT_PROFILE,  // user-supplied profile (mmap_filters)
+    MM_ECON_BENEFIT_KBADGERD, // registered tlb_miss_est_fn
+    MM_ECON_BENEFIT_VMA,      // registered vma_miss_est_fn (vma_benefit)
+};
+
 // The cost of a particular action relative to the status quo.
 struct mm_cost_delta {
     //// Difference in the number of TLB misses.
@@ -80,23 +103,46 @@ struct mm_cost_delta {
     // fundamentally needed, but it is the fastest way to avoid races between
     // the estimator and the execution of policies.
     u64 extra;
+
+    // The node the estimator assumed memory would be allocated from, or
+    // NUMA_NO_NODE if it doesn't care. Only set for huge page promotions.
+    int nid;
+
+    // Where `benefit` was estimated from.
+    enum mm_econ_benefit_source benefit_src;
 };
 
 inline bool mm_process_is_using_cbmm(pid_t pid);
 
 bool mm_econ_is_on(void);
 
-bool mm_decide(const struct mm_cost_delta *cost);
+bool mm_decide(const struct mm_action *action, const struct mm_cost_delta *cost);
+
+// Return values of mm_decide_hook(). Any negative value (an errno) rejects
+// the action.
+#define MM_DECIDE_HOOK_DEFAULT 0 // use the built-in policy
+#define MM_DECIDE_HOOK_YES     1 // take the action
+
+int mm_decide_hook(const struct mm_action *action, const struct mm_cost_delta *cost);
 
 void
 mm_estimate_changes(const struct mm_action *action, struct mm_cost_delta *cost);
 
-void mm_register_promotion(u64 addr);
+struct mm_struct;
+void mm_register_promotion(struct mm_struct *mm, u64 addr);
+void mm_register_huge_page_placement(int nid);
+struct vm_area_struct;
+int mm_econ_huge_page_node(struct mm_struct *mm, struct vm_area_struct *vma,
+        unsigned long address, int home);
 
 void
 mm_add_memory_range(pid_t pid, enum mm_memory_section section, u64 mapaddr, u64 section_off,
         u64 addr, u64 len, u64 prot, u64 flags, u64 fd, u64 off);
 
+void mm_add_file_range(pid_t pid, struct inode *inode, u64 mapaddr, u64 len,
+        u64 pgoff);
+void mm_drop_file_profile(struct inode *inode);
+
 void mm_copy_profile(pid_t old_pid, pid_t new_pid);
 void mm_profile_check_exiting_proc(pid_t pid);
 
@@ -30,6 +30,7 @@ extern struct mm_hist mm_huge_page_promotion_work_cycles;
 extern struct mm_hist mm_huge_page_promotion_copy_pages_cycles;
 extern struct mm_hist mm_process_huge_page_cycles;
 extern struct mm_hist mm_process_huge_page_single_page_cycles;
+extern struct mm_hist mm_process_huge_page_mt_cycles;
 
 extern struct mm_hist mm_econ_cost;
 extern struct mm_hist mm_econ_benefit;
@@ -59,6 +60,14 @@ struct mm_stats_pftrace {
 
 	u64 prep_start_tsc;  // started preparing the alloced mem
 	u64 prep_end_tsc;    // finished ...
+
+	// Where the #PF happened and who took it. These are filled in by
+	// mm_stats_pftrace_submit(). This struct is written to the trace file
+	// as-is, so it must match struct pftrace_record.
+	u64 address;
+	u64 ip;
+	s32 pid;
+	s32 nid;
 };
 
 // A bunch of bit flags that indicate things that could happen during a #PF.
@@ -216,8 +225,10 @@ static inline void mm_stats_check_alloc_zeroing(
 void mm_stats_pftrace_init(struct mm_stats_pftrace *trace);
 
 // Registers a complete sample with the sampling system after it is complete
-// (i.e. at the end of a page fault). The sampling system may then choose to
-// store or drop the sample probablistically.
-void mm_stats_pftrace_submit(struct mm_stats_pftrace *trace, struct pt_regs *regs);
+// (i.e. at the end of a page fault at `address`). The sampling system may then
+// choose to store or drop the sample probablistically, or because it doesn't
+// match any of the filters in /proc/pftrace_filters.
+void mm_stats_pftrace_submit(struct mm_stats_pftrace *trace, struct pt_regs *regs,
+		unsigned long address);
 
 #endif
@@ -25,6 +25,8 @@
 
 struct address_space;
 struct mem_cgroup;
+struct huge_addr_ranges;
+struct badger_trap_vma_stats;
 
 /*
  * Each physical page in the system has a struct page associated with
@@ -354,7 +356,9 @@ struct vm_area_struct {
 #endif
 	struct vm_userfaultfd_ctx vm_userfaultfd_ctx;
 
-	//struct badger_trap_stats bt_stats;
+	// BadgerTrap misses taken in this VMA. Only allocated once BadgerTrap
+	// has been turned on for the mm, so NULL for almost every VMA.
+	struct badger_trap_vma_stats *bt_stats;
 } __randomize_layout;
 
 struct core_thread {
@@ -497,6 +501,14 @@ struct mm_struct {
 #if defined(CONFIG_TRANSPARENT_HUGEPAGE) && !USE_SPLIT_PMD_PTLOCKS
 		pgtable_t pmd_huge_pte; /* protected by page_table_lock */
 #endif
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+		/*
+		 * Explicit huge page ranges for this address space, set via
+		 * /proc/<pid>/huge_addr_ranges and shared with children on
+		 * fork. See huge_addr_mm_in_range().
+		 */
+		struct huge_addr_ranges __rcu *huge_addr_ranges;
+#endif
 #ifdef CONFIG_NUMA_BALANCING
 		/*
 		 * numa_next_scan is the next time that the PTEs will be marked
@@ -544,6 +556,12 @@ struct mm_struct {
 		// somewhere else, this pointer will point at bt_stats_inner.
 		struct badger_trap_stats *bt_stats;
 		struct badger_trap_stats bt_stats_inner;
+		// If set, called with the bounds of each new or grown VMA, so
+		// that kbadgerd can keep track of the VMAs of the process it
+		// is inspecting without rescanning all of them. Only changed
+		// with mmap_sem held for write (badger_trap_set_vma_event_fn).
+		void (*bt_vma_event)(struct mm_struct *mm,
+				     unsigned long start, unsigned long end);
 		// This semaphore acts as a read/write lock on the page tables.
 		// To simplify things (a lot!), we simply preclude concurrent
 		// changes to the page tables while badgertrap is walking page
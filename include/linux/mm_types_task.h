@@ -67,6 +67,8 @@ struct badger_trap_stats {
 	atomic64_t total_dtlb_2mb_store_misses;
 	atomic64_t total_dtlb_4kb_load_misses;
 	atomic64_t total_dtlb_2mb_load_misses;
+	atomic64_t total_dtlb_1gb_store_misses;
+	atomic64_t total_dtlb_1gb_load_misses;
 };
 
 static inline void badger_trap_stats_clear(struct badger_trap_stats *stats)
@@ -75,6 +77,8 @@ static inline void badger_trap_stats_clear(struct badger_trap_stats *stats)
 	atomic64_set_release(&stats->total_dtlb_2mb_store_misses, 0);
 	atomic64_set_release(&stats->total_dtlb_4kb_load_misses,  0);
 	atomic64_set_release(&stats->total_dtlb_2mb_load_misses,  0);
+	atomic64_set_release(&stats->total_dtlb_1gb_store_misses, 0);
+	atomic64_set_release(&stats->total_dtlb_1gb_load_misses,  0);
 }
 
 static inline void badger_trap_stats_init(struct badger_trap_stats *stats)
@@ -94,6 +98,10 @@ static inline void badger_trap_add_stats(
 			&to->total_dtlb_4kb_load_misses);
 	atomic64_add(atomic64_read_acquire(&from->total_dtlb_2mb_load_misses),
 			&to->total_dtlb_2mb_load_misses);
+	atomic64_add(atomic64_read_acquire(&from->total_dtlb_1gb_store_misses),
+			&to->total_dtlb_1gb_store_misses);
+	atomic64_add(atomic64_read_acquire(&from->total_dtlb_1gb_load_misses),
+			&to->total_dtlb_1gb_load_misses);
 }
 
 struct page_frag {
@@ -195,6 +195,7 @@ enum numa_stat_item {
 enum zone_stat_item {
 	/* First 128 byte cacheline (assuming 64 bit words) */
 	NR_FREE_PAGES,
+	NR_FREE_ZEROED_PAGES,	/* free blocks with PageZeroed head */
 	NR_ZONE_LRU_BASE, /* Used only for compaction and reclaim retry */
 	NR_ZONE_INACTIVE_ANON = NR_ZONE_LRU_BASE,
 	NR_ZONE_ACTIVE_ANON,
@@ -361,6 +362,34 @@ struct per_cpu_pageset {
 	s8 stat_threshold;
 	s8 vm_stat_diff[NR_VM_ZONE_STAT_ITEMS];
 #endif
+
+	/* Sampled zone->lock accounting, see linux/zone_lock_stat.h */
+	u32 lock_sample_seq;
+	u32 lock_samples;
+	u64 lock_wait_cycles;
+	u64 lock_hold_cycles;
+};
+
+struct zone_lock_load {
+	unsigned int hold_permille;	/* fraction of time the lock was held */
+	u64 avg_hold_cycles;		/* per acquisition */
+	u64 avg_wait_cycles;		/* per acquisition */
+};
+
+/*
+ * zone->lock load over a recent window, computed from the sampled per-CPU
+ * accounting in struct per_cpu_pageset. Only updated under zone->lock, when a
+ * sampled acquisition finds the window is over.
+ */
+struct zone_lock_window {
+	u64 start_tsc;
+	u64 hold_cycles;	/* estimated totals at start_tsc */
+	u64 wait_cycles;
+	u64 samples;
+
+	/* Results for the last complete window. */
+	seqcount_t seq;
+	struct zone_lock_load load;
 };
 
 struct per_cpu_nodestat {
@@ -581,6 +610,9 @@ struct zone {
 	/* Zone statistics */
 	atomic_long_t		vm_stat[NR_VM_ZONE_STAT_ITEMS];
 	atomic_long_t		vm_numa_stat[NR_VM_NUMA_STAT_ITEMS];
+
+	/* Recent zone->lock load, see zone_lock_window_read() */
+	struct zone_lock_window	lock_window;
 } ____cacheline_internodealigned_in_smp;
 
 enum pgdat_flags {
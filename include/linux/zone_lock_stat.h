@@ -0,0 +1,102 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _LINUX_ZONE_LOCK_STAT_H
+#define _LINUX_ZONE_LOCK_STAT_H
+
+/*
+ * Sampled accounting of zone->lock wait and hold times.
+ *
+ * One in ZONE_LOCK_SAMPLE_INTERVAL acquisitions on each CPU is timed with the
+ * TSC, and the wait/hold cycles are added to that CPU's per_cpu_pageset for
+ * the zone. Readers sum over CPUs and scale by the interval to get an estimate
+ * of the total. Every ZONE_LOCK_WINDOW_MS, the next sampled acquisition turns
+ * that into a recent rate, which zone_lock_window_read() returns.
+ *
+ * This is used by mm_econ to estimate how much async prezeroing would
+ * contend with allocation traffic on a zone.
+ */
+
+#include <linux/mmzone.h>
+#include <linux/percpu.h>
+#include <linux/spinlock.h>
+#include <asm/msr.h>
+#include <asm/tsc.h>
+
+#define ZONE_LOCK_SAMPLE_INTERVAL 64 /* must be a power of two */
+
+struct zone_lock_sample {
+	u64 start; /* 0 if this acquisition is not sampled */
+	u64 acquired;
+};
+
+static inline void zone_lock_sample_begin(struct zone *zone,
+					  struct zone_lock_sample *s)
+{
+	s->start = 0;
+	if (unlikely((this_cpu_inc_return(zone->pageset->lock_sample_seq)
+		      & (ZONE_LOCK_SAMPLE_INTERVAL - 1)) == 0))
+		s->start = rdtsc();
+}
+
+static inline void zone_lock_sample_acquired(struct zone_lock_sample *s)
+{
+	if (unlikely(s->start))
+		s->acquired = rdtsc();
+}
+
+#define ZONE_LOCK_WINDOW_MS 10
+
+void zone_lock_window_roll(struct zone *zone, u64 now);
+
+/* Must be called with zone->lock still held. */
+static inline void zone_lock_sample_release(struct zone *zone,
+					    struct zone_lock_sample *s)
+{
+	u64 now;
+
+	if (likely(!s->start))
+		return;
+
+	now = rdtsc();
+	this_cpu_add(zone->pageset->lock_wait_cycles, s->acquired - s->start);
+	this_cpu_add(zone->pageset->lock_hold_cycles, now - s->acquired);
+	this_cpu_inc(zone->pageset->lock_samples);
+
+	if (unlikely(now - zone->lock_window.start_tsc >=
+		     (u64)tsc_khz * ZONE_LOCK_WINDOW_MS))
+		zone_lock_window_roll(zone, now);
+}
+
+#define zone_lock(zone, s)					\
+	do {							\
+		zone_lock_sample_begin(zone, s);		\
+		spin_lock(&(zone)->lock);			\
+		zone_lock_sample_acquired(s);			\
+	} while (0)
+
+#define zone_unlock(zone, s)					\
+	do {							\
+		zone_lock_sample_release(zone, s);		\
+		spin_unlock(&(zone)->lock);			\
+	} while (0)
+
+#define zone_lock_irqsave(zone, flags, s)			\
+	do {							\
+		zone_lock_sample_begin(zone, s);		\
+		spin_lock_irqsave(&(zone)->lock, flags);	\
+		zone_lock_sample_acquired(s);			\
+	} while (0)
+
+#define zone_unlock_irqrestore(zone, flags, s)			\
+	do {							\
+		zone_lock_sample_release(zone, s);		\
+		spin_unlock_irqrestore(&(zone)->lock, flags);	\
+	} while (0)
+
+/*
+ * Copies the zone->lock load over the last complete window of at least
+ * ZONE_LOCK_WINDOW_MS to *load, without modifying the zone. Not for use in
+ * interrupt context.
+ */
+void zone_lock_window_read(struct zone *zone, struct zone_lock_load *load);
+
+#endif /* _LINUX_ZONE_LOCK_STAT_H */
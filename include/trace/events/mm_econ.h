@@ -0,0 +1,142 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM mm_econ
+
+#if !defined(_TRACE_MM_ECON_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_MM_ECON_H
+
+#include <linux/types.h>
+#include <linux/tracepoint.h>
+#include <linux/mm_econ.h>
+
+#define MM_ECON_ACTIONS						\
+	EM(MM_ACTION_NONE,		"none")			\
+	EM(MM_ACTION_PROMOTE_HUGE,	"promote_huge")		\
+	EM(MM_ACTION_DEMOTE_HUGE,	"demote_huge")		\
+	EM(MM_ACTION_RUN_DEFRAG,	"run_defrag")		\
+	EM(MM_ACTION_ALLOC_RECLAIM,	"alloc_reclaim")	\
+	EM(MM_ACTION_EAGER_PAGING,	"eager_paging")		\
+	EM(MM_ACTION_RUN_PREZEROING,	"run_prezeroing")	\
+	EM(MM_ACTION_RUN_PROMOTION,	"run_promotion")	\
+	EMe(MM_ACTION_PROMOTE_HUGE_FILE, "promote_huge_file")
+
+#define MM_ECON_BENEFIT_SOURCES					\
+	EM(MM_ECON_BENEFIT_NONE,	"none")			\
+	EM(MM_ECON_BENEFIT_PROFILE,	"profile")		\
+	EM(MM_ECON_BENEFIT_KBADGERD,	"kbadgerd")		\
+	EMe(MM_ECON_BENEFIT_VMA,	"vma")
+
+#undef EM
+#undef EMe
+#define EM(a, b)	TRACE_DEFINE_ENUM(a);
+#define EMe(a, b)	TRACE_DEFINE_ENUM(a);
+
+MM_ECON_BENEFIT_SOURCES
+
+#undef EM
+#undef EMe
+#define EM(a, b)	{a, b},
+#define EMe(a, b)	{a, b}
+
+/*
+ * Only huge page actions have an order; for the others the order is -1 and
+ * arg holds the length (eager paging) or page count (prezeroing).
+ */
+#define MM_ECON_ACTION_HAS_ORDER(action)				\
+	((action)->action == MM_ACTION_PROMOTE_HUGE ||			\
+	 (action)->action == MM_ACTION_PROMOTE_HUGE_FILE ||		\
+	 (action)->action == MM_ACTION_DEMOTE_HUGE ||			\
+	 (action)->action == MM_ACTION_ALLOC_RECLAIM)
+
+TRACE_EVENT(mm_econ_estimate,
+
+	TP_PROTO(const struct mm_action *action,
+		 const struct mm_cost_delta *cost),
+
+	TP_ARGS(action, cost),
+
+	TP_STRUCT__entry(
+		__field(int, action)
+		__field(u64, address)
+		__field(int, order)
+		__field(u64, arg)
+		__field(u64, cost)
+		__field(u64, benefit)
+		__field(u64, extra)
+		__field(int, nid)
+		__field(int, benefit_src)
+	),
+
+	TP_fast_assign(
+		__entry->action = action->action;
+		__entry->address = action->address;
+		__entry->order = MM_ECON_ACTION_HAS_ORDER(action) ?
+			(int)action->huge_page_order : -1;
+		__entry->arg = action->unused;
+		__entry->cost = cost->cost;
+		__entry->benefit = cost->benefit;
+		__entry->extra = cost->extra;
+		__entry->nid = cost->nid;
+		__entry->benefit_src = cost->benefit_src;
+	),
+
+	TP_printk("action=%s address=0x%llx order=%d arg=%llu cost=%llu benefit=%llu extra=0x%llx nid=%d src=%s",
+		__print_symbolic(__entry->action, MM_ECON_ACTIONS),
+		__entry->address,
+		__entry->order,
+		__entry->arg,
+		__entry->cost,
+		__entry->benefit,
+		__entry->extra,
+		__entry->nid,
+		__print_symbolic(__entry->benefit_src, MM_ECON_BENEFIT_SOURCES))
+);
+
+TRACE_EVENT(mm_econ_decide,
+
+	TP_PROTO(const struct mm_action *action,
+		 const struct mm_cost_delta *cost, int mode, bool decision),
+
+	TP_ARGS(action, cost, mode, decision),
+
+	TP_STRUCT__entry(
+		__field(int, action)
+		__field(u64, address)
+		__field(int, order)
+		__field(u64, cost)
+		__field(u64, benefit)
+		__field(u64, extra)
+		__field(int, benefit_src)
+		__field(int, mode)
+		__field(bool, decision)
+	),
+
+	TP_fast_assign(
+		__entry->action = action->action;
+		__entry->address = action->address;
+		__entry->order = MM_ECON_ACTION_HAS_ORDER(action) ?
+			(int)action->huge_page_order : -1;
+		__entry->cost = cost->cost;
+		__entry->benefit = cost->benefit;
+		__entry->extra = cost->extra;
+		__entry->benefit_src = cost->benefit_src;
+		__entry->mode = mode;
+		__entry->decision = decision;
+	),
+
+	TP_printk("action=%s address=0x%llx order=%d cost=%llu benefit=%llu extra=0x%llx src=%s mode=%d decision=%s",
+		__print_symbolic(__entry->action, MM_ECON_ACTIONS),
+		__entry->address,
+		__entry->order,
+		__entry->cost,
+		__entry->benefit,
+		__entry->extra,
+		__print_symbolic(__entry->benefit_src, MM_ECON_BENEFIT_SOURCES),
+		__entry->mode,
+		__entry->decision ? "yes" : "no")
+);
+
+#endif /* _TRACE_MM_ECON_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,57 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+#ifndef _UAPI_LINUX_KBADGERD_H
+#define _UAPI_LINUX_KBADGERD_H
+
+#include <linux/types.h>
+
+/*
+ * Layout of /proc/kbadgerd_results_raw.
+ *
+ * The file is a struct kbadgerd_results_header followed by nr_records
+ * struct kbadgerd_result, all in native byte order. Readers should use
+ * record_size to step between records so that fields may be appended in later
+ * versions.
+ *
+ * Miss counts are raw totals over all completed samples of a range. To get
+ * misses per LTU, multiply by ltu_ms and divide by sleep_interval_ms *
+ * nsamples.
+ */
+
+#define KBADGERD_RESULTS_MAGIC		0x4744424b	/* "KBDG" */
+#define KBADGERD_RESULTS_VERSION	2
+
+/* Size of a version 1 record, which has no 1GB miss counts. */
+#define KBADGERD_RESULT_V1_SIZE		64
+
+/* Values for struct kbadgerd_result.flags */
+#define KBADGERD_RESULT_EXPLORED	(1 << 0) /* sampled at least once */
+#define KBADGERD_RESULT_CURRENT		(1 << 1) /* being sampled right now */
+#define KBADGERD_RESULT_OLD		(1 << 2) /* split or replaced range */
+
+struct kbadgerd_results_header {
+	__u32 magic;
+	__u16 version;
+	__u16 record_size;
+	__s32 pid;			/* inspected pid, 0 if none */
+	__u32 nr_records;
+	__u32 sleep_interval_ms;	/* kbadgerd iteration length */
+	__u32 ltu_ms;			/* length of one mm_econ LTU */
+};
+
+struct kbadgerd_result {
+	__u64 start;
+	__u64 end;			/* exclusive */
+	__u64 nsamples;
+	__u64 dtlb_4kb_load_misses;
+	__u64 dtlb_4kb_store_misses;
+	__u64 dtlb_2mb_load_misses;
+	__u64 dtlb_2mb_store_misses;
+	__u32 flags;
+	__u32 __reserved;
+
+	/* Version 2: misses on 1GB pages (hugetlbfs or DAX) */
+	__u64 dtlb_1gb_load_misses;
+	__u64 dtlb_1gb_store_misses;
+};
+
+#endif /* _UAPI_LINUX_KBADGERD_H */
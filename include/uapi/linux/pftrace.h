@@ -0,0 +1,50 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+#ifndef _UAPI_LINUX_PFTRACE_H
+#define _UAPI_LINUX_PFTRACE_H
+
+#include <linux/types.h>
+
+/*
+ * Layout of the /pftrace page fault trace file.
+ *
+ * The file is a struct pftrace_header followed by struct pftrace_record until
+ * the end of the file, all in native byte order. Readers should use
+ * record_size to step between records so that fields may be appended in later
+ * versions.
+ *
+ * Version 0 traces have no header at all: they are just back-to-back records
+ * of PFTRACE_RECORD_V0_SIZE bytes, i.e. struct pftrace_record up to and
+ * including prep_end_tsc. They can be told apart by their first word, which is
+ * a set of bitflags that never has the high bits of PFTRACE_MAGIC set.
+ */
+
+#define PFTRACE_MAGIC		0x52544650	/* "PFTR" */
+#define PFTRACE_VERSION		1
+
+#define PFTRACE_RECORD_V0_SIZE	64
+
+struct pftrace_header {
+	__u32 magic;
+	__u16 version;
+	__u16 record_size;
+};
+
+struct pftrace_record {
+	__u64 bitflags;			/* 1 << enum mm_stats_pf_flags */
+	__u64 start_tsc;
+	__u64 end_tsc;
+	__u64 alloc_start_tsc;
+	__u64 alloc_end_tsc;
+	__u64 alloc_zeroing_duration;
+	__u64 prep_start_tsc;
+	__u64 prep_end_tsc;
+
+	/* Version 1 */
+	__u64 address;			/* faulting virtual address */
+	__u64 ip;			/* user ip of the fault, or 0 if it was
+					 * taken in the kernel */
+	__s32 pid;			/* tgid of the faulting process */
+	__s32 nid;			/* node of the cpu that took the fault */
+};
+
+#endif /* _UAPI_LINUX_PFTRACE_H */
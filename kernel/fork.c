@@ -351,8 +351,10 @@ struct vm_area_struct *vm_area_alloc(struct mm_struct *mm)
 	struct vm_area_struct *vma;
 
 	vma = kmem_cache_alloc(vm_area_cachep, GFP_KERNEL);
-	if (vma)
+	if (vma) {
 		vma_init(vma, mm);
+		badger_trap_vma_stats_alloc(vma);
+	}
 	return vma;
 }
 
@@ -363,12 +365,14 @@ struct vm_area_struct *vm_area_dup(struct vm_area_struct *orig)
 	if (new) {
 		*new = *orig;
 		INIT_LIST_HEAD(&new->anon_vma_chain);
+		badger_trap_vma_stats_dup(new, orig);
 	}
 	return new;
 }
 
 void vm_area_free(struct vm_area_struct *vma)
 {
+	badger_trap_vma_stats_free(vma);
 	kmem_cache_free(vm_area_cachep, vma);
 }
 
@@ -550,6 +554,7 @@ static __latent_entropy int dup_mmap(struct mm_struct *mm,
 		if (retval)
 			goto fail_nomem_policy;
 		tmp->vm_mm = mm;
+		badger_trap_vma_stats_clear(tmp);
 		retval = dup_userfaultfd(tmp, &uf);
 		if (retval)
 			goto fail_nomem_anon_vma_fork;
@@ -695,6 +700,7 @@ void __mmdrop(struct mm_struct *mm)
 	mm_free_pgd(mm);
 	destroy_context(mm);
 	mmu_notifier_mm_destroy(mm);
+	huge_addr_mm_free(mm);
 	check_mm(mm);
 	put_user_ns(mm->user_ns);
 	free_mm(mm);
@@ -1031,6 +1037,9 @@ static struct mm_struct *mm_init(struct mm_struct *mm, struct task_struct *p,
 	init_tlb_flush_pending(mm);
 #if defined(CONFIG_TRANSPARENT_HUGEPAGE) && !USE_SPLIT_PMD_PTLOCKS
 	mm->pmd_huge_pte = NULL;
+#endif
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	RCU_INIT_POINTER(mm->huge_addr_ranges, NULL);
 #endif
 	mm_init_uprobes_state(mm);
 
@@ -1053,6 +1062,7 @@ static struct mm_struct *mm_init(struct mm_struct *mm, struct task_struct *p,
 	// Clear badger trap stats for new address space...
 	badger_trap_set_stats_loc(mm, NULL);
 	badger_trap_stats_init(mm->bt_stats);
+	mm->bt_vma_event = NULL;
 	init_rwsem(&mm->badger_trap_page_table_sem);
 
 	return mm;
@@ -1365,6 +1375,8 @@ static struct mm_struct *dup_mm(struct task_struct *tsk,
 	if (!mm_init(mm, tsk, mm->user_ns))
 		goto fail_nomem;
 
+	huge_addr_mm_dup(mm, oldmm);
+
 	err = dup_mmap(mm, oldmm);
 	if (err)
 		goto free_pt;
@@ -7,6 +7,7 @@
 #include <linux/kthread.h>
 #include <linux/sched/task.h>
 #include <linux/mm_econ.h>
+#include <linux/zone_lock_stat.h>
 #include <asm/page_64.h>
 
 #define HUGE_PAGE_ORDER 9
@@ -32,6 +33,15 @@ module_param(mode, int, 0644);
 u64 pages_zeroed = 0;
 module_param(pages_zeroed, ullong, 0444);
 
+// With mm_econ on, skip zones whose zone->lock was held more than this
+// fraction (in permille) of the last few ms, so that we stay out of the way of
+// allocation traffic.
+unsigned int max_lock_hold = 500;
+module_param(max_lock_hold, uint, 0644);
+
+u64 zones_skipped_busy = 0;
+module_param(zones_skipped_busy, ullong, 0444);
+
 static inline bool skip_zone(struct zone *zone)
 {
 	// Skip the zone if it is ZONE_DMA or ZONE_DMA32
@@ -39,6 +49,22 @@ static inline bool skip_zone(struct zone *zone)
 	return zt == ZONE_DMA || zt == ZONE_DMA32;
 }
 
+// Is allocation traffic on the zone too high to take its lock right now?
+static inline bool zone_lock_busy(struct zone *zone)
+{
+	struct zone_lock_load load;
+
+	if (!mm_econ_is_on() || mode != 0)
+		return false;
+
+	zone_lock_window_read(zone, &load);
+	if (load.hold_permille <= max_lock_hold)
+		return false;
+
+	zones_skipped_busy += 1;
+	return true;
+}
+
 /*
  * preferrably use the architecture specific extensions to zero-fill a page.
  * use memset as a fallback option.
@@ -141,6 +167,7 @@ static int zero_fill_zone_pages(struct zone *zone, int *n)
 			__SetPageBuddy(page);
 			list_add_tail(&page->lru, &area->free_list[MIGRATE_MOVABLE]);
 			area->nr_free++;
+			__mod_zone_page_state(zone, NR_FREE_ZEROED_PAGES, 1 << order);
 			spin_unlock_irqrestore(&zone->lock, flags);
 
 			// One down... (n-1) to go...
@@ -169,6 +196,7 @@ static void zero_n_pages(int n)
 
 	int ret;
 	bool all_zeroed = false;
+	bool tried_some_zone = false;
 
 	if (current_zone == NULL)
 		current_zone = (first_online_pgdat())->node_zones;
@@ -176,12 +204,15 @@ static void zero_n_pages(int n)
 	while (true) {
 		// starts from wherever we left off last time...
 		while(current_zone) {
-			if (!populated_zone(current_zone) || skip_zone(current_zone)) {
+			if (!populated_zone(current_zone) || skip_zone(current_zone)
+				|| zone_lock_busy(current_zone))
+			{
 				current_zone = next_zone(current_zone);
 				continue;
 			}
 
 			ret = zero_fill_zone_pages(current_zone, &n);
+			tried_some_zone = true;
 
 			switch (ret) {
 				case -2:
@@ -210,6 +241,9 @@ static void zero_n_pages(int n)
 		// If this is true it is likely all zones are zeroed (it
 		// could be just the last zone, though... best effort).
 		if (all_zeroed) return;
+
+		// All zones were skipped (e.g. too busy); try again later.
+		if (!tried_some_zone) return;
 	}
 }
 
@@ -226,7 +260,7 @@ static int asynczero_do_work(void *data)
 
 		if (mm_econ_is_on() && mode == 0) {
 			mm_estimate_changes(&mm_action, &mm_cost_delta);
-			should_run = mm_decide(&mm_cost_delta);
+			should_run = mm_decide(&mm_action, &mm_cost_delta);
 		} else {
 			should_run = true;
 		}
@@ -7,8 +7,58 @@
 #include <linux/kernel.h>
 #include <linux/pagewalk.h>
 #include <linux/sched/mm.h>
+#include <linux/sched/task.h>
+#include <linux/hashtable.h>
+#include <linux/stringhash.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/cgroup.h>
+#include <linux/kobject.h>
+#include <linux/seq_file.h>
+#include <linux/jiffies.h>
+#include <linux/ptrace.h>
+#include <linux/mm_econ.h>
 
-char badger_trap_process[CONFIG_NR_CPUS][MAX_NAME_LEN];
+/*
+ * The set of processes that should have badger trap turned on at exec time.
+ *
+ * Targets may be named by comm, by pid, or by cgroup (the id of the task's
+ * cgroup on the default hierarchy). Each kind has its own hash table so that a
+ * lookup costs at most one hash bucket walk per kind. Lookups happen on every
+ * exec and only take rcu_read_lock(); writers serialize on bt_targets_mutex.
+ *
+ * bt_nr_targets lets us skip the lookup entirely when nothing is registered,
+ * which is the common case on a host that is not using badger trap.
+ */
+#define BT_TARGETS_HASH_BITS 6
+
+struct badger_trap_target {
+	struct hlist_node node;
+	struct rcu_head rcu;
+
+	enum badger_trap_target_type type;
+
+	// The pid or cgroup id, or the hash of the comm.
+	u64 key;
+	char comm[MAX_NAME_LEN];
+
+	// Per-entry stats: the number of tasks this entry has turned badger
+	// trap on for, and the pid of the most recent one.
+	atomic64_t nmatches;
+	pid_t last_pid;
+};
+
+static struct hlist_head
+bt_targets[BT_NR_TARGET_TYPES][1 << BT_TARGETS_HASH_BITS];
+static DEFINE_MUTEX(bt_targets_mutex);
+static atomic_t bt_nr_targets = ATOMIC_INIT(0);
+
+static const char *bt_target_type_names[BT_NR_TARGET_TYPES] = {
+	[BT_TARGET_COMM] = "comm",
+	[BT_TARGET_PID] = "pid",
+	[BT_TARGET_CGROUP] = "cgroup",
+};
 
 static bool silent = false;
 
@@ -17,12 +67,220 @@ void silence(void) {
 }
 EXPORT_SYMBOL(silence);
 
+static inline u64 bt_comm_key(const char *comm)
+{
+	return full_name_hash(NULL, comm, strnlen(comm, MAX_NAME_LEN));
+}
+
+/*
+ * Does the target have the given type and key? `comm` is only used for
+ * BT_TARGET_COMM to disambiguate hash collisions.
+ */
+static bool bt_target_match(const struct badger_trap_target *target,
+			    enum badger_trap_target_type type, u64 key,
+			    const char *comm)
+{
+	if (target->key != key)
+		return false;
+	if (type == BT_TARGET_COMM &&
+	    strncmp(target->comm, comm, MAX_NAME_LEN) != 0)
+		return false;
+	return true;
+}
+
+/*
+ * Find the target with the given type and key.
+ *
+ * Caller must hold rcu_read_lock().
+ */
+static struct badger_trap_target *
+bt_target_find(enum badger_trap_target_type type, u64 key, const char *comm)
+{
+	struct badger_trap_target *target;
+
+	hash_for_each_possible_rcu(bt_targets[type], target, node, key) {
+		if (bt_target_match(target, type, key, comm))
+			return target;
+	}
+
+	return NULL;
+}
+
+/*
+ * Same as bt_target_find(), for writers.
+ *
+ * Caller must hold bt_targets_mutex.
+ */
+static struct badger_trap_target *
+bt_target_find_locked(enum badger_trap_target_type type, u64 key,
+		      const char *comm)
+{
+	struct badger_trap_target *target;
+
+	lockdep_assert_held(&bt_targets_mutex);
+
+	hash_for_each_possible(bt_targets[type], target, node, key) {
+		if (bt_target_match(target, type, key, comm))
+			return target;
+	}
+
+	return NULL;
+}
+
+static int bt_target_add(enum badger_trap_target_type type, u64 key,
+			 const char *comm)
+{
+	struct badger_trap_target *target;
+	int ret = 0;
+
+	mutex_lock(&bt_targets_mutex);
+
+	if (bt_target_find_locked(type, key, comm)) {
+		ret = -EEXIST;
+		goto out;
+	}
+
+	target = kzalloc(sizeof(*target), GFP_KERNEL);
+	if (!target) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	target->type = type;
+	target->key = key;
+	if (comm)
+		strscpy(target->comm, comm, MAX_NAME_LEN);
+	atomic64_set(&target->nmatches, 0);
+
+	hash_add_rcu(bt_targets[type], &target->node, key);
+	atomic_inc(&bt_nr_targets);
+
+out:
+	mutex_unlock(&bt_targets_mutex);
+	return ret;
+}
+
+static int bt_target_del(enum badger_trap_target_type type, u64 key,
+			 const char *comm)
+{
+	struct badger_trap_target *target;
+	int ret = 0;
+
+	mutex_lock(&bt_targets_mutex);
+
+	target = bt_target_find_locked(type, key, comm);
+	if (!target) {
+		ret = -ENOENT;
+		goto out;
+	}
+
+	hash_del_rcu(&target->node);
+	atomic_dec(&bt_nr_targets);
+	kfree_rcu(target, rcu);
+
+out:
+	mutex_unlock(&bt_targets_mutex);
+	return ret;
+}
+
+int badger_trap_register_comm(const char *comm)
+{
+	if (!comm || comm[0] == '\0')
+		return -EINVAL;
+	return bt_target_add(BT_TARGET_COMM, bt_comm_key(comm), comm);
+}
+EXPORT_SYMBOL(badger_trap_register_comm);
+
+int badger_trap_unregister_comm(const char *comm)
+{
+	if (!comm || comm[0] == '\0')
+		return -EINVAL;
+	return bt_target_del(BT_TARGET_COMM, bt_comm_key(comm), comm);
+}
+EXPORT_SYMBOL(badger_trap_unregister_comm);
+
+int badger_trap_register_pid(pid_t pid)
+{
+	if (pid <= 0)
+		return -EINVAL;
+	return bt_target_add(BT_TARGET_PID, pid, NULL);
+}
+EXPORT_SYMBOL(badger_trap_register_pid);
+
+int badger_trap_unregister_pid(pid_t pid)
+{
+	return bt_target_del(BT_TARGET_PID, pid, NULL);
+}
+EXPORT_SYMBOL(badger_trap_unregister_pid);
+
+int badger_trap_register_cgroup(u64 cgrp_id)
+{
+	return bt_target_add(BT_TARGET_CGROUP, cgrp_id, NULL);
+}
+EXPORT_SYMBOL(badger_trap_register_cgroup);
+
+int badger_trap_unregister_cgroup(u64 cgrp_id)
+{
+	return bt_target_del(BT_TARGET_CGROUP, cgrp_id, NULL);
+}
+EXPORT_SYMBOL(badger_trap_unregister_cgroup);
+
+/*
+ * Remove all targets of the given type.
+ */
+void badger_trap_clear_targets(enum badger_trap_target_type type)
+{
+	struct badger_trap_target *target;
+	struct hlist_node *tmp;
+	int bkt;
+
+	mutex_lock(&bt_targets_mutex);
+	hash_for_each_safe(bt_targets[type], bkt, tmp, target, node) {
+		hash_del_rcu(&target->node);
+		atomic_dec(&bt_nr_targets);
+		kfree_rcu(target, rcu);
+	}
+	mutex_unlock(&bt_targets_mutex);
+}
+EXPORT_SYMBOL(badger_trap_clear_targets);
+
+/*
+ * Turn on badger trap for the whole address space of the task with the given
+ * (virtual) pid. Returns 0 on success.
+ */
+static int badger_trap_start_pid(pid_t pid)
+{
+	struct task_struct *tsk;
+	struct mm_struct *mm;
+
+	rcu_read_lock();
+	tsk = find_task_by_vpid(pid);
+	if (tsk)
+		get_task_struct(tsk);
+	rcu_read_unlock();
+
+	if (!tsk)
+		return -ESRCH;
+
+	mm = get_task_mm(tsk);
+	put_task_struct(tsk);
+
+	if (!mm)
+		return -EINVAL;
+
+	badger_trap_walk(mm, 0, ~0ull, true);
+	mmput(mm);
+
+	return 0;
+}
+
 /*
  * This syscall is generic way of setting up badger trap.
  * There are three options to start badger trap.
  * (1) 	option > 0: provide all process names with number of processes.
  * 	This will mark the process names for badger trap to start when any
- * 	process with names specified will start.
+ * 	process with names specified will start. The new list of names
+ * 	replaces any previously registered names.
  *
  * (2) 	option == 0: starts badger trap for the process calling the syscall itself.
  *  	This requires binary to be updated for the workload to call badger trap. This
@@ -38,43 +296,64 @@ EXPORT_SYMBOL(silence);
  *		(2) and (3) will not mark the already spawned child processes for badger
  *		trap when you mark the parent process for badger trap on the fly. But (2) and (3)
  *		will mark all child spwaned from the parent process adter being marked for badger trap.
+ *
+ *  Pids and cgroups can also be registered for matching at exec time via
+ *  /sys/kernel/mm/badger_trap/targets.
  */
 SYSCALL_DEFINE3(init_badger_trap,
 		const char __user**, process_name_user,
 		unsigned long, num_procs, int, option)
 {
 	unsigned int i;
-	char *temp;
-	unsigned long ret = 0;
-	char **process_name = NULL;
+	long ret = 0;
+	const char __user **process_name = NULL;
 	char proc[MAX_NAME_LEN];
-	struct task_struct * tsk;
-	unsigned long pid;
+	int pid;
 
-	process_name = vmalloc(sizeof(char*) * num_procs);
-	if (!process_name) {
-		return -ENOMEM;
-	}
+	if (option != 0) {
+		if (num_procs == 0 || num_procs > PID_MAX_LIMIT)
+			return -EINVAL;
+
+		process_name = vmalloc(sizeof(char*) * num_procs);
+		if (!process_name) {
+			return -ENOMEM;
+		}
 
-	ret = copy_from_user(process_name, process_name_user, sizeof(char*) * num_procs);
-	if (ret) {
-		return ret;
+		if (copy_from_user(process_name, process_name_user,
+				   sizeof(char*) * num_procs)) {
+			ret = -EFAULT;
+			goto out;
+		}
 	}
 
 	pr_warn("init_badger_trap %p %lu %d", process_name, num_procs, option);
 
 	if(option > 0)
 	{
-		for(i = 0; i < CONFIG_NR_CPUS; i++)
+		badger_trap_clear_targets(BT_TARGET_COMM);
+
+		for(i = 0; i < num_procs; i++)
 		{
-			if(i<num_procs) {
-				pr_warn("copy from user name=%p", process_name[i]);
-				ret = strncpy_from_user(proc, process_name[i], MAX_NAME_LEN);
-				pr_warn("copy from user name=%s", proc);
-			} else
-				temp = strncpy(proc, "", MAX_NAME_LEN);
-			temp = strncpy(badger_trap_process[i], proc, MAX_NAME_LEN-1);
+			ret = strncpy_from_user(proc, process_name[i], MAX_NAME_LEN);
+			if (ret < 0)
+				goto out;
+			proc[MAX_NAME_LEN - 1] = '\0';
+
+			ret = badger_trap_register_comm(proc);
+			if (ret == 0) {
+				pr_warn("BadgerTrap: registered process name=%s\n",
+					proc);
+			} else if (ret == -EEXIST || ret == -EINVAL) {
+				// Duplicate or empty names are skipped.
+				pr_warn("BadgerTrap: skipped process name=%s (%d)\n",
+					proc, ret);
+			} else {
+				pr_warn("BadgerTrap: failed to register process name=%s (%d)\n",
+					proc, ret);
+				goto out;
+			}
 		}
+		ret = 0;
 	}
 	else if(option == 0)
 	{
@@ -82,39 +361,83 @@ SYSCALL_DEFINE3(init_badger_trap,
 	}
 	else if(option < 0)
 	{
-		for(i = 0; i < CONFIG_NR_CPUS; i++)
+		for(i = 0; i < num_procs; i++)
 		{
-			if(i < num_procs)
-			{
-				ret = kstrtoul(process_name[i], 10, &pid);
-				if(ret == 0)
-				{
-					tsk = find_task_by_vpid(pid);
-					badger_trap_walk(tsk->mm, 0, ~0ull, true);
-				}
-			}
+			ret = strncpy_from_user(proc, process_name[i], MAX_NAME_LEN);
+			if (ret < 0)
+				goto out;
+			proc[MAX_NAME_LEN - 1] = '\0';
+
+			if (kstrtoint(proc, 10, &pid) != 0)
+				continue;
+
+			if (badger_trap_start_pid(pid) != 0)
+				pr_warn("BadgerTrap: unable to start for pid=%d\n", pid);
 		}
+		ret = 0;
 	}
 
-	return 0;
+out:
+	if (process_name)
+		vfree(process_name);
+
+	return ret;
+}
+
+static bool bt_match(struct badger_trap_target *target, struct task_struct *tsk)
+{
+	if (!target)
+		return false;
+
+	atomic64_inc(&target->nmatches);
+	WRITE_ONCE(target->last_pid, tsk->pid);
+
+	pr_warn("Badger Trap process (%s) matched %s target.",
+			tsk->comm, bt_target_type_names[target->type]);
+
+	return true;
 }
 
 /*
- * This function checks whether a process name provided matches from the list
- * of process names stored to be marked for badger trap.
+ * This function checks whether the given task matches any of the registered
+ * targets (by comm, by pid or by cgroup) to be marked for badger trap.
  */
-bool is_badger_trap_process(const char* proc_name)
+bool is_badger_trap_process(struct task_struct *tsk)
 {
-	unsigned int i;
-	for(i = 0; i < CONFIG_NR_CPUS; i++)
-	{
-		if(!strncmp(proc_name, badger_trap_process[i], MAX_NAME_LEN)) {
-			pr_warn("Badger Trap process (%s).", proc_name);
-			return true;
-		}
+	struct badger_trap_target *target;
+	bool found = false;
+
+	// Nothing is registered, so nobody matches.
+	if (likely(atomic_read(&bt_nr_targets) == 0))
+		return false;
+
+	rcu_read_lock();
+
+	target = bt_target_find(BT_TARGET_COMM, bt_comm_key(tsk->comm),
+			tsk->comm);
+	if (bt_match(target, tsk)) {
+		found = true;
+		goto out;
+	}
+
+	target = bt_target_find(BT_TARGET_PID, tsk->pid, NULL);
+	if (bt_match(target, tsk)) {
+		found = true;
+		goto out;
+	}
+
+#ifdef CONFIG_CGROUPS
+	target = bt_target_find(BT_TARGET_CGROUP,
+			cgroup_id(task_dfl_cgroup(tsk)), NULL);
+	if (bt_match(target, tsk)) {
+		found = true;
+		goto out;
 	}
-	//pr_info("NOT Badger Trap process (%s).", proc_name);
-	return false;
+#endif
+
+out:
+	rcu_read_unlock();
+	return found;
 }
 
 /*
@@ -268,13 +591,13 @@ static int bt_init_hugetlb_entry(pte_t *ptep, unsigned long hmask,
 	if (!(pte_flags(pte) & _PAGE_USER))
 		return 0;
 
-	/*
+	// This may be a 2MB or a 1GB page; either way, it is reserved the same
+	// way as a pte.
 	if (*(bool*)walk->private) {
-		*pte = pte_mkreserve(*pte);
+		pte = pte_mkreserve(pte);
 	} else {
-		*pte = pte_unreserve(*pte);
+		pte = pte_unreserve(pte);
 	}
-	*/
 	set_huge_pte_at(walk->mm, addr, ptep, pte);
 
 	return 0;
@@ -310,6 +633,124 @@ void badger_trap_set_stats_loc(struct mm_struct *mm, struct badger_trap_stats *s
 }
 EXPORT_SYMBOL(badger_trap_set_stats_loc);
 
+/*
+ * Set the function to call for new or grown VMAs of mm, or clear it with
+ * NULL. Since callers of badger_trap_vma_event() hold mmap_sem, no call to
+ * the old function is still running once this returns.
+ */
+void badger_trap_set_vma_event_fn(struct mm_struct *mm,
+		badger_trap_vma_event_fn_t fn)
+{
+	BUG_ON(!mm);
+	down_write(&mm->mmap_sem);
+	WRITE_ONCE(mm->bt_vma_event, fn);
+	up_write(&mm->mmap_sem);
+}
+EXPORT_SYMBOL(badger_trap_set_vma_event_fn);
+
+/*
+ * Start counting misses in vma, if BadgerTrap has ever been turned on for its
+ * mm. If the allocation fails, misses in the VMA just aren't counted per-VMA.
+ */
+void badger_trap_vma_stats_alloc(struct vm_area_struct *vma)
+{
+	struct mm_struct *mm = vma->vm_mm;
+
+	if (vma->bt_stats || !mm || !READ_ONCE(mm->badger_trap_was_enabled))
+		return;
+
+	vma->bt_stats = kzalloc(sizeof(*vma->bt_stats), GFP_KERNEL);
+	if (vma->bt_stats)
+		vma->bt_stats->start = jiffies;
+}
+
+/*
+ * new is a copy of orig (vm_area_dup), and starts out with the same counts,
+ * since it usually becomes part of orig (split) or replaces it (mremap).
+ */
+void badger_trap_vma_stats_dup(struct vm_area_struct *new,
+		const struct vm_area_struct *orig)
+{
+	new->bt_stats = NULL;
+	if (orig->bt_stats)
+		new->bt_stats = kmemdup(orig->bt_stats, sizeof(*orig->bt_stats),
+				GFP_KERNEL);
+}
+
+// Move the share of *from that corresponds to `part` out of `whole` to *to.
+static void bt_split_count(atomic64_t *from, atomic64_t *to,
+		u64 part, u64 whole)
+{
+	u64 total = atomic64_read(from);
+	u64 moved = mult_frac(total, part, whole);
+
+	atomic64_set(to, moved);
+	atomic64_set(from, total - moved);
+}
+
+/*
+ * vma was just split into vma and new, which both have the counts of the
+ * whole VMA. Share them out by size, since we assume the misses are spread
+ * evenly over the VMA anyway (see bt_vma_miss_est_fn).
+ *
+ * Caller must hold mmap_sem for write, so no misses are being counted.
+ */
+void badger_trap_vma_stats_split(struct vm_area_struct *vma,
+		struct vm_area_struct *new)
+{
+	struct badger_trap_stats *from, *to;
+	u64 part, whole;
+
+	if (!vma->bt_stats || !new->bt_stats)
+		return;
+
+	from = &vma->bt_stats->stats;
+	to = &new->bt_stats->stats;
+	part = new->vm_end - new->vm_start;
+	whole = part + (vma->vm_end - vma->vm_start);
+
+	bt_split_count(&from->total_dtlb_4kb_load_misses,
+			&to->total_dtlb_4kb_load_misses, part, whole);
+	bt_split_count(&from->total_dtlb_4kb_store_misses,
+			&to->total_dtlb_4kb_store_misses, part, whole);
+	bt_split_count(&from->total_dtlb_2mb_load_misses,
+			&to->total_dtlb_2mb_load_misses, part, whole);
+	bt_split_count(&from->total_dtlb_2mb_store_misses,
+			&to->total_dtlb_2mb_store_misses, part, whole);
+	bt_split_count(&from->total_dtlb_1gb_load_misses,
+			&to->total_dtlb_1gb_load_misses, part, whole);
+	bt_split_count(&from->total_dtlb_1gb_store_misses,
+			&to->total_dtlb_1gb_store_misses, part, whole);
+}
+
+// Restart the counts of vma from zero, e.g. for the child's copy at fork.
+void badger_trap_vma_stats_clear(struct vm_area_struct *vma)
+{
+	if (vma->bt_stats) {
+		badger_trap_stats_clear(&vma->bt_stats->stats);
+		vma->bt_stats->start = jiffies;
+	}
+}
+
+void badger_trap_vma_stats_free(struct vm_area_struct *vma)
+{
+	kfree(vma->bt_stats);
+	vma->bt_stats = NULL;
+}
+
+/*
+ * Start the per-VMA counts of mm.
+ *
+ * Caller must hold mmap_sem for write.
+ */
+static void bt_alloc_vma_stats(struct mm_struct *mm)
+{
+	struct vm_area_struct *vma;
+
+	for (vma = mm->mmap; vma; vma = vma->vm_next)
+		badger_trap_vma_stats_alloc(vma);
+}
+
 /*
  * This function walks the page tables of the given mm_struct for pages mapped
  * between the given lower and upper addresses (inclusive). Depending on the
@@ -361,8 +802,14 @@ void badger_trap_walk(struct mm_struct *mm, u64 lower, u64 upper, bool init)
 		// Round up to hpage boundary, but subtract 1 to make it inclusive.
 		mm->badger_trap_end = ((upper - 1) & HPAGE_PMD_MASK) + HPAGE_PMD_SIZE - 1;
 		mm->badger_trap_enabled = true;
-		mm->badger_trap_was_enabled = true;
 		badger_trap_stats_clear(mm->bt_stats);
+		// kbadgerd turns BadgerTrap on again for each range it
+		// samples, so only start the per-VMA counts the first time.
+		// From then on, new VMAs get their own in vm_area_alloc().
+		if (!mm->badger_trap_was_enabled) {
+			WRITE_ONCE(mm->badger_trap_was_enabled, true);
+			bt_alloc_vma_stats(mm);
+		}
 	}
 
 	// Block any other page faults from changing the mappings while we walk.
@@ -417,6 +864,10 @@ void print_badger_trap_stats(const struct mm_struct *mm) {
 			atomic64_read_acquire(&mm->bt_stats->total_dtlb_4kb_store_misses));
 	pr_warn("BadgerTrap: DTLB store miss for 2MB page detected %llu\n",
 			atomic64_read_acquire(&mm->bt_stats->total_dtlb_2mb_store_misses));
+	pr_warn("BadgerTrap: DTLB load miss for 1GB page detected %llu\n",
+			atomic64_read_acquire(&mm->bt_stats->total_dtlb_1gb_load_misses));
+	pr_warn("BadgerTrap: DTLB store miss for 1GB page detected %llu\n",
+			atomic64_read_acquire(&mm->bt_stats->total_dtlb_1gb_store_misses));
 	/*
 	pr_warn("-----------------------------------\n");
 	for (vma = mm->mmap; vma; vma = vma->vm_next) {
@@ -435,3 +886,301 @@ void print_badger_trap_stats(const struct mm_struct *mm) {
 	pr_warn("===================================\n");
 }
 EXPORT_SYMBOL(print_badger_trap_stats);
+
+///////////////////////////////////////////////////////////////////////////////
+// Per-VMA miss counts
+
+static u64 bt_vma_total_misses(const struct vm_area_struct *vma)
+{
+	const struct badger_trap_stats *stats = &vma->bt_stats->stats;
+
+	return atomic64_read(&stats->total_dtlb_4kb_load_misses)
+		+ atomic64_read(&stats->total_dtlb_4kb_store_misses)
+		+ atomic64_read(&stats->total_dtlb_2mb_load_misses)
+		+ atomic64_read(&stats->total_dtlb_2mb_store_misses)
+		+ atomic64_read(&stats->total_dtlb_1gb_load_misses)
+		+ atomic64_read(&stats->total_dtlb_1gb_store_misses);
+}
+
+// The number of ms the counters of vma have been running for (at least 1).
+static u64 bt_vma_elapsed_ms(const struct vm_area_struct *vma)
+{
+	return max(jiffies_to_msecs(jiffies - vma->bt_stats->start), 1u);
+}
+
+// The rate of misses in the whole VMA so far, in misses per LTU.
+static u64 bt_vma_misses_per_ltu(const struct vm_area_struct *vma)
+{
+	if (!vma->bt_stats)
+		return 0;
+
+	return mult_frac(bt_vma_total_misses(vma), (u64)MM_ECON_LTU,
+			bt_vma_elapsed_ms(vma));
+}
+
+/*
+ * /proc/<pid>/badger_trap_vmas: the misses BadgerTrap has counted in each VMA
+ * of the process since it was first turned on (or since the VMA was created),
+ * one VMA per line. `ms` is how long the VMA has been counted for, and
+ * `misses_per_ltu` is the rate of all misses in the VMA over that time. When a
+ * VMA is split, its counts are shared between the parts by size.
+ */
+int proc_pid_badger_trap_vmas(struct seq_file *m, struct pid_namespace *ns,
+		struct pid *pid, struct task_struct *task)
+{
+	struct mm_struct *mm;
+	struct vm_area_struct *vma;
+
+	mm = mm_access(task, PTRACE_MODE_READ_FSCREDS);
+	if (IS_ERR_OR_NULL(mm))
+		return mm ? PTR_ERR(mm) : 0;
+
+	down_read(&mm->mmap_sem);
+
+	seq_printf(m, "# enabled=%d start=%llx end=%llx ltu_ms=%u\n",
+			mm->badger_trap_enabled, mm->badger_trap_start,
+			mm->badger_trap_end, MM_ECON_LTU);
+	seq_puts(m, "# start end ld_4kb st_4kb ld_2mb st_2mb ld_1gb st_1gb "
+			"ms misses_per_ltu\n");
+
+	if (mm->badger_trap_was_enabled) {
+		for (vma = mm->mmap; vma; vma = vma->vm_next) {
+			const struct badger_trap_stats *stats;
+
+			// The allocation failed, nothing was counted.
+			if (!vma->bt_stats)
+				continue;
+
+			stats = &vma->bt_stats->stats;
+
+			seq_printf(m, "%lx %lx %lld %lld %lld %lld %lld %lld %llu %llu\n",
+				vma->vm_start, vma->vm_end,
+				atomic64_read(&stats->total_dtlb_4kb_load_misses),
+				atomic64_read(&stats->total_dtlb_4kb_store_misses),
+				atomic64_read(&stats->total_dtlb_2mb_load_misses),
+				atomic64_read(&stats->total_dtlb_2mb_store_misses),
+				atomic64_read(&stats->total_dtlb_1gb_load_misses),
+				atomic64_read(&stats->total_dtlb_1gb_store_misses),
+				bt_vma_elapsed_ms(vma),
+				bt_vma_misses_per_ltu(vma));
+		}
+	}
+
+	up_read(&mm->mmap_sem);
+	mmput(mm);
+
+	return 0;
+}
+
+#ifdef CONFIG_MM_ECON
+/*
+ * A mm_econ_vma_miss_estimator_fn_t. We assume that the misses counted in the
+ * VMA containing the address are spread uniformly across it, so the huge page
+ * gets the share of the VMA's miss rate that it overlaps.
+ *
+ * This only knows about the current process, and there is nothing to say if
+ * BadgerTrap was never turned on for it or hasn't seen any misses in the VMA,
+ * in which case we return false so that mm_econ can look elsewhere.
+ *
+ * Caller must hold current->mm->mmap_sem, as the #PF path does.
+ */
+static bool bt_vma_miss_est_fn(const struct mm_action *action, u64 *misses)
+{
+	const u64 size = PAGE_SIZE << action->huge_page_order;
+	const u64 start = action->address & ~(size - 1);
+	struct mm_struct *mm = current->mm;
+	struct vm_area_struct *vma;
+	u64 rate, overlap;
+
+	if (!mm || !mm->badger_trap_was_enabled)
+		return false;
+
+	vma = find_vma(mm, action->address);
+	if (!vma || vma->vm_start > action->address)
+		return false;
+
+	rate = bt_vma_misses_per_ltu(vma);
+	if (rate == 0)
+		return false;
+
+	overlap = min(start + size, (u64)vma->vm_end)
+		- max(start, (u64)vma->vm_start);
+	*misses = mult_frac(rate, overlap, (u64)(vma->vm_end - vma->vm_start));
+
+	return true;
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// sysfs files
+
+/*
+ * Reading lists the registered targets and their stats, one per line:
+ *
+ *	<comm|pid|cgroup> <value> matches=<n> last_pid=<pid>
+ *
+ * Writing registers or unregisters a single target:
+ *
+ *	[+|-]<comm|pid|cgroup> <value>
+ *
+ * or clears all targets of one type (or of every type):
+ *
+ *	clear [comm|pid|cgroup]
+ */
+static ssize_t targets_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	struct badger_trap_target *target;
+	ssize_t len = 0;
+	int type, bkt;
+
+	mutex_lock(&bt_targets_mutex);
+	for (type = 0; type < BT_NR_TARGET_TYPES; type++) {
+		hash_for_each(bt_targets[type], bkt, target, node) {
+			len += scnprintf(&buf[len], PAGE_SIZE - len, "%s ",
+					bt_target_type_names[type]);
+
+			if (type == BT_TARGET_COMM)
+				len += scnprintf(&buf[len], PAGE_SIZE - len,
+						"%s", target->comm);
+			else
+				len += scnprintf(&buf[len], PAGE_SIZE - len,
+						"%llu", target->key);
+
+			len += scnprintf(&buf[len], PAGE_SIZE - len,
+					" matches=%lld last_pid=%d\n",
+					atomic64_read(&target->nmatches),
+					READ_ONCE(target->last_pid));
+		}
+	}
+	mutex_unlock(&bt_targets_mutex);
+
+	return len;
+}
+
+static int bt_parse_target_type(const char *buf, enum badger_trap_target_type *type)
+{
+	int i;
+
+	for (i = 0; i < BT_NR_TARGET_TYPES; i++) {
+		if (strcmp(buf, bt_target_type_names[i]) == 0) {
+			*type = i;
+			return 0;
+		}
+	}
+
+	return -EINVAL;
+}
+
+static ssize_t targets_store(struct kobject *kobj,
+		struct kobj_attribute *attr,
+		const char *buf, size_t count)
+{
+	enum badger_trap_target_type type;
+	char *input, *cmd, *value, *p;
+	bool add = true;
+	u64 id;
+	int ret;
+
+	input = kstrndup(buf, count, GFP_KERNEL);
+	if (!input)
+		return -ENOMEM;
+
+	p = strim(input);
+	cmd = strsep(&p, " \t");
+	value = p ? strim(p) : NULL;
+
+	if (strcmp(cmd, "clear") == 0) {
+		if (!value || value[0] == '\0') {
+			for (type = 0; type < BT_NR_TARGET_TYPES; type++)
+				badger_trap_clear_targets(type);
+			ret = 0;
+		} else if ((ret = bt_parse_target_type(value, &type)) == 0) { // NOTE: assignment
+			badger_trap_clear_targets(type);
+		}
+		goto out;
+	}
+
+	if (cmd[0] == '+' || cmd[0] == '-') {
+		add = cmd[0] == '+';
+		cmd++;
+	}
+
+	ret = bt_parse_target_type(cmd, &type);
+	if (ret != 0 || !value || value[0] == '\0') {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	if (type == BT_TARGET_COMM) {
+		if (strlen(value) >= MAX_NAME_LEN) {
+			ret = -EINVAL;
+			goto out;
+		}
+
+		ret = add ? badger_trap_register_comm(value)
+			  : badger_trap_unregister_comm(value);
+		goto out;
+	}
+
+	ret = kstrtou64(value, 0, &id);
+	if (ret != 0)
+		goto out;
+
+	if (type == BT_TARGET_PID) {
+		if (id > PID_MAX_LIMIT) {
+			ret = -EINVAL;
+			goto out;
+		}
+
+		ret = add ? badger_trap_register_pid(id)
+			  : badger_trap_unregister_pid(id);
+	} else {
+		ret = add ? badger_trap_register_cgroup(id)
+			  : badger_trap_unregister_cgroup(id);
+	}
+
+out:
+	kfree(input);
+	return ret ? ret : count;
+}
+static struct kobj_attribute targets_attr =
+__ATTR(targets, 0644, targets_show, targets_store);
+
+static struct attribute *badger_trap_attr[] = {
+	&targets_attr.attr,
+	NULL,
+};
+
+static const struct attribute_group badger_trap_attr_group = {
+	.attrs = badger_trap_attr,
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Init
+
+static int __init badger_trap_init(void)
+{
+	struct kobject *badger_trap_kobj;
+	int err;
+
+	badger_trap_kobj = kobject_create_and_add("badger_trap", mm_kobj);
+	if (unlikely(!badger_trap_kobj)) {
+		pr_err("failed to create badger_trap kobject\n");
+		return -ENOMEM;
+	}
+
+	err = sysfs_create_group(badger_trap_kobj, &badger_trap_attr_group);
+	if (err) {
+		pr_err("failed to register badger_trap group\n");
+		kobject_put(badger_trap_kobj);
+		return err;
+	}
+
+#ifdef CONFIG_MM_ECON
+	register_mm_econ_vma_miss_estimator(bt_vma_miss_est_fn);
+#endif
+
+	return 0;
+}
+subsys_initcall(badger_trap_init);
@@ -0,0 +1,780 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * KUnit tests for the mmap filters and profile ranges in mm/estimator.c,
+ * plus microbenchmarks for mm_add_memory_range() and profile lookups.
+ *
+ * This file is included at the bottom of estimator.c so that it can get at
+ * the static helpers.
+ */
+
+#include <kunit/test.h>
+#include <linux/ktime.h>
+#include <linux/mman.h>
+
+// A pid that never belongs to a real task, so that the tests don't interfere
+// with any profiles installed at boot.
+#define MM_ECON_TEST_PID (-4242)
+#define MM_ECON_TEST_PID_CHILD (-4243)
+
+#define MM_ECON_TEST_BASE 0x7f0000000000ULL
+
+struct mm_econ_test_range {
+    u64 start;
+    u64 end;
+    u64 benefit;
+};
+
+struct mm_econ_test_ctx {
+    struct mmap_filter_proc *proc;
+    u64 vmalloc_bytes;
+    u64 profile_copies;
+};
+
+static int mm_econ_test_init(struct kunit *test)
+{
+    struct mm_econ_test_ctx *ctx;
+    struct mmap_filter_proc *proc;
+
+    ctx = kunit_kzalloc(test, sizeof(*ctx), GFP_KERNEL);
+    if (!ctx)
+        return -ENOMEM;
+
+    ctx->vmalloc_bytes = mm_econ_vmalloc_bytes;
+    ctx->profile_copies = mm_econ_num_profile_copies;
+
+    proc = mm_econ_vmalloc(sizeof(struct mmap_filter_proc));
+    if (!proc)
+        return -ENOMEM;
+
+    proc->pid = MM_ECON_TEST_PID;
+    proc->profile = mm_profile_alloc();
+    if (!proc->profile) {
+        mm_econ_vfree(proc, sizeof(struct mmap_filter_proc));
+        return -ENOMEM;
+    }
+
+    down_write(&filter_procs_sem);
+    list_add_tail(&proc->node, &filter_procs);
+    up_write(&filter_procs_sem);
+
+    ctx->proc = proc;
+    test->priv = ctx;
+
+    return 0;
+}
+
+static void mm_econ_test_exit(struct kunit *test)
+{
+    mm_profile_check_exiting_proc(MM_ECON_TEST_PID_CHILD);
+    mm_profile_check_exiting_proc(MM_ECON_TEST_PID);
+}
+
+static struct mmap_filter *
+mm_econ_test_add_filter(struct kunit *test, enum mm_memory_section section,
+        enum mm_policy policy, u64 benefit)
+{
+    struct mm_econ_test_ctx *ctx = test->priv;
+    struct mmap_filter *filter;
+
+    filter = mm_econ_vmalloc(sizeof(struct mmap_filter));
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, filter);
+
+    filter->section = section;
+    filter->policy = policy;
+    filter->benefit = benefit;
+    INIT_LIST_HEAD(&filter->comparisons);
+
+    down_write(&filter_procs_sem);
+    list_add_tail(&filter->node, &ctx->proc->profile->filters);
+    up_write(&filter_procs_sem);
+
+    return filter;
+}
+
+static void
+mm_econ_test_add_comparison(struct kunit *test, struct mmap_filter *filter,
+        enum mmap_quantity quant, enum mmap_comparator comp, u64 val)
+{
+    struct mmap_comparison *comparison;
+
+    comparison = mm_econ_vmalloc(sizeof(struct mmap_comparison));
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, comparison);
+
+    comparison->quant = quant;
+    comparison->comp = comp;
+    comparison->val = val;
+
+    down_write(&filter_procs_sem);
+    list_add_tail(&comparison->node, &filter->comparisons);
+    up_write(&filter_procs_sem);
+}
+
+static struct profile_range *
+mm_econ_test_insert(struct kunit *test, struct rb_root *root,
+        u64 start, u64 end, u64 benefit)
+{
+    struct profile_range *range;
+
+    range = mm_econ_vmalloc(sizeof(struct profile_range));
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, range);
+
+    range->start = start;
+    range->end = end;
+    range->benefit = benefit;
+    profile_range_insert(root, range);
+
+    return range;
+}
+
+// Check that the tree holds exactly the expected ranges, in order.
+static void
+mm_econ_test_expect_ranges(struct kunit *test, struct rb_root *root,
+        const struct mm_econ_test_range *expected, int n)
+{
+    struct rb_node *node;
+    int i = 0;
+
+    for (node = rb_first(root); node; node = rb_next(node), i++) {
+        struct profile_range *range =
+            container_of(node, struct profile_range, node);
+
+        if (i >= n)
+            continue;
+
+        KUNIT_EXPECT_EQ(test, range->start, expected[i].start);
+        KUNIT_EXPECT_EQ(test, range->end, expected[i].end);
+        KUNIT_EXPECT_EQ(test, range->benefit, expected[i].benefit);
+    }
+
+    KUNIT_EXPECT_EQ(test, i, n);
+}
+
+static void mm_econ_test_add_mmap(struct kunit *test, u64 mapaddr, u64 len)
+{
+    mm_add_memory_range(MM_ECON_TEST_PID, SectionMmap, mapaddr, 0, 0, len,
+            PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Profile range trees
+
+static void mm_econ_test_insert_overlapping(struct kunit *test)
+{
+    struct rb_root root = RB_ROOT;
+    const struct mm_econ_test_range before[] = {
+        { 0x1000, 0x3000, 1 },
+        { 0x5000, 0x6000, 2 },
+        { 0x8000, 0x9000, 3 },
+    };
+    const struct mm_econ_test_range after[] = {
+        { 0x2000, 0x5800, 4 },
+        { 0x8000, 0x9000, 3 },
+    };
+    const struct mm_econ_test_range adjacent[] = {
+        { 0x2000, 0x5800, 4 },
+        { 0x5800, 0x8000, 5 },
+        { 0x8000, 0x9000, 3 },
+    };
+
+    mm_econ_test_insert(test, &root, 0x5000, 0x6000, 2);
+    mm_econ_test_insert(test, &root, 0x1000, 0x3000, 1);
+    mm_econ_test_insert(test, &root, 0x8000, 0x9000, 3);
+    mm_econ_test_expect_ranges(test, &root, before, ARRAY_SIZE(before));
+
+    // A new range replaces everything it overlaps...
+    mm_econ_test_insert(test, &root, 0x2000, 0x5800, 4);
+    mm_econ_test_expect_ranges(test, &root, after, ARRAY_SIZE(after));
+
+    // ... but ends are exclusive, so touching ranges are left alone.
+    mm_econ_test_insert(test, &root, 0x5800, 0x8000, 5);
+    mm_econ_test_expect_ranges(test, &root, adjacent, ARRAY_SIZE(adjacent));
+
+    profile_free_all(&root);
+}
+
+static void mm_econ_test_search(struct kunit *test)
+{
+    struct rb_root root = RB_ROOT;
+    struct profile_range *a, *b;
+
+    a = mm_econ_test_insert(test, &root, 0x1000, 0x3000, 1);
+    b = mm_econ_test_insert(test, &root, 0x3000, 0x4000, 2);
+    mm_econ_test_insert(test, &root, 0x6000, 0x7000, 3);
+
+    KUNIT_EXPECT_PTR_EQ(test, profile_search(&root, 0x1000), a);
+    KUNIT_EXPECT_PTR_EQ(test, profile_search(&root, 0x2fff), a);
+    KUNIT_EXPECT_PTR_EQ(test, profile_search(&root, 0x3000), b);
+    KUNIT_EXPECT_PTR_EQ(test, profile_search(&root, 0x0fff),
+            (struct profile_range *)NULL);
+    KUNIT_EXPECT_PTR_EQ(test, profile_search(&root, 0x5000),
+            (struct profile_range *)NULL);
+    KUNIT_EXPECT_PTR_EQ(test, profile_search(&root, 0x7000),
+            (struct profile_range *)NULL);
+
+    profile_free_all(&root);
+}
+
+static void mm_econ_test_find_first_range(struct kunit *test)
+{
+    struct rb_root root = RB_ROOT;
+    struct profile_range *a, *b, *c;
+
+    a = mm_econ_test_insert(test, &root, 0x0000, 0x1000, 0);
+    b = mm_econ_test_insert(test, &root, 0x1000, 0x2000, 0);
+    c = mm_econ_test_insert(test, &root, 0x2000, 0x3000, 0);
+
+    // The first range with some address greater than the key
+    KUNIT_EXPECT_PTR_EQ(test,
+            profile_find_first_range(&root, 0x1800, CompGreaterThan), b);
+    KUNIT_EXPECT_PTR_EQ(test,
+            profile_find_first_range(&root, 0x0000, CompGreaterThan), a);
+    KUNIT_EXPECT_PTR_EQ(test,
+            profile_find_first_range(&root, 0x3000, CompGreaterThan),
+            (struct profile_range *)NULL);
+
+    // The last range with some address less than the key
+    KUNIT_EXPECT_PTR_EQ(test,
+            profile_find_first_range(&root, 0x1800, CompLessThan), b);
+    KUNIT_EXPECT_PTR_EQ(test,
+            profile_find_first_range(&root, 0x4000, CompLessThan), c);
+    KUNIT_EXPECT_PTR_EQ(test,
+            profile_find_first_range(&root, 0x0000, CompLessThan),
+            (struct profile_range *)NULL);
+
+    // The range containing the key
+    KUNIT_EXPECT_PTR_EQ(test,
+            profile_find_first_range(&root, 0x2000, CompEquals), c);
+    KUNIT_EXPECT_PTR_EQ(test,
+            profile_find_first_range(&root, 0x3000, CompEquals),
+            (struct profile_range *)NULL);
+
+    profile_free_all(&root);
+}
+
+static void mm_econ_test_split_greater(struct kunit *test)
+{
+    struct rb_root root = RB_ROOT;
+    struct profile_range *range;
+    const struct mm_econ_test_range expected[] = {
+        { 0x1000, 0x4000, 0 },
+        { 0x4000, 0x9000, 7 },
+    };
+
+    range = mm_econ_test_insert(test, &root, 0x1000, 0x9000, 7);
+    KUNIT_EXPECT_TRUE(test,
+            mm_split_ranges(range, &root, 0x4000, CompGreaterThan));
+    mm_econ_test_expect_ranges(test, &root, expected, ARRAY_SIZE(expected));
+
+    // Splitting at or below the start is a no-op
+    KUNIT_EXPECT_TRUE(test,
+            mm_split_ranges(range, &root, 0x4000, CompGreaterThan));
+    mm_econ_test_expect_ranges(test, &root, expected, ARRAY_SIZE(expected));
+
+    profile_free_all(&root);
+}
+
+static void mm_econ_test_split_less(struct kunit *test)
+{
+    struct rb_root root = RB_ROOT;
+    struct profile_range *range;
+    const struct mm_econ_test_range expected[] = {
+        { 0x1000, 0x4000, 7 },
+        { 0x4000, 0x9000, 0 },
+    };
+
+    range = mm_econ_test_insert(test, &root, 0x1000, 0x9000, 7);
+    KUNIT_EXPECT_TRUE(test,
+            mm_split_ranges(range, &root, 0x4000, CompLessThan));
+    mm_econ_test_expect_ranges(test, &root, expected, ARRAY_SIZE(expected));
+
+    // Splitting at or past the end is a no-op
+    KUNIT_EXPECT_TRUE(test,
+            mm_split_ranges(range, &root, 0x9000, CompLessThan));
+    mm_econ_test_expect_ranges(test, &root, expected, ARRAY_SIZE(expected));
+
+    profile_free_all(&root);
+}
+
+static void mm_econ_test_split_equals(struct kunit *test)
+{
+    struct rb_root root = RB_ROOT;
+    struct profile_range *range;
+    const struct mm_econ_test_range middle[] = {
+        { 0x1000, 0x4000, 0 },
+        { 0x4000, 0x5000, 7 },
+        { 0x5000, 0x9000, 0 },
+    };
+    const struct mm_econ_test_range at_start[] = {
+        { 0x1000, 0x2000, 7 },
+        { 0x2000, 0x9000, 0 },
+    };
+    const struct mm_econ_test_range at_end[] = {
+        { 0x1000, 0x8000, 0 },
+        { 0x8000, 0x9000, 7 },
+    };
+
+    range = mm_econ_test_insert(test, &root, 0x1000, 0x9000, 7);
+    KUNIT_EXPECT_TRUE(test, mm_split_ranges(range, &root, 0x4000, CompEquals));
+    mm_econ_test_expect_ranges(test, &root, middle, ARRAY_SIZE(middle));
+    profile_free_all(&root);
+
+    range = mm_econ_test_insert(test, &root, 0x1000, 0x9000, 7);
+    KUNIT_EXPECT_TRUE(test, mm_split_ranges(range, &root, 0x1000, CompEquals));
+    mm_econ_test_expect_ranges(test, &root, at_start, ARRAY_SIZE(at_start));
+    profile_free_all(&root);
+
+    range = mm_econ_test_insert(test, &root, 0x1000, 0x9000, 7);
+    KUNIT_EXPECT_TRUE(test, mm_split_ranges(range, &root, 0x8000, CompEquals));
+    mm_econ_test_expect_ranges(test, &root, at_end, ARRAY_SIZE(at_end));
+    profile_free_all(&root);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Filter matching in mm_add_memory_range
+
+static void mm_econ_test_match_whole_range(struct kunit *test)
+{
+    struct mm_econ_test_ctx *ctx = test->priv;
+    struct mmap_filter *filter;
+    const u64 base = MM_ECON_TEST_BASE;
+    const struct mm_econ_test_range huge[] = {
+        { base, base + 0x10000, 5 },
+    };
+    const struct mm_econ_test_range none[] = {
+        { base, base + 0x10000, 0 },
+    };
+
+    filter = mm_econ_test_add_filter(test, SectionMmap, PolicyHugePage, 5);
+    mm_econ_test_add_comparison(test, filter, QuantLen, CompGreaterThan, 0x1000);
+
+    // The length is rounded up to a page
+    mm_econ_test_add_mmap(test, base, 0x10000 - 0x10);
+
+    mm_econ_test_expect_ranges(test, &ctx->proc->profile->hp_ranges_root,
+            huge, ARRAY_SIZE(huge));
+    mm_econ_test_expect_ranges(test, &ctx->proc->profile->eager_ranges_root,
+            none, ARRAY_SIZE(none));
+}
+
+static void mm_econ_test_match_quantities(struct kunit *test)
+{
+    struct mm_econ_test_ctx *ctx = test->priv;
+    struct mmap_filter *filter;
+    const u64 base = MM_ECON_TEST_BASE;
+    const struct mm_econ_test_range expected[] = {
+        { base, base + 0x1000, 0 },
+        { base + 0x10000, base + 0x11000, 3 },
+        { base + 0x20000, base + 0x21000, 0 },
+        { base + 0x30000, base + 0x31000, 0 },
+        { base + 0x40000, base + 0x41000, 0 },
+    };
+
+    filter = mm_econ_test_add_filter(test, SectionMmap, PolicyHugePage, 3);
+    mm_econ_test_add_comparison(test, filter, QuantProt, CompEquals,
+            PROT_READ | PROT_WRITE);
+    mm_econ_test_add_comparison(test, filter, QuantFlags, CompEquals,
+            MAP_PRIVATE);
+    mm_econ_test_add_comparison(test, filter, QuantFD, CompEquals, 3);
+    mm_econ_test_add_comparison(test, filter, QuantOff, CompLessThan, 0x2000);
+
+    // Wrong section
+    mm_add_memory_range(MM_ECON_TEST_PID, SectionHeap, base, 0, 0, 0x1000,
+            PROT_READ | PROT_WRITE, MAP_PRIVATE, 3, 0);
+    // Matches
+    mm_add_memory_range(MM_ECON_TEST_PID, SectionMmap, base + 0x10000, 0, 0,
+            0x1000, PROT_READ | PROT_WRITE, MAP_PRIVATE, 3, 0x1000);
+    // Wrong prot
+    mm_add_memory_range(MM_ECON_TEST_PID, SectionMmap, base + 0x20000, 0, 0,
+            0x1000, PROT_READ, MAP_PRIVATE, 3, 0);
+    // Wrong fd
+    mm_add_memory_range(MM_ECON_TEST_PID, SectionMmap, base + 0x30000, 0, 0,
+            0x1000, PROT_READ | PROT_WRITE, MAP_PRIVATE, 4, 0);
+    // Offset too large
+    mm_add_memory_range(MM_ECON_TEST_PID, SectionMmap, base + 0x40000, 0, 0,
+            0x1000, PROT_READ | PROT_WRITE, MAP_PRIVATE, 3, 0x2000);
+
+    mm_econ_test_expect_ranges(test, &ctx->proc->profile->hp_ranges_root,
+            expected, ARRAY_SIZE(expected));
+}
+
+static void mm_econ_test_match_addr(struct kunit *test)
+{
+    struct mm_econ_test_ctx *ctx = test->priv;
+    struct mmap_filter *filter;
+    const u64 base = MM_ECON_TEST_BASE;
+    const struct mm_econ_test_range expected[] = {
+        { base, base + 0x4000, 0 },
+        { base + 0x4000, base + 0xc000, 9 },
+        { base + 0xc000, base + 0xd000, 0 },
+        { base + 0xd000, base + 0xe000, 2 },
+        { base + 0xe000, base + 0x10000, 0 },
+    };
+
+    // A window in the middle of the mapping
+    filter = mm_econ_test_add_filter(test, SectionMmap, PolicyHugePage, 9);
+    mm_econ_test_add_comparison(test, filter, QuantAddr, CompGreaterThan,
+            base + 0x4000);
+    mm_econ_test_add_comparison(test, filter, QuantAddr, CompLessThan,
+            base + 0xc000);
+
+    // A single page, plus an overlapping filter that must not override the
+    // first one.
+    filter = mm_econ_test_add_filter(test, SectionMmap, PolicyHugePage, 2);
+    mm_econ_test_add_comparison(test, filter, QuantAddr, CompEquals,
+            base + 0xd000);
+    filter = mm_econ_test_add_filter(test, SectionMmap, PolicyHugePage, 1);
+    mm_econ_test_add_comparison(test, filter, QuantAddr, CompEquals,
+            base + 0x5000);
+
+    mm_econ_test_add_mmap(test, base, 0x10000);
+
+    mm_econ_test_expect_ranges(test, &ctx->proc->profile->hp_ranges_root,
+            expected, ARRAY_SIZE(expected));
+}
+
+static void mm_econ_test_match_section_off_up(struct kunit *test)
+{
+    struct mm_econ_test_ctx *ctx = test->priv;
+    struct mmap_filter *filter;
+    const u64 heap = 0x600000;
+    const struct mm_econ_test_range expected[] = {
+        { heap, heap + 0x8000, 0 },
+        { heap + 0x8000, heap + 0x10000, 4 },
+    };
+
+    filter = mm_econ_test_add_filter(test, SectionHeap, PolicyHugePage, 4);
+    mm_econ_test_add_comparison(test, filter, QuantSectionOff, CompGreaterThan,
+            0x18000);
+
+    // The heap grows up, so the section starts 0x10000 below this extension
+    mm_add_memory_range(MM_ECON_TEST_PID, SectionHeap, heap, 0x10000, 0,
+            0x10000, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    mm_econ_test_expect_ranges(test, &ctx->proc->profile->hp_ranges_root,
+            expected, ARRAY_SIZE(expected));
+}
+
+static void mm_econ_test_match_section_off_down(struct kunit *test)
+{
+    struct mm_econ_test_ctx *ctx = test->priv;
+    struct mmap_filter *filter;
+    const u64 base = MM_ECON_TEST_BASE;
+    const struct mm_econ_test_range huge[] = {
+        { base, base + 0x8000, 6 },
+        { base + 0x8000, base + 0x10000, 0 },
+    };
+    const struct mm_econ_test_range eager[] = {
+        { base, base + 0x3000, 0 },
+        { base + 0x3000, base + 0x4000, 8 },
+        { base + 0x4000, base + 0x10000, 0 },
+    };
+
+    // The mmap section grows down from mmap_base, so a larger offset is a
+    // lower address and the comparisons have to be flipped.
+    filter = mm_econ_test_add_filter(test, SectionMmap, PolicyHugePage, 6);
+    mm_econ_test_add_comparison(test, filter, QuantSectionOff, CompGreaterThan,
+            0x18000);
+
+    // The page at offset 0x1d000 is [base + 0x3000, base + 0x4000)
+    filter = mm_econ_test_add_filter(test, SectionMmap, PolicyEagerPage, 8);
+    mm_econ_test_add_comparison(test, filter, QuantSectionOff, CompEquals,
+            0x1d000);
+
+    // mmap_base is 0x20000 above the new mapping
+    mm_add_memory_range(MM_ECON_TEST_PID, SectionMmap, base, 0x20000, 0,
+            0x10000, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    mm_econ_test_expect_ranges(test, &ctx->proc->profile->hp_ranges_root,
+            huge, ARRAY_SIZE(huge));
+    mm_econ_test_expect_ranges(test, &ctx->proc->profile->eager_ranges_root,
+            eager, ARRAY_SIZE(eager));
+}
+
+// A whole-range match for one policy must not stop filters for the other.
+static void mm_econ_test_match_both_policies(struct kunit *test)
+{
+    struct mm_econ_test_ctx *ctx = test->priv;
+    struct mmap_filter *filter;
+    const u64 base = MM_ECON_TEST_BASE;
+    const struct mm_econ_test_range huge[] = {
+        { base, base + 0x10000, 5 },
+    };
+    const struct mm_econ_test_range eager[] = {
+        { base, base + 0x10000, 1 },
+    };
+
+    filter = mm_econ_test_add_filter(test, SectionMmap, PolicyHugePage, 5);
+    mm_econ_test_add_comparison(test, filter, QuantLen, CompGreaterThan, 0);
+    // Shadowed by the filter above
+    filter = mm_econ_test_add_filter(test, SectionMmap, PolicyHugePage, 3);
+    mm_econ_test_add_comparison(test, filter, QuantLen, CompGreaterThan, 0);
+    filter = mm_econ_test_add_filter(test, SectionMmap, PolicyEagerPage, 1);
+    mm_econ_test_add_comparison(test, filter, QuantLen, CompGreaterThan, 0);
+
+    mm_econ_test_add_mmap(test, base, 0x10000);
+
+    mm_econ_test_expect_ranges(test, &ctx->proc->profile->hp_ranges_root,
+            huge, ARRAY_SIZE(huge));
+    mm_econ_test_expect_ranges(test, &ctx->proc->profile->eager_ranges_root,
+            eager, ARRAY_SIZE(eager));
+}
+
+// Splits made for a filter that then fails must be thrown away.
+static void mm_econ_test_no_leak(struct kunit *test)
+{
+    struct mm_econ_test_ctx *ctx = test->priv;
+    struct mmap_filter *filter;
+    const u64 base = MM_ECON_TEST_BASE;
+    u64 before;
+
+    filter = mm_econ_test_add_filter(test, SectionMmap, PolicyHugePage, 5);
+    mm_econ_test_add_comparison(test, filter, QuantAddr, CompGreaterThan,
+            base + 0x4000);
+    mm_econ_test_add_comparison(test, filter, QuantLen, CompGreaterThan,
+            0x100000);
+
+    before = mm_econ_vmalloc_bytes;
+    mm_econ_test_add_mmap(test, base, 0x10000);
+
+    // One unsplit range in each of the huge and eager trees
+    KUNIT_EXPECT_EQ(test, mm_econ_vmalloc_bytes - before,
+            (u64)(2 * sizeof(struct profile_range)));
+
+    mm_profile_check_exiting_proc(MM_ECON_TEST_PID);
+    KUNIT_EXPECT_EQ(test, mm_econ_vmalloc_bytes, ctx->vmalloc_bytes);
+}
+
+static void mm_econ_test_add_child_mmap(u64 mapaddr, u64 len)
+{
+    mm_add_memory_range(MM_ECON_TEST_PID_CHILD, SectionMmap, mapaddr, 0, 0,
+            len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+}
+
+static void mm_econ_test_copy_profile(struct kunit *test)
+{
+    struct mm_econ_test_ctx *ctx = test->priv;
+    struct mmap_filter_proc *child;
+    struct mmap_filter *filter;
+    const u64 base = MM_ECON_TEST_BASE;
+    const struct mm_econ_test_range expected[] = {
+        { base, base + 0x4000, 0 },
+        { base + 0x4000, base + 0x10000, 5 },
+    };
+    const struct mm_econ_test_range expected_child[] = {
+        { base, base + 0x4000, 0 },
+        { base + 0x8000, base + 0x9000, 5 },
+    };
+    u64 before;
+
+    filter = mm_econ_test_add_filter(test, SectionMmap, PolicyHugePage, 5);
+    mm_econ_test_add_comparison(test, filter, QuantAddr, CompGreaterThan,
+            base + 0x4000);
+    mm_econ_test_add_mmap(test, base, 0x10000);
+
+    // Forking shares the profile rather than copying it
+    before = mm_econ_vmalloc_bytes;
+    mm_copy_profile(MM_ECON_TEST_PID, MM_ECON_TEST_PID_CHILD);
+    KUNIT_EXPECT_EQ(test, mm_econ_vmalloc_bytes - before,
+            (u64)sizeof(struct mmap_filter_proc));
+
+    down_read(&filter_procs_sem);
+    child = find_filter_proc_by_pid(MM_ECON_TEST_PID_CHILD);
+    up_read(&filter_procs_sem);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, child);
+    KUNIT_EXPECT_PTR_EQ(test, child->profile, ctx->proc->profile);
+    KUNIT_EXPECT_EQ(test, child->profile->refcount, 2);
+
+    // A mapping no filter matches doesn't change the profile, so it stays
+    // shared
+    mm_econ_test_add_child_mmap(base - 0x100000, 0x1000);
+    KUNIT_EXPECT_PTR_EQ(test, child->profile, ctx->proc->profile);
+
+    // One that does gives the child its own copy, leaving the parent's alone
+    mm_econ_test_add_child_mmap(base + 0x8000, 0x1000);
+    KUNIT_EXPECT_PTR_NE(test, child->profile, ctx->proc->profile);
+    KUNIT_EXPECT_EQ(test, ctx->proc->profile->refcount, 1);
+    KUNIT_EXPECT_FALSE(test, list_empty(&child->profile->filters));
+    mm_econ_test_expect_ranges(test, &ctx->proc->profile->hp_ranges_root,
+            expected, ARRAY_SIZE(expected));
+    mm_econ_test_expect_ranges(test, &child->profile->hp_ranges_root,
+            expected_child, ARRAY_SIZE(expected_child));
+
+    // The copy is independent of the parent
+    mm_profile_check_exiting_proc(MM_ECON_TEST_PID);
+    mm_econ_test_expect_ranges(test, &child->profile->hp_ranges_root,
+            expected_child, ARRAY_SIZE(expected_child));
+
+    mm_profile_check_exiting_proc(MM_ECON_TEST_PID_CHILD);
+    KUNIT_EXPECT_EQ(test, mm_econ_vmalloc_bytes, ctx->vmalloc_bytes);
+}
+
+// The parent exiting first leaves the shared profile to the child.
+static void mm_econ_test_shared_profile_exit(struct kunit *test)
+{
+    struct mm_econ_test_ctx *ctx = test->priv;
+    struct mmap_filter_proc *child;
+    const u64 base = MM_ECON_TEST_BASE;
+    const struct mm_econ_test_range expected[] = {
+        { base, base + 0x10000, 5 },
+    };
+
+    mm_econ_test_add_filter(test, SectionMmap, PolicyHugePage, 5);
+    mm_econ_test_add_mmap(test, base, 0x10000);
+
+    mm_copy_profile(MM_ECON_TEST_PID, MM_ECON_TEST_PID_CHILD);
+    mm_profile_check_exiting_proc(MM_ECON_TEST_PID);
+
+    down_read(&filter_procs_sem);
+    child = find_filter_proc_by_pid(MM_ECON_TEST_PID_CHILD);
+    up_read(&filter_procs_sem);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, child);
+    KUNIT_EXPECT_EQ(test, child->profile->refcount, 1);
+    mm_econ_test_expect_ranges(test, &child->profile->hp_ranges_root,
+            expected, ARRAY_SIZE(expected));
+
+    // No copy needed now that it isn't shared
+    mm_econ_test_add_child_mmap(base + 0x20000, 0x1000);
+    KUNIT_EXPECT_EQ(test, mm_econ_num_profile_copies, ctx->profile_copies);
+
+    mm_profile_check_exiting_proc(MM_ECON_TEST_PID_CHILD);
+    KUNIT_EXPECT_EQ(test, mm_econ_vmalloc_bytes, ctx->vmalloc_bytes);
+}
+
+static struct kunit_case mm_econ_test_cases[] = {
+    KUNIT_CASE(mm_econ_test_insert_overlapping),
+    KUNIT_CASE(mm_econ_test_search),
+    KUNIT_CASE(mm_econ_test_find_first_range),
+    KUNIT_CASE(mm_econ_test_split_greater),
+    KUNIT_CASE(mm_econ_test_split_less),
+    KUNIT_CASE(mm_econ_test_split_equals),
+    KUNIT_CASE(mm_econ_test_match_whole_range),
+    KUNIT_CASE(mm_econ_test_match_quantities),
+    KUNIT_CASE(mm_econ_test_match_addr),
+    KUNIT_CASE(mm_econ_test_match_section_off_up),
+    KUNIT_CASE(mm_econ_test_match_section_off_down),
+    KUNIT_CASE(mm_econ_test_match_both_policies),
+    KUNIT_CASE(mm_econ_test_no_leak),
+    KUNIT_CASE(mm_econ_test_copy_profile),
+    KUNIT_CASE(mm_econ_test_shared_profile_exit),
+    {}
+};
+
+static struct kunit_suite mm_econ_test_suite = {
+    .name = "mm_econ",
+    .init = mm_econ_test_init,
+    .exit = mm_econ_test_exit,
+    .test_cases = mm_econ_test_cases,
+};
+
+kunit_test_suite(mm_econ_test_suite);
+
+///////////////////////////////////////////////////////////////////////////////
+// Microbenchmarks
+//
+// These always pass; the timings are reported in the test log. They are kept
+// small because KUnit runs them during boot.
+
+#define MM_ECON_BENCH_MMAPS 256
+#define MM_ECON_BENCH_LOOKUPS 100000
+
+// Cost of mm_add_memory_range for a 32MB mmap against a profile of nr_filters
+// filters, each of which claims a 2MB slice of the mapping by section offset.
+// Past 16 filters the slices repeat, so the extra filters are rejected after a
+// single lookup, as overlapping filters in a real profile would be.
+static void mm_econ_bench_add_one(struct kunit *test, int nr_filters)
+{
+    struct mm_econ_test_ctx *ctx = test->priv;
+    struct mmap_filter *filter;
+    const u64 len = 16 * HPAGE_SIZE;
+    u64 start, elapsed;
+    int i;
+
+    for (i = 0; i < nr_filters; i++) {
+        u64 slice = (i % 16) * HPAGE_SIZE;
+
+        filter = mm_econ_test_add_filter(test, SectionHeap, PolicyHugePage,
+                i + 1);
+        mm_econ_test_add_comparison(test, filter, QuantSectionOff,
+                CompGreaterThan, slice);
+        mm_econ_test_add_comparison(test, filter, QuantSectionOff,
+                CompLessThan, slice + HPAGE_SIZE);
+    }
+
+    start = ktime_get_ns();
+    for (i = 0; i < MM_ECON_BENCH_MMAPS; i++) {
+        mm_add_memory_range(MM_ECON_TEST_PID, SectionHeap,
+                MM_ECON_TEST_BASE + i * len, 0, 0, len,
+                PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    elapsed = ktime_get_ns() - start;
+
+    kunit_info(test, "mm_add_memory_range: %d filters: %llu ns/call\n",
+            nr_filters, elapsed / MM_ECON_BENCH_MMAPS);
+
+    // Start over with an empty profile
+    down_write(&filter_procs_sem);
+    profile_free_all(&ctx->proc->profile->hp_ranges_root);
+    profile_free_all(&ctx->proc->profile->eager_ranges_root);
+    mmap_filters_free_all(ctx->proc->profile);
+    up_write(&filter_procs_sem);
+}
+
+static void mm_econ_bench_add_memory_range(struct kunit *test)
+{
+    mm_econ_bench_add_one(test, 1);
+    mm_econ_bench_add_one(test, 16);
+    mm_econ_bench_add_one(test, 128);
+}
+
+// Cost of profile_search in a tree of nr_ranges 2MB ranges, with lookups
+// spread over the whole tree and a few misses past the end.
+static void mm_econ_bench_search_one(struct kunit *test, u64 nr_ranges)
+{
+    struct rb_root root = RB_ROOT;
+    u64 start, elapsed, addr;
+    u64 found = 0;
+    u64 i;
+
+    for (i = 0; i < nr_ranges; i++) {
+        mm_econ_test_insert(test, &root, MM_ECON_TEST_BASE + i * HPAGE_SIZE,
+                MM_ECON_TEST_BASE + (i + 1) * HPAGE_SIZE, i);
+    }
+
+    start = ktime_get_ns();
+    for (i = 0; i < MM_ECON_BENCH_LOOKUPS; i++) {
+        // Step by a prime number of pages so consecutive lookups land in
+        // unrelated parts of the tree.
+        addr = MM_ECON_TEST_BASE +
+            ((i * 4099 * PAGE_SIZE) % ((nr_ranges + 1) * HPAGE_SIZE));
+        if (profile_search(&root, addr))
+            found++;
+    }
+    elapsed = ktime_get_ns() - start;
+
+    kunit_info(test, "profile_search: %llu ranges: %llu ns/lookup (%llu hits)\n",
+            nr_ranges, elapsed / MM_ECON_BENCH_LOOKUPS, found);
+
+    profile_free_all(&root);
+}
+
+static void mm_econ_bench_profile_search(struct kunit *test)
+{
+    mm_econ_bench_search_one(test, 16);
+    mm_econ_bench_search_one(test, 1024);
+    mm_econ_bench_search_one(test, 16384);
+}
+
+static struct kunit_case mm_econ_bench_cases[] = {
+    KUNIT_CASE(mm_econ_bench_add_memory_range),
+    KUNIT_CASE(mm_econ_bench_profile_search),
+    {}
+};
+
+static struct kunit_suite mm_econ_bench_suite = {
+    .name = "mm_econ_bench",
+    .init = mm_econ_test_init,
+    .exit = mm_econ_test_exit,
+    .test_cases = mm_econ_bench_cases,
+};
+
+kunit_test_suite(mm_econ_bench_suite);
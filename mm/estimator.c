@@ -12,9 +12,26 @@
 #include <linux/sched/loadavg.h>
 #include <linux/sched/task.h>
 #include <linux/rwsem.h>
+#include <linux/mempolicy.h>
+#include <linux/cpuset.h>
+#include <linux/topology.h>
+#include <linux/zone_lock_stat.h>
+#include <linux/error-injection.h>
+#include <linux/memcontrol.h>
+#include <linux/spinlock.h>
+#include <linux/atomic.h>
+#include <linux/jiffies.h>
+#include <linux/log2.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/mm_econ.h>
 
 #define HUGE_PAGE_ORDER 9
 
+// Rough cost of migrating one base page out of the way of a gigantic page
+// allocation, in cycles (~2us).
+#define MM_ECON_MIGRATE_PAGE_CYCLES 4000
+
 #define MMAP_FILTER_BUF_SIZE 4096
 #define MMAP_FILTER_BUF_DEAD_ZONE 128
 
@@ -24,6 +41,8 @@
 // Modes:
 // - 0: off (just use default linux behavior)
 // - 1: on (cost-benefit estimation)
+// - 2: budgeted (cost-benefit estimation within a cycle budget per LTU; see
+//      mm_econ_budget_admit())
 static int mm_econ_mode = 0;
 
 // Turns on various debugging printks...
@@ -31,12 +50,28 @@ int mm_econ_debugging_mode = 0;
 
 // Number of cycles per unit time page allocator zone lock is NOT held.
 // In this case, the unit time is 10ms because that is the granularity async
-// zero daemon uses.
+// zero daemon uses. Only used if we don't have zone->lock measurements yet.
 static u64 mm_econ_contention_ms = 10;
 
 // Set this properly via the sysfs file.
 static u64 mm_econ_freq_mhz = 3000;
 
+// Extra cost (in cycles) of placing a huge page on a remote node, per unit of
+// node distance beyond LOCAL_DISTANCE. This stands in for the extra latency of
+// accessing the page remotely over an LTU. The default makes a local page that
+// needs zeroing a bit cheaper than a prezeroed page one hop away.
+static u64 mm_econ_numa_distance_cost = 20000;
+
+// In budgeted mode, the number of cycles that decisions may spend per LTU,
+// over the whole system and on each node. U64_MAX means unlimited.
+static u64 mm_econ_budget = U64_MAX;
+static u64 mm_econ_node_budget = U64_MAX;
+
+// If set, huge page benefits for processes that kbadgerd knows nothing about
+// are estimated from their per-VMA BadgerTrap miss counts (vma_miss_est_fn)
+// before falling back to the profile.
+static int mm_econ_vma_benefit = 0;
+
 // The Preloaded Profile, if any.
 struct profile_range {
     u64 start;
@@ -90,22 +125,48 @@ struct mmap_filter {
     struct list_head comparisons;
 };
 
+// The filters of a process and the ranges they produced. A forked child
+// shares its parent's profile until one of them changes it, at which point
+// that one gets a private copy (see mm_profile_unshare()), so fork doesn't
+// have to copy the whole thing. The refcount, like everything else here, is
+// protected by `filter_procs_sem`.
+struct mm_profile {
+    int refcount;
+    struct list_head filters;
+    struct rb_root hp_ranges_root;
+    struct rb_root eager_ranges_root;
+};
+
 // A process using mmap filters
 struct mmap_filter_proc {
     struct list_head node;
     pid_t pid;
-    struct list_head filters;
-    struct rb_root hp_ranges_root;
-    struct rb_root eager_ranges_root;
+    struct mm_profile *profile;
 };
 
 // List of processes using mmap filters
 static LIST_HEAD(filter_procs);
 static DECLARE_RWSEM(filter_procs_sem);
 
+// The huge page profile of a file's page cache (shmem/tmpfs or file THP),
+// keyed on byte offsets in the file. It is built from the profiles of the
+// processes that map the file (see mm_add_file_range()), so decisions about
+// the page cache don't depend on which process, if any, triggers them.
+struct mm_file_profile {
+    struct list_head node;
+    struct inode *inode;
+    struct rb_root hp_ranges_root;
+};
+
+// List of files with profiles. Also protected by `filter_procs_sem`.
+static LIST_HEAD(file_profiles);
+
 // The TLB misses estimator, if any.
 static mm_econ_tlb_miss_estimator_fn_t tlb_miss_est_fn = NULL;
 
+// The per-VMA TLB miss estimator, if any. Only used if mm_econ_vma_benefit.
+static mm_econ_vma_miss_estimator_fn_t vma_miss_est_fn = NULL;
+
 // Some stats...
 
 // Number of estimates made.
@@ -114,6 +175,15 @@ static u64 mm_econ_num_estimates = 0;
 static u64 mm_econ_num_decisions = 0;
 // Number of decisions that are "yes".
 static u64 mm_econ_num_decisions_yes = 0;
+// Number of decisions made by mm_decide_hook rather than the built-in policy.
+static u64 mm_econ_num_decisions_hooked = 0;
+// Number of decisions refused because a memcg was out of budget.
+static u64 mm_econ_num_decisions_over_budget = 0;
+// Number of profitable decisions refused in budgeted mode, either because
+// their benefit/cost ratio was below the cutoff for the LTU (deferred), or
+// because the LTU's budget was already spent (rejected).
+static u64 mm_econ_num_decisions_deferred = 0;
+static u64 mm_econ_num_decisions_rejected = 0;
 // Number of huge page promotions in #PFs.
 static u64 mm_econ_num_hp_promotions = 0;
 // Number of times we decided to run async compaction.
@@ -122,6 +192,16 @@ static u64 mm_econ_num_async_compaction = 0;
 static u64 mm_econ_num_async_prezeroing = 0;
 // Number of allocated bytes for various data structures.
 static u64 mm_econ_vmalloc_bytes = 0;
+// Number of times a shared profile was copied because a process changed it.
+static u64 mm_econ_num_profile_copies = 0;
+// Number of huge page benefits estimated from per-VMA BadgerTrap counts.
+static u64 mm_econ_num_vma_estimates = 0;
+// Number of huge page estimates that picked a node other than the local one.
+static u64 mm_econ_num_remote_chosen = 0;
+// Number of huge pages allocated in #PFs, and how many of those ended up on a
+// node other than the faulting CPU's.
+static u64 mm_econ_num_hp_placed = 0;
+static u64 mm_econ_num_hp_placed_remote = 0;
 
 extern inline struct task_struct *extern_get_proc_task(const struct inode *inode);
 
@@ -132,7 +212,10 @@ extern inline struct task_struct *extern_get_proc_task(const struct inode *inode
 // 1. kbadgerd (via tlb_miss_est_fn).
 // 2. A pre-loaded profile (via preloaded_profile).
 //
-// In both cases, the required units are misses/huge-page/LTU.
+// If vma_benefit is set, the per-VMA BadgerTrap counts (via vma_miss_est_fn)
+// are used in between the two, for processes kbadgerd has no data for.
+//
+// In all cases, the required units are misses/huge-page/LTU.
 
 // A wrapper around vmalloc to keep track of allocated memory.
 static void *mm_econ_vmalloc(unsigned long size)
@@ -160,6 +243,15 @@ void register_mm_econ_tlb_miss_estimator(
 }
 EXPORT_SYMBOL(register_mm_econ_tlb_miss_estimator);
 
+void register_mm_econ_vma_miss_estimator(
+        mm_econ_vma_miss_estimator_fn_t f)
+{
+    BUG_ON(!f);
+    vma_miss_est_fn = f;
+    pr_warn("mm: registered VMA TLB miss estimator %p\n", f);
+}
+EXPORT_SYMBOL(register_mm_econ_vma_miss_estimator);
+
 /*
  * Find the profile of a process by PID, if any.
  *
@@ -183,6 +275,24 @@ inline bool mm_process_is_using_cbmm(pid_t pid)
     return find_filter_proc_by_pid(pid) != NULL;
 }
 
+/*
+ * Find the profile of a file by inode, if any.
+ *
+ * Caller must hold `filter_procs_sem` in either read or write mode.
+ */
+static struct mm_file_profile *
+find_file_profile(const struct inode *inode)
+{
+    struct mm_file_profile *fp;
+    list_for_each_entry(fp, &file_profiles, node) {
+        if (fp->inode == inode) {
+            return fp;
+        }
+    }
+
+    return NULL;
+}
+
 /*
  * Search the profile for the range containing the given address, and return
  * it. Otherwise, return NULL.
@@ -403,14 +513,14 @@ profile_free_all(struct rb_root *ranges_root)
     }
 }
 
-static void mmap_filters_free_all(struct mmap_filter_proc *proc)
+static void mmap_filters_free_all(struct mm_profile *profile)
 {
     struct mmap_filter *filter;
     struct mmap_comparison *comparison;
     struct list_head *pos, *n;
     struct list_head *cPos, *cN;
 
-    list_for_each_safe(pos, n, &proc->filters) {
+    list_for_each_safe(pos, n, &profile->filters) {
         filter = list_entry(pos, struct mmap_filter, node);
 
         // Free each comparison in this filter
@@ -431,23 +541,24 @@ enum free_huge_page_status {
     fhps_zeroed, // huge pages are available and prezeroed!
 };
 
+// Look for a free block of at least the given order on `nid`. This only works
+// for orders the buddy allocator tracks, i.e. below MAX_ORDER.
 static enum free_huge_page_status
-have_free_huge_pages(void)
+have_free_huge_pages(int nid, int order)
 {
-    int zone_idx;
+    int zone_idx, o;
     struct zone *zone;
     struct page *page;
     struct free_area *area;
     bool is_free = false, is_zeroed = false;
-    int order;
     unsigned long flags;
 
-    pg_data_t *pgdat = NODE_DATA(numa_node_id());
+    pg_data_t *pgdat = NODE_DATA(nid);
     for (zone_idx = ZONE_NORMAL; zone_idx < MAX_NR_ZONES; zone_idx++) {
         zone = &pgdat->node_zones[zone_idx];
 
-        for (order = HUGE_PAGE_ORDER; order < MAX_ORDER; ++order) {
-            area = &(zone->free_area[order]);
+        for (o = order; o < MAX_ORDER; ++o) {
+            area = &(zone->free_area[o]);
             is_free = area->nr_free > 0;
 
             if (is_free) {
@@ -465,7 +576,7 @@ have_free_huge_pages(void)
                             "free page %p node %d zone %p (%s) "
                             "order %d prezeroed %d list %d",
                             page, zone->zone_pgdat->node_id,
-                            zone, zone->name, order,
+                            zone, zone->name, o,
                             is_zeroed, MIGRATE_MOVABLE);
                 }
 
@@ -480,6 +591,244 @@ have_free_huge_pages(void)
         fhps_none;
 }
 
+// Look for room for a gigantic (order >= MAX_ORDER) page on `nid`.
+//
+// The buddy allocator doesn't track blocks that large, so a gigantic page has
+// to be carved out of a zone with alloc_contig_range(), migrating whatever is
+// in the way. We can't cheaply tell where the free memory is, so we assume
+// in-use memory is spread evenly over the zone, and that free memory in blocks
+// smaller than a huge page is as good as in use. The expected number of pages
+// to migrate is then the in-use fraction of the gigantic page, and its cost is
+// returned in `compact_cost`.
+//
+// Gigantic pages are never assumed to be prezeroed.
+static enum free_huge_page_status
+have_free_gigantic_pages(int nid, int order, u64 *compact_cost)
+{
+    pg_data_t *pgdat = NODE_DATA(nid);
+    const u64 nr_pages = 1ull << order;
+    u64 free, managed, migrate, best = U64_MAX;
+    int zone_idx, o;
+
+    for (zone_idx = ZONE_NORMAL; zone_idx < MAX_NR_ZONES; zone_idx++) {
+        struct zone *zone = &pgdat->node_zones[zone_idx];
+
+        managed = zone_managed_pages(zone);
+        if (managed < nr_pages)
+            continue;
+
+        free = 0;
+        for (o = HUGE_PAGE_ORDER; o < MAX_ORDER; o++)
+            free += (u64)READ_ONCE(zone->free_area[o].nr_free) << o;
+        if (free < nr_pages)
+            continue;
+
+        free = min(free, managed);
+        migrate = nr_pages - nr_pages * free / managed;
+        best = min(best, migrate);
+    }
+
+    if (best == U64_MAX)
+        return fhps_none;
+
+    *compact_cost = best * MM_ECON_MIGRATE_PAGE_CYCLES;
+    return fhps_free;
+}
+
+// Is there a free page of the given order on `nid`? If getting one would need
+// compaction first, its cost is returned in `compact_cost`.
+static enum free_huge_page_status
+have_free_pages_of_order(int nid, int order, u64 *compact_cost)
+{
+    *compact_cost = 0;
+
+    if (order >= MAX_ORDER)
+        return have_free_gigantic_pages(nid, order, compact_cost);
+
+    return have_free_huge_pages(nid, order);
+}
+
+// The node a huge page for the current task would "normally" go on, taking
+// into account a preferred node in the task's memory policy.
+static int mm_econ_home_node(void)
+{
+#ifdef CONFIG_NUMA
+    struct mempolicy *pol = current->mempolicy;
+
+    if (pol && pol->mode == MPOL_PREFERRED && !(pol->flags & MPOL_F_LOCAL)
+            && node_state(pol->v.preferred_node, N_MEMORY))
+        return pol->v.preferred_node;
+#endif
+
+    return numa_node_id();
+}
+
+// May the huge page go on `nid`? With `allowed`, it must be one of those
+// nodes; otherwise, the current task's memory policy and cpuset decide.
+static bool mm_econ_node_allowed(int nid, const nodemask_t *allowed)
+{
+#ifdef CONFIG_NUMA
+    struct mempolicy *pol = current->mempolicy;
+#endif
+
+    if (allowed)
+        return node_isset(nid, *allowed);
+
+#ifdef CONFIG_NUMA
+
+    if (pol && pol->mode == MPOL_BIND && !node_isset(nid, pol->v.nodes))
+        return false;
+#endif
+
+    return cpuset_node_allowed(nid, GFP_TRANSHUGE_LIGHT);
+}
+
+// Cost of preparing a huge page of the given order on a node with the given
+// free huge page status, plus the cost of it being far away from `home`.
+static u64 huge_page_node_cost(int home, int nid, int order,
+                               enum free_huge_page_status fhps)
+{
+    // TODO: Assume constant prep costs (zeroing or copying) per 2MB.
+    const int shift = order > HUGE_PAGE_ORDER ? order - HUGE_PAGE_ORDER : 0;
+    const u64 prep_cost = fhps > fhps_free ? 0 : (100 * 2000ull) << shift; // ~100us/2MB
+    const int distance = node_distance(home, nid);
+    const u64 remote_cost = distance > LOCAL_DISTANCE
+        ? (distance - LOCAL_DISTANCE) * mm_econ_numa_distance_cost : 0;
+
+    return prep_cost + remote_cost;
+}
+
+// Pick the node to allocate a huge page of the given order from. Each allowed
+// node (see mm_econ_node_allowed()) with room for one is scored by the cost of
+// compacting and zeroing a page there and its distance from the `home` node.
+// Returns NUMA_NO_NODE if no node has room.
+static int
+pick_huge_page_node(int home, int order, const nodemask_t *allowed,
+                    enum free_huge_page_status *best_fhps, u64 *best_cost)
+{
+    enum free_huge_page_status fhps;
+    int nid, best = NUMA_NO_NODE;
+    u64 cost, compact_cost;
+
+    *best_fhps = fhps_none;
+    *best_cost = 0;
+
+    // Fast path: a prezeroed page on the home node is as good as it gets.
+    if (mm_econ_node_allowed(home, allowed)) {
+        fhps = have_free_pages_of_order(home, order, &compact_cost);
+        if (fhps != fhps_none) {
+            best = home;
+            *best_fhps = fhps;
+            *best_cost = huge_page_node_cost(home, home, order, fhps)
+                + compact_cost;
+            if (fhps == fhps_zeroed)
+                return home;
+        }
+    }
+
+    for_each_node_state(nid, N_MEMORY) {
+        if (nid == home || !mm_econ_node_allowed(nid, allowed))
+            continue;
+
+        // Can't beat what we have even if the node has prezeroed pages.
+        if (best != NUMA_NO_NODE
+                && huge_page_node_cost(home, nid, order, fhps_zeroed) >= *best_cost)
+            continue;
+
+        fhps = have_free_pages_of_order(nid, order, &compact_cost);
+        if (fhps == fhps_none)
+            continue;
+
+        cost = huge_page_node_cost(home, nid, order, fhps) + compact_cost;
+        if (best == NUMA_NO_NODE || cost < *best_cost) {
+            best = nid;
+            *best_fhps = fhps;
+            *best_cost = cost;
+        }
+    }
+
+    return best;
+}
+
+#ifdef CONFIG_NUMA
+// The nodes a huge page of `mm` may go on, going by the memory policy of `vma`
+// at `address` (or else that of the owner of `mm`) and the owner's cpuset.
+// `vma` may be NULL, e.g. for page cache. Returns false if we can't tell
+// because `mm` has no owner.
+//
+// Caller must hold mm->mmap_sem if `vma` is given.
+static bool
+huge_page_allowed_nodes(struct mm_struct *mm, struct vm_area_struct *vma,
+                        unsigned long address, nodemask_t *allowed)
+{
+    struct task_struct *owner = NULL;
+    struct mempolicy *pol;
+
+#ifdef CONFIG_MEMCG
+    rcu_read_lock();
+    owner = rcu_dereference(mm->owner);
+    if (owner)
+        get_task_struct(owner);
+    rcu_read_unlock();
+#endif
+    if (!owner)
+        return false;
+
+    *allowed = cpuset_mems_allowed(owner);
+
+    pol = vma ? __get_vma_policy(vma, address) : NULL;
+    if (pol) {
+        if (pol->mode == MPOL_BIND)
+            nodes_and(*allowed, *allowed, pol->v.nodes);
+        mpol_cond_put(pol);
+    } else {
+        task_lock(owner);
+        pol = owner->mempolicy;
+        if (pol && pol->mode == MPOL_BIND)
+            nodes_and(*allowed, *allowed, pol->v.nodes);
+        task_unlock(owner);
+    }
+
+    put_task_struct(owner);
+    return true;
+}
+#else
+// There is only one node, so there is nothing to choose.
+static bool
+huge_page_allowed_nodes(struct mm_struct *mm, struct vm_area_struct *vma,
+                        unsigned long address, nodemask_t *allowed)
+{
+    return false;
+}
+#endif
+
+// Like the node choice made for MM_ACTION_PROMOTE_HUGE, but around the given
+// home node rather than the current task's. This is for khugepaged, which
+// wants the huge page near the existing base pages. Since current isn't the
+// task that owns the memory, the node has to be allowed by the policy of the
+// VMA and the cpuset of the owner of `mm` instead. Falls back to `home`.
+int mm_econ_huge_page_node(struct mm_struct *mm, struct vm_area_struct *vma,
+                           unsigned long address, int home)
+{
+    enum free_huge_page_status fhps;
+    nodemask_t allowed;
+    u64 cost;
+    int nid;
+
+    if (!huge_page_allowed_nodes(mm, vma, address, &allowed))
+        return home;
+
+    nid = pick_huge_page_node(home, HUGE_PAGE_ORDER, &allowed, &fhps, &cost);
+
+    if (nid == NUMA_NO_NODE)
+        return home;
+
+    if (nid != home)
+        mm_econ_num_remote_chosen += 1;
+
+    return nid;
+}
+
 static u64
 compute_hpage_benefit_from_profile(
         const struct mm_action *action)
@@ -490,7 +839,7 @@ compute_hpage_benefit_from_profile(
 
     down_read(&filter_procs_sem);
     if ((proc = find_filter_proc_by_pid(current->tgid))) // NOTE: assignment
-        range = profile_search(&proc->hp_ranges_root, action->address);
+        range = profile_search(&proc->profile->hp_ranges_root, action->address);
 
     if (range) {
         ret = range->benefit;
@@ -507,12 +856,134 @@ compute_hpage_benefit_from_profile(
 }
 
 static u64
-compute_hpage_benefit(const struct mm_action *action)
+compute_file_hpage_benefit_from_profile(
+        const struct mm_action *action)
 {
-    if (tlb_miss_est_fn)
-        return tlb_miss_est_fn(action);
-    else
-        return compute_hpage_benefit_from_profile(action);
+    u64 ret = 0;
+    struct mm_file_profile *fp;
+    struct profile_range *range = NULL;
+
+    down_read(&filter_procs_sem);
+    if ((fp = find_file_profile(action->inode))) // NOTE: assignment
+        range = profile_search(&fp->hp_ranges_root, action->address);
+
+    if (range)
+        ret = range->benefit;
+    up_read(&filter_procs_sem);
+
+    return ret;
+}
+
+// Profile benefits are per 2MB page, so the benefit of a larger page is the
+// sum over the 2MB pages it covers. Parts of the region not covered by any
+// range contribute nothing.
+static u64
+compute_gigantic_benefit_from_profile(
+        const struct mm_action *action)
+{
+    const u64 size = PAGE_SIZE << action->huge_page_order;
+    const u64 start = action->address & ~(size - 1);
+    const u64 end = start + size;
+    u64 ret = 0, overlap;
+    struct mmap_filter_proc *proc;
+    struct profile_range *range = NULL;
+    struct rb_node *node = NULL;
+
+    down_read(&filter_procs_sem);
+    if ((proc = find_filter_proc_by_pid(current->tgid))) // NOTE: assignment
+        range = profile_find_first_range(&proc->profile->hp_ranges_root, start,
+                CompGreaterThan);
+    if (range)
+        node = &range->node;
+
+    while (node) {
+        range = container_of(node, struct profile_range, node);
+        if (range->start >= end)
+            break;
+
+        overlap = min(range->end, end) - max(range->start, start);
+        ret += (range->benefit * (overlap >> PAGE_SHIFT)) >> HUGE_PAGE_ORDER;
+
+        node = rb_next(node);
+    }
+    up_read(&filter_procs_sem);
+
+    return ret;
+}
+
+// The TLB miss estimator works on 2MB pages too, so ask it about each 2MB
+// page in the region and add them up.
+static u64
+compute_gigantic_benefit_from_estimator(
+        mm_econ_tlb_miss_estimator_fn_t fn, const struct mm_action *action)
+{
+    const u64 size = PAGE_SIZE << action->huge_page_order;
+    const u64 start = action->address & ~(size - 1);
+    struct mm_action sub = *action;
+    u64 ret = 0;
+
+    sub.huge_page_order = HUGE_PAGE_ORDER;
+    for (sub.address = start; sub.address < start + size;
+            sub.address += PAGE_SIZE << HUGE_PAGE_ORDER)
+    {
+        ret += fn(&sub);
+    }
+
+    return ret;
+}
+
+// Returns false if the per-VMA estimator is off or has nothing to say.
+static bool
+compute_hpage_benefit_from_vma(
+        const struct mm_action *action, struct mm_cost_delta *cost)
+{
+    mm_econ_vma_miss_estimator_fn_t fn = READ_ONCE(vma_miss_est_fn);
+    u64 misses;
+
+    if (!READ_ONCE(mm_econ_vma_benefit) || !fn || !fn(action, &misses))
+        return false;
+
+    cost->benefit = misses;
+    cost->benefit_src = MM_ECON_BENEFIT_VMA;
+    mm_econ_num_vma_estimates += 1;
+
+    return true;
+}
+
+static void
+compute_hpage_benefit(const struct mm_action *action, struct mm_cost_delta *cost)
+{
+    mm_econ_tlb_miss_estimator_fn_t fn = READ_ONCE(tlb_miss_est_fn);
+    const bool gigantic = action->huge_page_order > HUGE_PAGE_ORDER;
+
+    // The TLB miss estimator works on the virtual addresses of one process,
+    // so it can't say anything about page cache shared between processes.
+    if (action->action == MM_ACTION_PROMOTE_HUGE_FILE) {
+        cost->benefit = compute_file_hpage_benefit_from_profile(action);
+        cost->benefit_src = MM_ECON_BENEFIT_PROFILE;
+        return;
+    }
+
+    if (fn) {
+        cost->benefit = gigantic
+            ? compute_gigantic_benefit_from_estimator(fn, action)
+            : fn(action);
+        cost->benefit_src = MM_ECON_BENEFIT_KBADGERD;
+
+        // kbadgerd only knows about the process it is inspecting.
+        if (cost->benefit)
+            return;
+    }
+
+    if (compute_hpage_benefit_from_vma(action, cost))
+        return;
+
+    if (!fn) {
+        cost->benefit = gigantic
+            ? compute_gigantic_benefit_from_profile(action)
+            : compute_hpage_benefit_from_profile(action);
+        cost->benefit_src = MM_ECON_BENEFIT_PROFILE;
+    }
 }
 
 static void
@@ -527,13 +998,14 @@ compute_eager_page_benefit(const struct mm_action *action, struct mm_cost_delta
     struct rb_node *node = NULL;
     struct range *ranges = NULL;
 
+    cost->extra = 0;
     start = action->address;
     end = action->address + action->len;
 
     down_read(&filter_procs_sem);
     // First find the first range with an address g.t. the given address
     if ((proc = find_filter_proc_by_pid(current->tgid))) { // NOTE: assignment
-        first_range = profile_find_first_range(&proc->eager_ranges_root,
+        first_range = profile_find_first_range(&proc->profile->eager_ranges_root,
             start, CompGreaterThan);
     }
     if (!first_range)
@@ -559,7 +1031,6 @@ compute_eager_page_benefit(const struct mm_action *action, struct mm_cost_delta
         goto out;
 
     // +1 for the ending signal
-    cost->extra = 0;
     ranges = vmalloc(sizeof(struct range) * (range_count + 1));
     if (!ranges)
         goto out;
@@ -594,6 +1065,7 @@ compute_eager_page_benefit(const struct mm_action *action, struct mm_cost_delta
     up_read(&filter_procs_sem);
 
     cost->benefit = benefit;
+    cost->benefit_src = MM_ECON_BENEFIT_PROFILE;
 }
 
 // Estimate cost/benefit of a huge page promotion for the current process.
@@ -607,20 +1079,25 @@ mm_estimate_huge_page_promote_cost_benefit(
     // assumptions. We can relax these assumptions later if we need to.
 
     // TODO: Assume allocation is free if we have free huge pages.
-    // TODO: Assume we don't care what node it is on...
     // TODO: Maybe account for opportunity cost as rate/ratio?
-    const enum free_huge_page_status fhps = have_free_huge_pages();
+    enum free_huge_page_status fhps;
+    u64 node_cost;
+    const int home = mm_econ_home_node();
+    const int nid = pick_huge_page_node(home, action->huge_page_order, NULL,
+                                        &fhps, &node_cost);
     const u64 alloc_cost = fhps > fhps_none ? 0 : (1ul << 32);
 
-    // TODO: Assume constant prep costs (zeroing or copying).
-    const u64 prep_cost = fhps > fhps_free ? 0 : 100 * 2000; // ~100us
-
-    // Compute total cost.
-    cost->cost = alloc_cost + prep_cost;
+    // Compute total cost. The node cost includes the prep and compaction
+    // costs.
+    cost->cost = alloc_cost + node_cost;
     cost->extra = fhps == fhps_zeroed;
+    cost->nid = nid;
+
+    if (nid != NUMA_NO_NODE && nid != home)
+        mm_econ_num_remote_chosen += 1;
 
     // Estimate benefit.
-    cost->benefit = compute_hpage_benefit(action);
+    compute_hpage_benefit(action, cost);
 }
 
 // Update the given cost/benefit to also account for reclamation of a huge
@@ -718,6 +1195,35 @@ void mm_estimate_async_prezeroing_benefit(
     cost->benefit = min(action->prezero_n, recent_used) * zeroing_per_page_cost;
 }
 
+// Find the busiest zone->lock among the zones asynczero works on, based on
+// the sampled lock accounting in the page allocator. Returns false if there
+// are no measurements yet.
+static bool busiest_zone_lock(unsigned int *hold_permille, u64 *avg_wait)
+{
+    struct zone *zone;
+    struct zone_lock_load load;
+    bool found = false;
+
+    *hold_permille = 0;
+    *avg_wait = 0;
+
+    for_each_populated_zone(zone) {
+        // asynczero doesn't touch ZONE_DMA/ZONE_DMA32.
+        if (zone_idx(zone) < ZONE_NORMAL)
+            continue;
+
+        zone_lock_window_read(zone, &load);
+        if (!load.avg_hold_cycles)
+            continue;
+
+        found = true;
+        *hold_permille = max(*hold_permille, load.hold_permille);
+        *avg_wait = max(*avg_wait, load.avg_wait_cycles);
+    }
+
+    return found;
+}
+
 // Estimate the cost of lock contention due to prezeroing.
 //
 // During the LTU, we can grab the lock at times when it would otherwise be
@@ -726,14 +1232,26 @@ void mm_estimate_async_prezeroing_benefit(
 // linked list), then we get the number of times per LTU we can do prezeroing
 // for free.
 //
+// How long the lock is idle comes from the measured hold time of the busiest
+// zone->lock over the last few ms, and each of our acquisitions also has to
+// wait about as long as other acquirers have been waiting recently.
+//
 // We can then discount action->prezero_n operations by the number of free
 // items and expense the rest at the cost of the critical section.
 void mm_estimate_async_prezeroing_lock_contention_cost(
        const struct mm_action *action, struct mm_cost_delta *cost)
 {
-    const u64 critical_section_cost = 150 * 2; // cycles
-    const u64 nfree = mm_econ_contention_ms * mm_econ_freq_mhz * 1000
-                      / critical_section_cost;
+    unsigned int hold_permille;
+    u64 avg_wait;
+    u64 critical_section_cost = 150 * 2; // cycles
+    u64 nfree = mm_econ_contention_ms * mm_econ_freq_mhz * 1000
+                / critical_section_cost;
+
+    if (busiest_zone_lock(&hold_permille, &avg_wait)) {
+        critical_section_cost = (150 + avg_wait) * 2;
+        nfree = (1000 - hold_permille) * ZONE_LOCK_WINDOW_MS
+                * mm_econ_freq_mhz / critical_section_cost;
+    }
 
     cost->cost += (action->prezero_n > nfree ? action->prezero_n - nfree  : 0)
                     * critical_section_cost;
@@ -753,9 +1271,290 @@ void mm_estimate_eager_page_cost_benefit(
     compute_eager_page_benefit(action, cost);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Per-memcg policy and accounting.
+//
+// Each memcg can override mm_econ_mode for its tasks (and those of its
+// descendants) and cap the cost charged to it per LTU. Decisions made in
+// kernel threads, or for tasks in the root memcg, use the global mode and are
+// not charged anywhere.
+
+#ifdef CONFIG_MEMCG
+// Returns the memcg to charge decisions made by current to, or NULL.
+// Caller must hold rcu_read_lock().
+static struct mem_cgroup *mm_econ_current_memcg(void)
+{
+    struct mem_cgroup *memcg;
+
+    if (mem_cgroup_disabled())
+        return NULL;
+
+    memcg = mem_cgroup_from_task(current);
+    if (!memcg || mem_cgroup_is_root(memcg))
+        return NULL;
+
+    return memcg;
+}
+
+// The mode set by the closest ancestor that doesn't inherit, or the global
+// mode.
+static int mm_econ_memcg_mode(struct mem_cgroup *memcg)
+{
+    int mode;
+
+    for (; memcg && !mem_cgroup_is_root(memcg); memcg = parent_mem_cgroup(memcg)) {
+        mode = READ_ONCE(memcg->econ.mode);
+        if (mode != MEMCG_ECON_INHERIT)
+            return mode;
+    }
+
+    return mm_econ_mode;
+}
+
+// Charge `cost` cycles to memcg and its ancestors for the current LTU.
+// Returns false without charging anything if any of them would go over its
+// budget.
+//
+// The LTU rollover and the budget check race with other CPUs, so a memcg can
+// go over budget by a few decisions' worth. That's fine for our purposes.
+static bool mm_econ_memcg_charge(struct mem_cgroup *memcg, u64 cost)
+{
+    struct mem_cgroup *iter;
+    unsigned long now = jiffies;
+    u64 budget;
+
+    for (iter = memcg; iter && !mem_cgroup_is_root(iter);
+            iter = parent_mem_cgroup(iter))
+    {
+        struct memcg_econ *econ = &iter->econ;
+
+        if (time_after_eq(now, READ_ONCE(econ->ltu_start)
+                    + msecs_to_jiffies(MM_ECON_LTU)))
+        {
+            WRITE_ONCE(econ->ltu_start, now);
+            atomic64_set(&econ->ltu_spent, 0);
+        }
+
+        budget = READ_ONCE(econ->budget);
+        if (budget != U64_MAX
+                && atomic64_read(&econ->ltu_spent) + cost > budget)
+        {
+            atomic64_inc(&econ->decisions_over_budget);
+            return false;
+        }
+    }
+
+    for (iter = memcg; iter && !mem_cgroup_is_root(iter);
+            iter = parent_mem_cgroup(iter))
+    {
+        atomic64_add(cost, &iter->econ.ltu_spent);
+        atomic64_add(cost, &iter->econ.cost_charged);
+    }
+
+    return true;
+}
+
+static void mm_econ_memcg_account(struct mem_cgroup *memcg,
+        const struct mm_action *action, bool should_do)
+{
+    for (; memcg && !mem_cgroup_is_root(memcg); memcg = parent_mem_cgroup(memcg)) {
+        struct memcg_econ *econ = &memcg->econ;
+
+        atomic64_inc(&econ->decisions);
+        if (!should_do)
+            continue;
+
+        atomic64_inc(&econ->decisions_yes);
+        if (action->action == MM_ACTION_EAGER_PAGING)
+            atomic64_add(action->len, &econ->eager_bytes);
+    }
+}
+
+static void mm_econ_memcg_register_promotion(struct mm_struct *mm)
+{
+    struct mem_cgroup *memcg;
+
+    if (mem_cgroup_disabled())
+        return;
+
+    rcu_read_lock();
+    memcg = mm ? mem_cgroup_from_task(rcu_dereference(mm->owner))
+               : mm_econ_current_memcg();
+    for (; memcg && !mem_cgroup_is_root(memcg); memcg = parent_mem_cgroup(memcg))
+        atomic64_inc(&memcg->econ.hp_promotions);
+    rcu_read_unlock();
+}
+#else
+static inline struct mem_cgroup *mm_econ_current_memcg(void)
+{
+    return NULL;
+}
+
+static inline int mm_econ_memcg_mode(struct mem_cgroup *memcg)
+{
+    return mm_econ_mode;
+}
+
+static inline bool mm_econ_memcg_charge(struct mem_cgroup *memcg, u64 cost)
+{
+    return true;
+}
+
+static inline void mm_econ_memcg_account(struct mem_cgroup *memcg,
+        const struct mm_action *action, bool should_do)
+{
+}
+
+static inline void mm_econ_memcg_register_promotion(struct mm_struct *mm)
+{
+}
+#endif /* CONFIG_MEMCG */
+
+///////////////////////////////////////////////////////////////////////////////
+// Budgeted mode.
+//
+// In mode 2, decisions that pass the benefit > cost test must also fit in a
+// budget of cycles per LTU, both globally and for the node the action uses
+// (cost->nid, if any). This keeps a burst of marginal decisions, e.g. a run
+// of promotions after a large mmap, from spending seconds on compaction and
+// zeroing in one LTU.
+//
+// Decisions are made one at a time as faults come in, so we can't sort an
+// LTU's decisions by benefit/cost and take the best ones. Instead, we record
+// how much cost was asked for in each log2(benefit/cost) bucket during the
+// LTU, and at the start of the next one pick the lowest bucket such that
+// everything at or above it would have fit in the budget. Decisions below
+// that bucket are deferred (a promotion can be retried by a later fault or by
+// khugepaged); the others are admitted until the budget runs out and rejected
+// after that.
+
+#define MM_ECON_BUDGET_NR_BUCKETS 16
+
+struct mm_econ_budget_window {
+    unsigned long start; // jiffies
+    // Lowest ratio bucket admitted in this window.
+    int cutoff;
+    atomic64_t spent;
+    atomic64_t node_spent[MAX_NUMNODES];
+    // Cost of the profitable decisions in each ratio bucket, admitted or not.
+    atomic64_t demand[MM_ECON_BUDGET_NR_BUCKETS];
+};
+
+static struct mm_econ_budget_window mm_econ_budget_window;
+static DEFINE_SPINLOCK(mm_econ_budget_lock);
+
+// Bucket i holds decisions with 2^i <= benefit/cost < 2^(i+1). The ratio is
+// at least 1 since only profitable decisions get here.
+static int mm_econ_budget_bucket(const struct mm_cost_delta *cost)
+{
+    u64 ratio;
+
+    if (cost->cost == 0)
+        return MM_ECON_BUDGET_NR_BUCKETS - 1;
+
+    ratio = cost->benefit / cost->cost;
+    if (ratio == 0)
+        return 0;
+
+    return min(ilog2(ratio), MM_ECON_BUDGET_NR_BUCKETS - 1);
+}
+
+// Start a new window if the current one is at least an LTU old.
+static void mm_econ_budget_rollover(unsigned long now)
+{
+    struct mm_econ_budget_window *w = &mm_econ_budget_window;
+    u64 budget = READ_ONCE(mm_econ_budget);
+    u64 demand = 0;
+    int b, nid, cutoff = 0;
+
+    spin_lock(&mm_econ_budget_lock);
+
+    // Someone else got here first.
+    if (!time_after_eq(now, w->start + msecs_to_jiffies(MM_ECON_LTU))) {
+        spin_unlock(&mm_econ_budget_lock);
+        return;
+    }
+
+    // Walk down from the best ratio until the demand doesn't fit. That bucket
+    // is the marginal one: it gets whatever budget is left, first come first
+    // served, and everything below it is deferred.
+    for (b = MM_ECON_BUDGET_NR_BUCKETS - 1; b >= 0; b--) {
+        demand += atomic64_xchg(&w->demand[b], 0);
+        if (cutoff == 0 && budget != U64_MAX && demand > budget)
+            cutoff = b;
+    }
+
+    atomic64_set(&w->spent, 0);
+    for (nid = 0; nid < MAX_NUMNODES; nid++)
+        atomic64_set(&w->node_spent[nid], 0);
+    WRITE_ONCE(w->cutoff, cutoff);
+    WRITE_ONCE(w->start, now);
+
+    spin_unlock(&mm_econ_budget_lock);
+}
+
+// Returns true if a profitable decision fits in the budget. This doesn't
+// charge anything, since the decision may still be refused by its memcg; see
+// mm_econ_budget_charge().
+//
+// As with memcg budgets, the checks race with other CPUs, so the budget can
+// be overspent by a few decisions' worth.
+static bool mm_econ_budget_admit(const struct mm_cost_delta *cost)
+{
+    struct mm_econ_budget_window *w = &mm_econ_budget_window;
+    u64 budget = READ_ONCE(mm_econ_budget);
+    u64 node_budget = READ_ONCE(mm_econ_node_budget);
+    unsigned long now = jiffies;
+    int bucket = mm_econ_budget_bucket(cost);
+    int nid = cost->nid;
+
+    if (nid < 0 || nid >= MAX_NUMNODES)
+        nid = NUMA_NO_NODE;
+
+    if (time_after_eq(now, READ_ONCE(w->start) + msecs_to_jiffies(MM_ECON_LTU)))
+        mm_econ_budget_rollover(now);
+
+    atomic64_add(cost->cost, &w->demand[bucket]);
+
+    if (bucket < READ_ONCE(w->cutoff)) {
+        mm_econ_num_decisions_deferred += 1;
+        return false;
+    }
+
+    if ((budget != U64_MAX
+                && atomic64_read(&w->spent) + cost->cost > budget)
+            || (nid != NUMA_NO_NODE && node_budget != U64_MAX
+                && atomic64_read(&w->node_spent[nid]) + cost->cost > node_budget))
+    {
+        mm_econ_num_decisions_rejected += 1;
+        return false;
+    }
+
+    return true;
+}
+
+// Charge an admitted decision's cost to the current window.
+static void mm_econ_budget_charge(const struct mm_cost_delta *cost)
+{
+    struct mm_econ_budget_window *w = &mm_econ_budget_window;
+    int nid = cost->nid;
+
+    atomic64_add(cost->cost, &w->spent);
+    if (nid >= 0 && nid < MAX_NUMNODES)
+        atomic64_add(cost->cost, &w->node_spent[nid]);
+}
+
+// Is mm_econ on for the current task? This follows the task's memcg, so
+// kernel threads see the global mode.
 bool mm_econ_is_on(void)
 {
-    return mm_econ_mode > 0;
+    int mode;
+
+    rcu_read_lock();
+    mode = mm_econ_memcg_mode(mm_econ_current_memcg());
+    rcu_read_unlock();
+
+    return mode > 0;
 }
 EXPORT_SYMBOL(mm_econ_is_on);
 
@@ -767,6 +1566,9 @@ EXPORT_SYMBOL(mm_econ_is_on);
 void
 mm_estimate_changes(const struct mm_action *action, struct mm_cost_delta *cost)
 {
+    cost->nid = NUMA_NO_NODE;
+    cost->benefit_src = MM_ECON_BENEFIT_NONE;
+
     switch (action->action) {
         case MM_ACTION_NONE:
             cost->cost = 0;
@@ -774,6 +1576,7 @@ mm_estimate_changes(const struct mm_action *action, struct mm_cost_delta *cost)
             break;
 
         case MM_ACTION_PROMOTE_HUGE:
+        case MM_ACTION_PROMOTE_HUGE_FILE:
             mm_estimate_huge_page_promote_cost_benefit(action, cost);
             break;
 
@@ -824,6 +1627,7 @@ mm_estimate_changes(const struct mm_action *action, struct mm_cost_delta *cost)
     mm_econ_num_estimates += 1;
     mm_stats_hist_measure(&mm_econ_cost, cost->cost);
     mm_stats_hist_measure(&mm_econ_benefit, cost->benefit);
+    trace_mm_econ_estimate(action, cost);
 
     if (mm_econ_debugging_mode == 2) {
         pr_warn("estimator: action=%d cost=%llu benefit=%llu",
@@ -832,34 +1636,89 @@ mm_estimate_changes(const struct mm_action *action, struct mm_cost_delta *cost)
 }
 EXPORT_SYMBOL(mm_estimate_changes);
 
+// Attachment point for decision policies loaded as BPF programs.
+//
+// A kprobe program attached here can use bpf_override_return() (requires
+// CONFIG_BPF_KPROBE_OVERRIDE) to return MM_DECIDE_HOOK_YES or a negative errno
+// and so replace the built-in benefit > cost policy for that decision. The
+// default body defers to the built-in policy. This is marked __weak so that
+// the compiler can't assume the return value at the call site in mm_decide().
+noinline __weak int
+mm_decide_hook(const struct mm_action *action, const struct mm_cost_delta *cost)
+{
+    return MM_DECIDE_HOOK_DEFAULT;
+}
+ALLOW_ERROR_INJECTION(mm_decide_hook, ERRNO);
+
 // Decide whether to take an action with the given cost. Returns true if the
 // action associated with `cost` should be TAKEN, and false otherwise.
-bool mm_decide(const struct mm_cost_delta *cost)
+//
+// The cost of actions that are taken is charged to the current task's memcg,
+// and actions are refused if that memcg is out of budget. In budgeted mode,
+// they must also fit in the global and per-node budgets.
+bool mm_decide(const struct mm_action *action, const struct mm_cost_delta *cost)
 {
-    bool should_do;
+    struct mem_cgroup *memcg;
+    bool should_do = false;
+    int mode, hook;
     mm_econ_num_decisions += 1;
 
-    if (mm_econ_mode == 0) {
-        return true;
-    } else if (mm_econ_mode == 1) {
-        should_do = cost->benefit > cost->cost;
+    rcu_read_lock();
+    memcg = mm_econ_current_memcg();
+    mode = mm_econ_memcg_mode(memcg);
+
+    if (mode == 0) {
+        should_do = true;
+    } else if (mode == 1 || mode == 2) {
+        hook = mm_decide_hook(action, cost);
+        if (hook != MM_DECIDE_HOOK_DEFAULT) {
+            should_do = hook > 0;
+            mm_econ_num_decisions_hooked += 1;
+        } else {
+            should_do = cost->benefit > cost->cost;
+        }
+
+        if (should_do && mode == 2 && !mm_econ_budget_admit(cost))
+            should_do = false;
+
+        if (should_do && !mm_econ_memcg_charge(memcg, cost->cost)) {
+            should_do = false;
+            mm_econ_num_decisions_over_budget += 1;
+        }
+
+        // Only now that the memcg took it, so that a memcg that is out of
+        // budget can't use up the global budget for everyone else.
+        if (should_do && mode == 2)
+            mm_econ_budget_charge(cost);
 
         if (should_do)
             mm_econ_num_decisions_yes += 1;
-
-        //pr_warn("mm_econ: cost=%llu benefit=%llu\n", cost->cost, cost->benefit); // TODO remove
-        return should_do;
     } else {
         BUG();
-        return false;
     }
+
+    mm_econ_memcg_account(memcg, action, should_do);
+    rcu_read_unlock();
+
+    trace_mm_econ_decide(action, cost, mode, should_do);
+    return should_do;
+}
+EXPORT_SYMBOL(mm_decide);
+
+// Inform the estimator of the promotion of the given huge page in `mm`. If
+// `mm` is NULL, it is the current task's.
+void mm_register_promotion(struct mm_struct *mm, u64 addr)
+{
+    mm_econ_num_hp_promotions += 1;
+    mm_econ_memcg_register_promotion(mm);
 }
-EXPORT_SYMBOL(mm_decide);
 
-// Inform the estimator of the promotion of the given huge page.
-void mm_register_promotion(u64 addr)
+// Inform the estimator that a huge page was allocated on node `nid` in a #PF.
+void mm_register_huge_page_placement(int nid)
 {
-    mm_econ_num_hp_promotions += 1;
+    mm_econ_num_hp_placed += 1;
+    if (nid != numa_node_id())
+        mm_econ_num_hp_placed_remote += 1;
 }
 
 static bool mm_does_quantity_match(struct mmap_comparison *c, u64 val)
@@ -974,6 +1833,138 @@ static int mm_copy_profile_range(
     return 0;
 }
 
+static struct mm_profile *mm_profile_alloc(void)
+{
+    struct mm_profile *profile = mm_econ_vmalloc(sizeof(struct mm_profile));
+
+    if (!profile)
+        return NULL;
+
+    profile->refcount = 1;
+    INIT_LIST_HEAD(&profile->filters);
+    profile->hp_ranges_root = RB_ROOT;
+    profile->eager_ranges_root = RB_ROOT;
+
+    return profile;
+}
+
+// Drop a reference to a profile, freeing it if it was the last one.
+//
+// Caller must hold `filter_procs_sem` in write mode, unless nobody else can
+// see the profile.
+static void mm_profile_put(struct mm_profile *profile)
+{
+    if (--profile->refcount)
+        return;
+
+    profile_free_all(&profile->hp_ranges_root);
+    profile_free_all(&profile->eager_ranges_root);
+    mmap_filters_free_all(profile);
+    mm_econ_vfree(profile, sizeof(struct mm_profile));
+}
+
+// Make a deep copy of a profile. Returns NULL if out of memory.
+//
+// Caller must hold `filter_procs_sem` in either read or write mode.
+static struct mm_profile *mm_profile_copy(struct mm_profile *profile)
+{
+    struct mm_profile *new_profile;
+    struct mmap_filter *filter = NULL;
+    struct mmap_filter *new_filter = NULL;
+    struct mmap_comparison *comparison = NULL;
+    struct mmap_comparison *new_comparison = NULL;
+
+    new_profile = mm_profile_alloc();
+    if (!new_profile)
+        return NULL;
+
+    // First, copy the filters
+    list_for_each_entry(filter, &profile->filters, node) {
+        new_filter = mm_econ_vmalloc(sizeof(struct mmap_filter));
+        if (!new_filter)
+            goto err;
+
+        new_filter->section = filter->section;
+        new_filter->benefit = filter->benefit;
+        new_filter->policy = filter->policy;
+        INIT_LIST_HEAD(&new_filter->comparisons);
+
+        list_add_tail(&new_filter->node, &new_profile->filters);
+
+        list_for_each_entry(comparison, &filter->comparisons, node) {
+            new_comparison = mm_econ_vmalloc(sizeof(struct mmap_comparison));
+            if (!new_comparison)
+                goto err;
+
+            new_comparison->quant = comparison->quant;
+            new_comparison->comp = comparison->comp;
+            new_comparison->val = comparison->val;
+
+            list_add_tail(&new_comparison->node, &new_filter->comparisons);
+        }
+    }
+
+    // Now, copy the ranges
+    if (mm_copy_profile_range(&profile->hp_ranges_root,
+                &new_profile->hp_ranges_root) != 0)
+        goto err;
+    if (mm_copy_profile_range(&profile->eager_ranges_root,
+                &new_profile->eager_ranges_root) != 0)
+        goto err;
+
+    return new_profile;
+
+err:
+    mm_profile_put(new_profile);
+    return NULL;
+}
+
+// Make sure `proc` has a profile of its own before it changes it, copying it
+// if it is shared. Returns the profile to change, or NULL if out of memory,
+// in which case the shared profile is left as is.
+//
+// Caller must hold `filter_procs_sem` in write mode.
+static struct mm_profile *mm_profile_unshare(struct mmap_filter_proc *proc)
+{
+    struct mm_profile *profile = proc->profile;
+
+    if (profile->refcount == 1)
+        return profile;
+
+    profile = mm_profile_copy(proc->profile);
+    if (!profile)
+        return NULL;
+
+    mm_profile_put(proc->profile);
+    proc->profile = profile;
+    mm_econ_num_profile_copies += 1;
+
+    return profile;
+}
+
+// Would inserting the ranges in `new_root` into `ranges_root` change the
+// profile? Ranges no filter matched have no benefit, so they only matter if
+// they replace existing ranges.
+static bool profile_ranges_change(struct rb_root *ranges_root,
+        struct rb_root *new_root)
+{
+    struct rb_node *node;
+    struct profile_range *range, *old_range;
+
+    for (node = rb_first(new_root); node; node = rb_next(node)) {
+        range = container_of(node, struct profile_range, node);
+        if (range->benefit != 0)
+            return true;
+
+        old_range = profile_find_first_range(ranges_root, range->start,
+                CompGreaterThan);
+        if (old_range && old_range->start < range->end)
+            return true;
+    }
+
+    return false;
+}
+
 // Search mmap_filters for a filter that matches this new memory map
 // and add it to the list of ranges.
 // pid: The pid of the process who made this mmap
@@ -992,6 +1983,7 @@ void mm_add_memory_range(pid_t pid, enum mm_memory_section section, u64 mapaddr,
         u64 addr, u64 len, u64 prot, u64 flags, u64 fd, u64 off)
 {
     struct mmap_filter_proc *proc;
+    struct mm_profile *profile;
     struct mmap_filter *filter;
     struct mmap_comparison *comp;
     struct profile_range *range = NULL;
@@ -1001,6 +1993,8 @@ void mm_add_memory_range(pid_t pid, enum mm_memory_section section, u64 mapaddr,
     struct rb_root huge_subranges = RB_ROOT;
     struct rb_root eager_subranges = RB_ROOT;
     struct rb_node *range_node = NULL;
+    // Set once a filter has matched the whole range for that policy.
+    bool huge_done = false, eager_done = false;
     bool passes_filter;
     u64 val;
 
@@ -1012,8 +2006,6 @@ void mm_add_memory_range(pid_t pid, enum mm_memory_section section, u64 mapaddr,
     if (!proc)
         return;
 
-    filter_head = &proc->filters;
-
     // Start with the original range of the new mapping
     range = mm_econ_vmalloc(sizeof(struct profile_range));
     if (!range) {
@@ -1033,6 +2025,7 @@ void mm_add_memory_range(pid_t pid, enum mm_memory_section section, u64 mapaddr,
 
     // Check if this mmap matches any of our filters
     down_read(&filter_procs_sem);
+    filter_head = &proc->profile->filters;
     list_for_each_entry(filter, filter_head, node) {
         // Each filter only applies to either the eager or huge page policy
         // This variable points to the applicable subranges tree
@@ -1042,15 +2035,21 @@ void mm_add_memory_range(pid_t pid, enum mm_memory_section section, u64 mapaddr,
         struct rb_root temp_subranges = RB_ROOT;
         // The range in the subranges tree that we are splitting
         struct profile_range *parent_range = NULL;
+        bool *done = NULL;
 
         if (filter->policy == PolicyHugePage) {
             subranges = &huge_subranges;
+            done = &huge_done;
         } else if (filter->policy == PolicyEagerPage) {
             subranges = &eager_subranges;
+            done = &eager_done;
         } else {
             BUG();
         }
 
+        if (*done)
+            continue;
+
         passes_filter = section == filter->section;
 
         list_for_each_entry(comp, &filter->comparisons, node) {
@@ -1183,17 +2182,38 @@ void mm_add_memory_range(pid_t pid, enum mm_memory_section section, u64 mapaddr,
             }
 
             // Because the entire new range matched a filter, we no longer
-            // have to check the rest of the filters
-            break;
+            // have to check the rest of the filters for this policy
+            *done = true;
+            if (huge_done && eager_done)
+                break;
+        }
+        // Otherwise, throw away any splits made while checking the filter
+        else {
+            profile_free_all(&temp_subranges);
         }
     }
     up_read(&filter_procs_sem);
 
-    // Finally, insert all of the new ranges into the proc's tree
+    // Finally, insert all of the new ranges into the proc's tree. A shared
+    // profile is only copied if they actually change it; otherwise they are
+    // dropped, so a forked child that maps things its parent's filters don't
+    // care about keeps sharing.
     down_write(&filter_procs_sem);
-    profile_move(&huge_subranges, &proc->hp_ranges_root);
-    profile_move(&eager_subranges, &proc->eager_ranges_root);
+    profile = proc->profile;
+    if (profile->refcount > 1 &&
+            (profile_ranges_change(&profile->hp_ranges_root, &huge_subranges) ||
+             profile_ranges_change(&profile->eager_ranges_root, &eager_subranges)))
+        profile = mm_profile_unshare(proc);
+    if (profile && profile->refcount == 1) {
+        profile_move(&huge_subranges, &profile->hp_ranges_root);
+        profile_move(&eager_subranges, &profile->eager_ranges_root);
+    }
     up_write(&filter_procs_sem);
+
+    if (!profile)
+        pr_warn("mm_add_memory_range: no memory to copy profile");
+    profile_free_all(&huge_subranges);
+    profile_free_all(&eager_subranges);
     return;
 
 err:
@@ -1204,83 +2224,127 @@ void mm_add_memory_range(pid_t pid, enum mm_memory_section section, u64 mapaddr,
     //printk("Added range %d %llx %llx %lld %llx\n", section, range->start, range->end, range->benefit, len);
 }
 
-void mm_copy_profile(pid_t old_pid, pid_t new_pid)
+// Called after mm_add_memory_range() for a mapping [mapaddr, mapaddr + len)
+// of `inode` at page offset `pgoff`. Copies the huge page ranges the filters
+// gave the mapping into the file's profile, translated to file offsets, so
+// that shmem allocations and khugepaged's collapse_file() can use them. A
+// later mapping of the same part of the file replaces them.
+void mm_add_file_range(pid_t pid, struct inode *inode, u64 mapaddr, u64 len,
+        u64 pgoff)
 {
-    struct mmap_filter_proc *proc = NULL;
-    struct mmap_filter_proc *new_proc = NULL;
-    struct mmap_filter *filter = NULL;
-    struct mmap_filter *new_filter = NULL;
-    struct mmap_comparison *comparison = NULL;
-    struct mmap_comparison *new_comparison = NULL;
+    struct mmap_filter_proc *proc;
+    struct mm_file_profile *fp;
+    struct profile_range *range = NULL;
+    struct profile_range *new_range;
+    struct rb_root new_ranges = RB_ROOT;
+    struct rb_node *node = NULL;
+    const u64 end = mapaddr + len;
+    const u64 file_base = pgoff << PAGE_SHIFT;
 
     down_read(&filter_procs_sem);
+    if ((proc = find_filter_proc_by_pid(pid))) // NOTE: assignment
+        range = profile_find_first_range(&proc->profile->hp_ranges_root, mapaddr,
+                CompGreaterThan);
+    if (range)
+        node = &range->node;
 
-    // First, find out if a profile for old_pid exists
-    proc = find_filter_proc_by_pid(old_pid);
+    for (; node; node = rb_next(node)) {
+        range = container_of(node, struct profile_range, node);
+        if (range->start >= end)
+            break;
+        if (range->benefit == 0)
+            continue;
 
-    if (!proc) {
-        up_read(&filter_procs_sem);
-        return;
+        new_range = mm_econ_vmalloc(sizeof(struct profile_range));
+        if (!new_range) {
+            up_read(&filter_procs_sem);
+            goto err;
+        }
+
+        new_range->start = max(range->start, mapaddr) - mapaddr + file_base;
+        new_range->end = min(range->end, end) - mapaddr + file_base;
+        new_range->benefit = range->benefit;
+        profile_range_insert(&new_ranges, new_range);
     }
+    up_read(&filter_procs_sem);
 
-    new_proc = mm_econ_vmalloc(sizeof(struct mmap_filter_proc));
-    if (!new_proc)
-        goto err;
-    new_proc->pid = new_pid;
-    INIT_LIST_HEAD(&new_proc->filters);
-    new_proc->hp_ranges_root = RB_ROOT;
-    new_proc->eager_ranges_root = RB_ROOT;
+    if (RB_EMPTY_ROOT(&new_ranges))
+        return;
 
-    // First, copy the filters
-    list_for_each_entry(filter, &proc->filters, node) {
-        new_filter = mm_econ_vmalloc(sizeof(struct mmap_filter));
-        if (!new_filter)
+    down_write(&filter_procs_sem);
+    fp = find_file_profile(inode);
+    if (!fp) {
+        fp = mm_econ_vmalloc(sizeof(struct mm_file_profile));
+        if (!fp) {
+            up_write(&filter_procs_sem);
             goto err;
+        }
+        fp->inode = inode;
+        fp->hp_ranges_root = RB_ROOT;
+        list_add_tail(&fp->node, &file_profiles);
+    }
+    profile_move(&new_ranges, &fp->hp_ranges_root);
+    up_write(&filter_procs_sem);
+    return;
 
-        new_filter->section = filter->section;
-        new_filter->benefit = filter->benefit;
-        new_filter->policy = filter->policy;
-        INIT_LIST_HEAD(&new_filter->comparisons);
-
-        list_add_tail(&new_filter->node, &new_proc->filters);
+err:
+    pr_warn("mm_add_file_range: no memory for new range");
+    profile_free_all(&new_ranges);
+}
 
-        list_for_each_entry(comparison, &filter->comparisons, node) {
-            new_comparison = mm_econ_vmalloc(sizeof(struct mmap_comparison));
-            if (!new_comparison)
-                goto err;
+// Called when `inode` is evicted, to drop its profile, if any.
+void mm_drop_file_profile(struct inode *inode)
+{
+    struct mm_file_profile *fp;
 
-            new_comparison->quant = comparison->quant;
-            new_comparison->comp = comparison->comp;
-            new_comparison->val = comparison->val;
+    // Almost no inodes have a profile, so don't take the lock for them.
+    if (list_empty(&file_profiles))
+        return;
 
-            list_add_tail(&new_comparison->node, &new_filter->comparisons);
-        }
+    down_write(&filter_procs_sem);
+    fp = find_file_profile(inode);
+    if (fp) {
+        profile_free_all(&fp->hp_ranges_root);
+        list_del(&fp->node);
+        mm_econ_vfree(fp, sizeof(struct mm_file_profile));
     }
+    up_write(&filter_procs_sem);
+}
 
-    // Now, copy the ranges
-    if (mm_copy_profile_range(&proc->hp_ranges_root, &new_proc->hp_ranges_root) != 0)
-        goto err;
-    if (mm_copy_profile_range(&proc->eager_ranges_root, &new_proc->eager_ranges_root) != 0)
-        goto err;
+// Called on fork. The child shares the parent's profile, so this doesn't
+// depend on the size of the profile.
+void mm_copy_profile(pid_t old_pid, pid_t new_pid)
+{
+    struct mmap_filter_proc *proc = NULL;
+    struct mmap_filter_proc *new_proc = NULL;
 
+    // First, find out if a profile for old_pid exists
+    down_read(&filter_procs_sem);
+    proc = find_filter_proc_by_pid(old_pid);
     up_read(&filter_procs_sem);
 
-    // Now, add the new proc to the list of procs
+    if (!proc)
+        return;
+
+    new_proc = mm_econ_vmalloc(sizeof(struct mmap_filter_proc));
+    if (!new_proc) {
+        pr_warn("mm_econ: Unable to copy profile from %d to %d", old_pid, new_pid);
+        return;
+    }
+    new_proc->pid = new_pid;
+
+    // Look the parent up again, as it may have exited in the meantime
     down_write(&filter_procs_sem);
-    list_add_tail(&new_proc->node, &filter_procs);
+    proc = find_filter_proc_by_pid(old_pid);
+    if (proc) {
+        new_proc->profile = proc->profile;
+        new_proc->profile->refcount++;
+        list_add_tail(&new_proc->node, &filter_procs);
+    }
     up_write(&filter_procs_sem);
 
-    return;
-err:
-    up_read(&filter_procs_sem);
-
-    pr_warn("mm_econ: Unable to copy profile from %d to %d", old_pid, new_pid);
-    if (new_proc) {
-        profile_free_all(&new_proc->hp_ranges_root);
-        profile_free_all(&new_proc->eager_ranges_root);
-        mmap_filters_free_all(new_proc);
+    if (!proc)
         mm_econ_vfree(new_proc, sizeof(struct mmap_filter_proc));
-    }
 }
 
 void mm_profile_check_exiting_proc(pid_t pid)
@@ -1293,10 +2357,9 @@ void mm_profile_check_exiting_proc(pid_t pid)
 
     if (proc) {
         down_write(&filter_procs_sem);
-        // If the process exits, we should also clear its profile
-        profile_free_all(&proc->hp_ranges_root);
-        profile_free_all(&proc->eager_ranges_root);
-        mmap_filters_free_all(proc);
+        // If the process exits, we should also clear its profile, unless
+        // it is still shared with a parent or child
+        mm_profile_put(proc->profile);
 
         // Remove the node from the list
         list_del(&proc->node);
@@ -1327,7 +2390,7 @@ static ssize_t enabled_store(struct kobject *kobj,
         mm_econ_mode = 0;
         return ret;
     }
-    else if (mode >= 0 && mode <= 1) {
+    else if (mode >= 0 && mode <= 2) {
         mm_econ_mode = mode;
         return count;
     }
@@ -1418,6 +2481,124 @@ static ssize_t freq_mhz_store(struct kobject *kobj,
 static struct kobj_attribute freq_mhz_attr =
 __ATTR(freq_mhz, 0644, freq_mhz_show, freq_mhz_store);
 
+static ssize_t numa_distance_cost_show(struct kobject *kobj,
+        struct kobj_attribute *attr, char *buf)
+{
+    return sprintf(buf, "%llu\n", mm_econ_numa_distance_cost);
+}
+
+static ssize_t numa_distance_cost_store(struct kobject *kobj,
+        struct kobj_attribute *attr,
+        const char *buf, size_t count)
+{
+    u64 cycles;
+    int ret;
+
+    ret = kstrtou64(buf, 0, &cycles);
+
+    if (ret != 0) {
+        return ret;
+    }
+    else {
+        mm_econ_numa_distance_cost = cycles;
+        return count;
+    }
+}
+static struct kobj_attribute numa_distance_cost_attr =
+__ATTR(numa_distance_cost, 0644, numa_distance_cost_show,
+        numa_distance_cost_store);
+
+static ssize_t budget_show_one(u64 budget, char *buf)
+{
+    if (budget == U64_MAX)
+        return sprintf(buf, "max\n");
+    return sprintf(buf, "%llu\n", budget);
+}
+
+static int budget_parse(const char *buf, u64 *budget)
+{
+    if (sysfs_streq(buf, "max")) {
+        *budget = U64_MAX;
+        return 0;
+    }
+    return kstrtou64(buf, 0, budget);
+}
+
+static ssize_t budget_show(struct kobject *kobj,
+        struct kobj_attribute *attr, char *buf)
+{
+    return budget_show_one(READ_ONCE(mm_econ_budget), buf);
+}
+
+static ssize_t budget_store(struct kobject *kobj,
+        struct kobj_attribute *attr,
+        const char *buf, size_t count)
+{
+    u64 budget;
+    int ret;
+
+    ret = budget_parse(buf, &budget);
+    if (ret != 0)
+        return ret;
+
+    WRITE_ONCE(mm_econ_budget, budget);
+    return count;
+}
+static struct kobj_attribute budget_attr =
+__ATTR(budget, 0644, budget_show, budget_store);
+
+static ssize_t node_budget_show(struct kobject *kobj,
+        struct kobj_attribute *attr, char *buf)
+{
+    return budget_show_one(READ_ONCE(mm_econ_node_budget), buf);
+}
+
+static ssize_t node_budget_store(struct kobject *kobj,
+        struct kobj_attribute *attr,
+        const char *buf, size_t count)
+{
+    u64 budget;
+    int ret;
+
+    ret = budget_parse(buf, &budget);
+    if (ret != 0)
+        return ret;
+
+    WRITE_ONCE(mm_econ_node_budget, budget);
+    return count;
+}
+static struct kobj_attribute node_budget_attr =
+__ATTR(node_budget, 0644, node_budget_show, node_budget_store);
+
+static ssize_t vma_benefit_show(struct kobject *kobj,
+        struct kobj_attribute *attr, char *buf)
+{
+    return sprintf(buf, "%d\n", mm_econ_vma_benefit);
+}
+
+static ssize_t vma_benefit_store(struct kobject *kobj,
+        struct kobj_attribute *attr,
+        const char *buf, size_t count)
+{
+    int mode;
+    int ret;
+
+    ret = kstrtoint(buf, 0, &mode);
+
+    if (ret != 0) {
+        return ret;
+    }
+    else if (mode == 0 || mode == 1) {
+        mm_econ_vma_benefit = mode;
+        return count;
+    }
+    else {
+        return -EINVAL;
+    }
+}
+static struct kobj_attribute vma_benefit_attr =
+__ATTR(vma_benefit, 0644, vma_benefit_show, vma_benefit_store);
+
 static ssize_t stats_show(struct kobject *kobj,
         struct kobj_attribute *attr, char *buf)
 {
@@ -1425,14 +2606,28 @@ static ssize_t stats_show(struct kobject *kobj,
             "estimated=%lld\ndecided=%lld\n"
             "yes=%lld\npromoted=%lld\n"
             "compactions=%lld\nprezerotry=%lld\n"
-            "vmallocbytes=%lld\n",
+            "vmallocbytes=%lld\n"
+            "remotechosen=%lld\nplaced=%lld\nplacedremote=%lld\n"
+            "hooked=%lld\noverbudget=%lld\n"
+            "deferred=%lld\nrejected=%lld\nbudgetcutoff=%d\n"
+            "profilecopies=%lld\nvmaestimates=%lld\n",
             mm_econ_num_estimates,
             mm_econ_num_decisions,
             mm_econ_num_decisions_yes,
             mm_econ_num_hp_promotions,
             mm_econ_num_async_compaction,
             mm_econ_num_async_prezeroing,
-            mm_econ_vmalloc_bytes);
+            mm_econ_vmalloc_bytes,
+            mm_econ_num_remote_chosen,
+            mm_econ_num_hp_placed,
+            mm_econ_num_hp_placed_remote,
+            mm_econ_num_decisions_hooked,
+            mm_econ_num_decisions_over_budget,
+            mm_econ_num_decisions_deferred,
+            mm_econ_num_decisions_rejected,
+            READ_ONCE(mm_econ_budget_window.cutoff),
+            mm_econ_num_profile_copies,
+            mm_econ_num_vma_estimates);
 }
 
 static ssize_t stats_store(struct kobject *kobj,
@@ -1450,6 +2645,10 @@ static struct attribute *mm_econ_attr[] = {
     &stats_attr.attr,
     &debugging_mode_attr.attr,
     &freq_mhz_attr.attr,
+    &numa_distance_cost_attr.attr,
+    &budget_attr.attr,
+    &node_budget_attr.attr,
+    &vma_benefit_attr.attr,
     NULL,
 };
 
@@ -1554,7 +2753,7 @@ static ssize_t mmap_filters_read(struct file *file,
     if (!proc)
         goto out;
 
-    filter_head = &proc->filters;
+    filter_head = &proc->profile->filters;
 
     // Print out all of the filters
     list_for_each_entry(filter, filter_head, node) {
@@ -1777,8 +2976,14 @@ static ssize_t mmap_filters_write(struct file *file,
 
         // Initialize the new proc
         proc->pid = task->tgid;
-        INIT_LIST_HEAD(&proc->filters);
-        proc->hp_ranges_root = RB_ROOT;
+        proc->profile = mm_profile_alloc();
+        if (!proc->profile) {
+            up_write(&filter_procs_sem);
+            mm_econ_vfree(proc, sizeof(struct mmap_filter_proc));
+            proc = NULL;
+            error = -ENOMEM;
+            goto err;
+        }
     }
     up_write(&filter_procs_sem);
 
@@ -1859,9 +3064,15 @@ static ssize_t mmap_filters_write(struct file *file,
         if (invalid_filter)
             break;
 
-        // Add the new filter to the list
+        // Add the new filter to the list, copying the profile first if it
+        // is shared with a parent or child
         down_write(&filter_procs_sem);
-        list_add_tail(&filter->node, &proc->filters);
+        if (!mm_profile_unshare(proc)) {
+            up_write(&filter_procs_sem);
+            error = -ENOMEM;
+            goto err;
+        }
+        list_add_tail(&filter->node, &proc->profile->filters);
         up_write(&filter_procs_sem);
 
         // Get the next filter
@@ -1898,10 +3109,13 @@ static ssize_t mmap_filters_write(struct file *file,
         mm_econ_vfree(filter, sizeof(struct mmap_filter));
     if (proc) {
         down_write(&filter_procs_sem);
-        mmap_filters_free_all(proc);
+        if (mm_profile_unshare(proc))
+            mmap_filters_free_all(proc->profile);
         up_write(&filter_procs_sem);
-        if (alloc_new_proc)
+        if (alloc_new_proc) {
+            mm_profile_put(proc->profile);
             mm_econ_vfree(proc, sizeof(struct mmap_filter_proc));
+        }
     }
     if (task)
         put_task_struct(task);
@@ -1979,11 +3193,11 @@ static ssize_t print_profile(struct file *file,
 
     down_read(&filter_procs_sem);
     len += sprintf(buffer, "Huge Page Ranges:\n");
-    node = rb_first(&proc->hp_ranges_root);
+    node = rb_first(&proc->profile->hp_ranges_root);
     len += print_range_tree(&buffer[len], MMAP_FILTER_BUF_SIZE - len, node);
 
     len += sprintf(&buffer[len], "Eager Page Ranges:\n");
-    node = rb_first(&proc->eager_ranges_root);
+    node = rb_first(&proc->profile->eager_ranges_root);
     len += print_range_tree(&buffer[len], MMAP_FILTER_BUF_SIZE - len, node);
 
     up_read(&filter_procs_sem);
@@ -2022,6 +3236,12 @@ static int __init mm_econ_init(void)
         return err;
     }
 
+    mm_econ_budget_window.start = jiffies;
+
     return 0;
 }
 subsys_initcall(mm_econ_init);
+
+#ifdef CONFIG_MM_ECON_KUNIT_TEST
+#include "estimator-test.c"
+#endif
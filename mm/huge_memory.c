@@ -9,6 +9,8 @@
 #include <linux/sched.h>
 #include <linux/sched/coredump.h>
 #include <linux/sched/numa_balancing.h>
+#include <linux/sched/mm.h>
+#include <linux/ptrace.h>
 #include <linux/highmem.h>
 #include <linux/hugetlb.h>
 #include <linux/mmu_notifier.h>
@@ -35,6 +37,8 @@
 #include <linux/page_owner.h>
 #include <linux/mm_stats.h>
 #include <linux/rbtree.h>
+#include <linux/refcount.h>
+#include <linux/sort.h>
 #include <linux/badger_trap.h>
 #include <linux/mm_econ.h>
 
@@ -259,12 +263,284 @@ static void huge_addr_free_tree(struct rb_root *root)
 	}
 }
 
+/*
+ * Per-mm explicit huge page ranges, set through /proc/<pid>/huge_addr_ranges.
+ *
+ * Unlike the global huge_addr settings above, these belong to the address
+ * space rather than to a pid: every thread of the process sees them, and a
+ * forked child shares its parent's set until either one writes a new one.
+ * exec() starts with a fresh mm and so with no ranges.
+ *
+ * A set is an immutable array of disjoint [start, end) ranges sorted by start.
+ * Writers build a new set and publish it with RCU, so the fault path only
+ * does a binary search under rcu_read_lock().
+ */
+struct huge_addr_ranges {
+	refcount_t refcount;
+	struct rcu_head rcu;
+	unsigned int nr;
+	struct {
+		u64 start;
+		u64 end;
+	} ranges[];
+};
+
+/* Serializes writers of mm->huge_addr_ranges. */
+static DEFINE_MUTEX(huge_addr_ranges_lock);
+
+#define HUGE_ADDR_RANGES_MAX_WRITE (16 * PAGE_SIZE)
+
+static void huge_addr_ranges_put(struct huge_addr_ranges *set)
+{
+	if (set && refcount_dec_and_test(&set->refcount))
+		kfree_rcu(set, rcu);
+}
+
+bool huge_addr_mm_in_range(struct mm_struct *mm, unsigned long address)
+{
+	struct huge_addr_ranges *set;
+	unsigned int lo, hi, mid;
+	bool found = false;
+
+	if (!rcu_access_pointer(mm->huge_addr_ranges))
+		return false;
+
+	rcu_read_lock();
+	set = rcu_dereference(mm->huge_addr_ranges);
+	if (set) {
+		lo = 0;
+		hi = set->nr;
+		while (lo < hi) {
+			mid = lo + (hi - lo) / 2;
+			if (address < set->ranges[mid].start) {
+				hi = mid;
+			} else if (address >= set->ranges[mid].end) {
+				lo = mid + 1;
+			} else {
+				found = true;
+				break;
+			}
+		}
+	}
+	rcu_read_unlock();
+
+	return found;
+}
+
+/* Called from dup_mm(): the child shares the parent's ranges. */
+void huge_addr_mm_dup(struct mm_struct *mm, struct mm_struct *oldmm)
+{
+	struct huge_addr_ranges *set;
+
+	if (!rcu_access_pointer(oldmm->huge_addr_ranges))
+		return;
+
+	mutex_lock(&huge_addr_ranges_lock);
+	set = rcu_dereference_protected(oldmm->huge_addr_ranges,
+			lockdep_is_held(&huge_addr_ranges_lock));
+	if (set)
+		refcount_inc(&set->refcount);
+	rcu_assign_pointer(mm->huge_addr_ranges, set);
+	mutex_unlock(&huge_addr_ranges_lock);
+}
+
+/* Called from __mmdrop(), when nobody else can see the mm anymore. */
+void huge_addr_mm_free(struct mm_struct *mm)
+{
+	huge_addr_ranges_put(rcu_dereference_protected(mm->huge_addr_ranges, 1));
+	RCU_INIT_POINTER(mm->huge_addr_ranges, NULL);
+}
+
+static int huge_addr_ranges_cmp(const void *a, const void *b)
+{
+	const u64 *ra = a, *rb = b; /* each entry starts with `start` */
+
+	if (*ra < *rb)
+		return -1;
+	return *ra > *rb;
+}
+
+/*
+ * Parse "start end;start end;..." (the same syntax as huge_addr in mode 3)
+ * into a new set. An empty string yields NULL, which clears the ranges.
+ */
+static struct huge_addr_ranges *huge_addr_ranges_parse(char *buf, int *err)
+{
+	struct huge_addr_ranges *set;
+	unsigned int max_nr = 1, i;
+	char *tok, *p;
+	u64 start, end;
+
+	*err = 0;
+	buf = strim(buf);
+	if (!*buf)
+		return NULL;
+
+	for (p = buf; *p; p++)
+		if (*p == ';')
+			max_nr++;
+
+	set = kzalloc(struct_size(set, ranges, max_nr), GFP_KERNEL);
+	if (!set) {
+		*err = -ENOMEM;
+		return NULL;
+	}
+	refcount_set(&set->refcount, 1);
+
+	while ((tok = strsep(&buf, ";"))) {
+		tok = strim(tok);
+		if (!*tok)
+			continue;
+
+		p = strsep(&tok, " ");
+		if (!tok || kstrtoull(p, 0, &start) ||
+		    kstrtoull(strim(tok), 0, &end) || start >= end)
+			goto einval;
+
+		set->ranges[set->nr].start = start;
+		set->ranges[set->nr].end = end;
+		set->nr++;
+	}
+
+	if (!set->nr)
+		goto einval;
+
+	sort(set->ranges, set->nr, sizeof(set->ranges[0]),
+	     huge_addr_ranges_cmp, NULL);
+
+	// The lookup is a binary search, so the ranges must not overlap.
+	for (i = 1; i < set->nr; i++)
+		if (set->ranges[i].start < set->ranges[i - 1].end)
+			goto einval;
+
+	return set;
+
+einval:
+	kfree(set);
+	*err = -EINVAL;
+	return NULL;
+}
+
+extern inline struct task_struct *extern_get_proc_task(const struct inode *inode);
+
+static ssize_t huge_addr_ranges_read(struct file *file, char __user *ubuf,
+				     size_t count, loff_t *ppos)
+{
+	struct task_struct *task = extern_get_proc_task(file_inode(file));
+	struct huge_addr_ranges *set = NULL;
+	struct mm_struct *mm;
+	size_t size, len = 0;
+	unsigned int i;
+	ssize_t ret;
+	char *buf;
+
+	if (!task)
+		return -ESRCH;
+	mm = mm_access(task, PTRACE_MODE_READ_FSCREDS);
+	put_task_struct(task);
+	if (IS_ERR_OR_NULL(mm))
+		return mm ? PTR_ERR(mm) : 0;
+
+	mutex_lock(&huge_addr_ranges_lock);
+	set = rcu_dereference_protected(mm->huge_addr_ranges,
+			lockdep_is_held(&huge_addr_ranges_lock));
+	if (set)
+		refcount_inc(&set->refcount);
+	mutex_unlock(&huge_addr_ranges_lock);
+	mmput(mm);
+
+	if (!set)
+		return 0;
+
+	// Two 64-bit hex numbers, a space and a separator per range.
+	size = set->nr * 2 * (2 + 16 + 1);
+	buf = kmalloc(size, GFP_KERNEL);
+	if (!buf) {
+		huge_addr_ranges_put(set);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < set->nr; i++)
+		len += scnprintf(buf + len, size - len, "0x%llx 0x%llx%c",
+				 set->ranges[i].start, set->ranges[i].end,
+				 i + 1 < set->nr ? ';' : '\n');
+
+	ret = simple_read_from_buffer(ubuf, count, ppos, buf, len);
+
+	kfree(buf);
+	huge_addr_ranges_put(set);
+	return ret;
+}
+
+static ssize_t huge_addr_ranges_write(struct file *file,
+				      const char __user *ubuf,
+				      size_t count, loff_t *ppos)
+{
+	struct task_struct *task;
+	struct huge_addr_ranges *set, *old;
+	struct mm_struct *mm;
+	char *buf;
+	int err;
+
+	if (*ppos != 0 || count > HUGE_ADDR_RANGES_MAX_WRITE)
+		return -EINVAL;
+
+	buf = memdup_user_nul(ubuf, count);
+	if (IS_ERR(buf))
+		return PTR_ERR(buf);
+
+	set = huge_addr_ranges_parse(buf, &err);
+	kfree(buf);
+	if (err)
+		return err;
+
+	task = extern_get_proc_task(file_inode(file));
+	if (!task) {
+		huge_addr_ranges_put(set);
+		return -ESRCH;
+	}
+	mm = mm_access(task, PTRACE_MODE_ATTACH_FSCREDS);
+	put_task_struct(task);
+	if (IS_ERR_OR_NULL(mm)) {
+		huge_addr_ranges_put(set);
+		return mm ? PTR_ERR(mm) : -ESRCH;
+	}
+
+	mutex_lock(&huge_addr_ranges_lock);
+	old = rcu_replace_pointer(mm->huge_addr_ranges, set,
+			lockdep_is_held(&huge_addr_ranges_lock));
+	mutex_unlock(&huge_addr_ranges_lock);
+
+	huge_addr_ranges_put(old);
+	mmput(mm);
+
+	*ppos += count;
+	return count;
+}
+
+const struct file_operations proc_huge_addr_ranges_operations = {
+	.read = huge_addr_ranges_read,
+	.write = huge_addr_ranges_write,
+	.llseek = default_llseek,
+};
+
 // Is huge_addr enabled for the huge page containing `address`?
 bool huge_addr_enabled(struct vm_area_struct *vma, unsigned long address)
 {
 	pid_t vma_owner_pid;
 	unsigned long fault_address_aligned = address & PMD_PAGE_MASK;
 
+	// Check if the fault address's vma is large enough for a huge page.
+	if (vma->vm_start > fault_address_aligned ||
+	    vma->vm_end <= (fault_address_aligned + HPAGE_PMD_SIZE))
+	{
+		return false;
+	}
+
+	// Per-mm ranges apply regardless of huge_addr_pid and huge_addr_mode.
+	if (huge_addr_mm_in_range(vma->vm_mm, address))
+		return true;
+
 	if (huge_addr_pid == 0 || (huge_addr == 0 && huge_addr_mode != 3)) {
 		return false;
 	}
@@ -278,13 +554,6 @@ bool huge_addr_enabled(struct vm_area_struct *vma, unsigned long address)
 		return false;
 	}
 
-	// Check if the fault address's vma is large enough for a huge page.
-	if (vma->vm_start > fault_address_aligned ||
-	    vma->vm_end <= (fault_address_aligned + HPAGE_PMD_SIZE))
-	{
-		return false;
-	}
-
 	// Check if the fault address is within the huge region...
 	switch (huge_addr_mode) {
 		case 0:
@@ -1084,10 +1353,13 @@ static vm_fault_t __do_huge_pmd_anonymous_page(struct vm_fault *vmf,
 
 	pftrace->prep_start_tsc = rdtsc();
 	lfpa_update(rdtsc());
-	if(PageZeroed(page))
+	if(PageZeroed(page)) {
 		mm_stats_set_flag(pftrace, MM_STATS_PF_ALLOC_PREZEROED);
-	else
+		count_vm_event(PGALLOC_ZEROED_HIT);
+	} else {
 		clear_huge_page(page, vmf->address, HPAGE_PMD_NR);
+		count_vm_event(PGALLOC_ZEROED_MISS);
+	}
 	pftrace->prep_end_tsc = rdtsc();
 	/*
 	 * The memory barrier inside __SetPageUptodate makes sure that
@@ -1173,9 +1445,9 @@ static inline gfp_t alloc_hugepage_direct_gfpmask(
 
 		mm_action.address = haddr;
 		mm_action.action = MM_ACTION_ALLOC_RECLAIM;
-		mm_action.huge_page_order = HPAGE_PUD_SHIFT-PAGE_SHIFT;
+		mm_action.huge_page_order = HPAGE_PMD_ORDER;
 		mm_estimate_changes(&mm_action, &mm_cost_delta);
-		should_do = mm_decide(&mm_cost_delta);
+		should_do = mm_decide(&mm_action, &mm_cost_delta);
 
 		// TODO: Also eval if __GFP_KSWAPD_RECLAIM is worth it...
 		// perhaps if value of THP is high but cost of direct reclaim
@@ -1235,7 +1507,7 @@ static bool set_huge_zero_page(pgtable_t pgtable, struct mm_struct *mm,
 
 vm_fault_t do_huge_pmd_anonymous_page(struct vm_fault *vmf,
 				      struct mm_stats_pftrace *pftrace,
-				      bool require_prezeroed)
+				      bool require_prezeroed, int nid)
 {
 	struct vm_area_struct *vma = vmf->vma;
 	gfp_t gfp;
@@ -1296,7 +1568,14 @@ vm_fault_t do_huge_pmd_anonymous_page(struct vm_fault *vmf,
 	}
 	pftrace->alloc_start_tsc = rdtsc();
 	gfp = alloc_hugepage_direct_gfpmask(vma, haddr);
-	page = alloc_hugepage_vma(gfp, vma, haddr, HPAGE_PMD_ORDER);
+#ifdef CONFIG_NUMA
+	// The estimator may have picked a node other than the local one.
+	if (nid != NUMA_NO_NODE)
+		page = alloc_pages_vma(gfp, HPAGE_PMD_ORDER, vma, haddr, nid,
+				       true);
+	else
+#endif
+		page = alloc_hugepage_vma(gfp, vma, haddr, HPAGE_PMD_ORDER);
 	pftrace->alloc_end_tsc = rdtsc();
 	mm_stats_check_alloc_fallback(pftrace);
 	mm_stats_check_alloc_zeroing(pftrace);
@@ -1325,6 +1604,7 @@ vm_fault_t do_huge_pmd_anonymous_page(struct vm_fault *vmf,
 		count_vm_event(THP_FAULT_FALLBACK);
 		return VM_FAULT_FALLBACK;
 	}
+	mm_register_huge_page_placement(page_to_nid(page));
 	prep_transhuge_page(page);
 	ret = __do_huge_pmd_anonymous_page(vmf, page, gfp, pftrace);
 
@@ -818,10 +818,28 @@ static bool vma_has_reserves(struct vm_area_struct *vma, long chg)
 	return false;
 }
 
+/*
+ * A free page that the prezero worker is zeroing is locked. It is still on
+ * the free list and counted as free, but must not be handed out or freed
+ * until it is unlocked. See hugetlb_prezero_workfn().
+ */
+static inline bool hugetlb_page_zeroing(struct page *page)
+{
+	return PageLocked(page);
+}
+
 static void enqueue_huge_page(struct hstate *h, struct page *page)
 {
 	int nid = page_to_nid(page);
-	list_move(&page->lru, &h->hugepage_freelists[nid]);
+
+	/*
+	 * With prezeroing, keep zeroed pages at the front of the free list so
+	 * they are handed out first, and the rest at the back for the worker.
+	 */
+	if (!h->prezero || PageZeroed(page))
+		list_move(&page->lru, &h->hugepage_freelists[nid]);
+	else
+		list_move_tail(&page->lru, &h->hugepage_freelists[nid]);
 	h->free_huge_pages++;
 	h->free_huge_pages_node[nid]++;
 }
@@ -831,7 +849,7 @@ static struct page *dequeue_huge_page_node_exact(struct hstate *h, int nid)
 	struct page *page;
 
 	list_for_each_entry(page, &h->hugepage_freelists[nid], lru)
-		if (!PageHWPoison(page))
+		if (!PageHWPoison(page) && !hugetlb_page_zeroing(page))
 			break;
 	/*
 	 * if 'non-isolated free hugepage' not found on the list,
@@ -1067,7 +1085,7 @@ static void update_and_free_page(struct hstate *h, struct page *page)
 		page[i].flags &= ~(1 << PG_locked | 1 << PG_error |
 				1 << PG_referenced | 1 << PG_dirty |
 				1 << PG_active | 1 << PG_private |
-				1 << PG_writeback);
+				1 << PG_writeback | 1 << PG_zeroed);
 	}
 	VM_BUG_ON_PAGE(hugetlb_cgroup_from_page(page), page);
 	set_compound_page_dtor(page, NULL_COMPOUND_DTOR);
@@ -1138,6 +1156,128 @@ static inline void ClearPageHugeTemporary(struct page *page)
 	page[2].mapping = NULL;
 }
 
+/*
+ * Background prezeroing of the free pool.
+ *
+ * When h->prezero is set, a worker zeroes free huge pages (including
+ * gigantic ones) and marks them PG_zeroed on the head page. Zeroed pages sit
+ * at the front of their node's free list, so they are allocated first, and
+ * hugetlb_no_page() skips clear_huge_page() for them. PG_zeroed is dropped
+ * whenever a page comes back to the pool.
+ *
+ * While a page is being zeroed, it stays on the free list and is still counted
+ * as free, so reservations and hugetlb_acct_memory() are not affected. It is
+ * locked instead (see hugetlb_page_zeroing()), and the allocator, pool
+ * shrinking and dissolving all leave it alone. An allocation that finds
+ * nothing else on the free list waits for the zeroing to finish rather than
+ * failing; see alloc_huge_page().
+ */
+static void hugetlb_prezero_workfn(struct work_struct *work);
+static DECLARE_WORK(hugetlb_prezero_work, hugetlb_prezero_workfn);
+static DECLARE_WAIT_QUEUE_HEAD(hugetlb_prezero_wq);
+
+static inline void hugetlb_prezero_kick(struct hstate *h)
+{
+	if (READ_ONCE(h->prezero))
+		queue_work(system_unbound_wq, &hugetlb_prezero_work);
+}
+
+/*
+ * Pick a free page to zero and lock it. Only do so while there are unreserved
+ * free pages, so that reserved allocations rarely have to wait for us.
+ *
+ * Called with hugetlb_lock held.
+ */
+static struct page *hugetlb_prezero_start(struct hstate *h, int nid)
+{
+	struct page *page;
+
+	if (h->free_huge_pages - h->resv_huge_pages == 0)
+		return NULL;
+
+	list_for_each_entry_reverse(page, &h->hugepage_freelists[nid], lru) {
+		/* Zeroed pages are at the front, so we are done. */
+		if (PageZeroed(page))
+			return NULL;
+		if (PageHWPoison(page))
+			continue;
+		if (!trylock_page(page))
+			continue;
+
+		h->zeroing_huge_pages++;
+		return page;
+	}
+
+	return NULL;
+}
+
+static void hugetlb_prezero_finish(struct hstate *h, struct page *page)
+{
+	spin_lock(&hugetlb_lock);
+	SetPageZeroed(page);
+	list_move(&page->lru, &h->hugepage_freelists[page_to_nid(page)]);
+	h->zeroing_huge_pages--;
+	unlock_page(page);
+	spin_unlock(&hugetlb_lock);
+
+	wake_up_all(&hugetlb_prezero_wq);
+}
+
+static void hugetlb_prezero_workfn(struct work_struct *work)
+{
+	struct hstate *h;
+	struct page *page;
+	unsigned long i;
+	bool progress;
+	int nid;
+
+	do {
+		progress = false;
+
+		for_each_hstate(h) {
+			if (!READ_ONCE(h->prezero))
+				continue;
+
+			for_each_node_state(nid, N_MEMORY) {
+				spin_lock(&hugetlb_lock);
+				page = hugetlb_prezero_start(h, nid);
+				spin_unlock(&hugetlb_lock);
+				if (!page)
+					continue;
+
+				/* Gigantic pages may not have contiguous memmap. */
+				for (i = 0; i < pages_per_huge_page(h); i++) {
+					cond_resched();
+					clear_highpage(nth_page(page, i));
+				}
+
+				hugetlb_prezero_finish(h, page);
+				progress = true;
+			}
+		}
+	} while (progress);
+}
+
+/* Number of free huge pages that are prezeroed. */
+static unsigned long hugetlb_nr_zeroed(struct hstate *h, int nid)
+{
+	struct page *page;
+	unsigned long nr = 0;
+	int n;
+
+	spin_lock(&hugetlb_lock);
+	for_each_node_state(n, N_MEMORY) {
+		if (nid != NUMA_NO_NODE && n != nid)
+			continue;
+		list_for_each_entry(page, &h->hugepage_freelists[n], lru)
+			if (PageZeroed(page))
+				nr++;
+	}
+	spin_unlock(&hugetlb_lock);
+
+	return nr;
+}
+
 static void __free_huge_page(struct page *page)
 {
 	/*
@@ -1196,9 +1336,12 @@ static void __free_huge_page(struct page *page)
 		h->surplus_huge_pages_node[nid]--;
 	} else {
 		arch_clear_hugepage_flags(page);
+		ClearPageZeroed(page);
 		enqueue_huge_page(h, page);
 	}
 	spin_unlock(&hugetlb_lock);
+
+	hugetlb_prezero_kick(h);
 }
 
 /*
@@ -1252,6 +1395,7 @@ void free_huge_page(struct page *page)
 static void prep_new_huge_page(struct hstate *h, struct page *page, int nid)
 {
 	INIT_LIST_HEAD(&page->lru);
+	ClearPageZeroed(page);
 	set_compound_page_dtor(page, HUGETLB_PAGE_DTOR);
 	spin_lock(&hugetlb_lock);
 	set_hugetlb_cgroup(page, NULL);
@@ -1445,15 +1589,21 @@ static int free_pool_huge_page(struct hstate *h, nodemask_t *nodes_allowed,
 	int ret = 0;
 
 	for_each_node_mask_to_free(h, nr_nodes, node, nodes_allowed) {
+		struct page *page = NULL, *iter;
+
 		/*
 		 * If we're returning unused surplus pages, only examine
 		 * nodes with surplus pages.
 		 */
-		if ((!acct_surplus || h->surplus_huge_pages_node[node]) &&
-		    !list_empty(&h->hugepage_freelists[node])) {
-			struct page *page =
-				list_entry(h->hugepage_freelists[node].next,
-					  struct page, lru);
+		if (!acct_surplus || h->surplus_huge_pages_node[node]) {
+			list_for_each_entry(iter, &h->hugepage_freelists[node], lru) {
+				if (!hugetlb_page_zeroing(iter)) {
+					page = iter;
+					break;
+				}
+			}
+		}
+		if (page) {
 			list_del(&page->lru);
 			h->free_huge_pages--;
 			h->free_huge_pages_node[node]--;
@@ -1500,6 +1650,8 @@ int dissolve_free_huge_page(struct page *page)
 		int nid = page_to_nid(head);
 		if (h->free_huge_pages - h->resv_huge_pages == 0)
 			goto out;
+		if (hugetlb_page_zeroing(head))
+			goto out;
 		/*
 		 * Move PageHWPoison flag from head page to the raw error page,
 		 * which makes any subpages rather than the error page reusable.
@@ -2051,6 +2203,18 @@ struct page *alloc_huge_page(struct vm_area_struct *vma,
 	 * a reservation exists for the allocation.
 	 */
 	page = dequeue_huge_page_vma(h, vma, addr, avoid_reserve, gbl_chg);
+	/*
+	 * The only free page may be one the prezero worker is busy with. It
+	 * is still counted as free, so wait for it instead of failing.
+	 */
+	while (!page && h->zeroing_huge_pages) {
+		spin_unlock(&hugetlb_lock);
+		wait_event(hugetlb_prezero_wq,
+			   !READ_ONCE(h->zeroing_huge_pages));
+		spin_lock(&hugetlb_lock);
+		page = dequeue_huge_page_vma(h, vma, addr, avoid_reserve,
+					     gbl_chg);
+	}
 	if (!page) {
 		spin_unlock(&hugetlb_lock);
 		page = alloc_buddy_huge_page_with_mpol(h, vma, addr);
@@ -2254,7 +2418,7 @@ static void try_to_free_low(struct hstate *h, unsigned long count,
 		list_for_each_entry_safe(page, next, freel, lru) {
 			if (count >= h->nr_huge_pages)
 				return;
-			if (PageHighMem(page))
+			if (PageHighMem(page) || hugetlb_page_zeroing(page))
 				continue;
 			list_del(&page->lru);
 			update_and_free_page(h, page);
@@ -2628,12 +2792,66 @@ static ssize_t surplus_hugepages_show(struct kobject *kobj,
 }
 HSTATE_ATTR_RO(surplus_hugepages);
 
+static ssize_t zeroed_hugepages_show(struct kobject *kobj,
+					struct kobj_attribute *attr, char *buf)
+{
+	struct hstate *h;
+	int nid;
+
+	h = kobj_to_hstate(kobj, &nid);
+	return sprintf(buf, "%lu\n", hugetlb_nr_zeroed(h, nid));
+}
+HSTATE_ATTR_RO(zeroed_hugepages);
+
+static ssize_t prezero_show(struct kobject *kobj,
+					struct kobj_attribute *attr, char *buf)
+{
+	struct hstate *h = kobj_to_hstate(kobj, NULL);
+	return sprintf(buf, "%d\n", h->prezero);
+}
+
+static ssize_t prezero_store(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	struct hstate *h = kobj_to_hstate(kobj, NULL);
+	bool val;
+
+	if (kstrtobool(buf, &val))
+		return -EINVAL;
+
+	WRITE_ONCE(h->prezero, val);
+	hugetlb_prezero_kick(h);
+
+	return count;
+}
+HSTATE_ATTR(prezero);
+
+static ssize_t prezero_hits_show(struct kobject *kobj,
+					struct kobj_attribute *attr, char *buf)
+{
+	struct hstate *h = kobj_to_hstate(kobj, NULL);
+	return sprintf(buf, "%ld\n", atomic_long_read(&h->prezero_hits));
+}
+HSTATE_ATTR_RO(prezero_hits);
+
+static ssize_t prezero_misses_show(struct kobject *kobj,
+					struct kobj_attribute *attr, char *buf)
+{
+	struct hstate *h = kobj_to_hstate(kobj, NULL);
+	return sprintf(buf, "%ld\n", atomic_long_read(&h->prezero_misses));
+}
+HSTATE_ATTR_RO(prezero_misses);
+
 static struct attribute *hstate_attrs[] = {
 	&nr_hugepages_attr.attr,
 	&nr_overcommit_hugepages_attr.attr,
 	&free_hugepages_attr.attr,
 	&resv_hugepages_attr.attr,
 	&surplus_hugepages_attr.attr,
+	&zeroed_hugepages_attr.attr,
+	&prezero_attr.attr,
+	&prezero_hits_attr.attr,
+	&prezero_misses_attr.attr,
 #ifdef CONFIG_NUMA
 	&nr_hugepages_mempolicy_attr.attr,
 #endif
@@ -2701,6 +2919,7 @@ static struct attribute *per_node_hstate_attrs[] = {
 	&nr_hugepages_attr.attr,
 	&free_hugepages_attr.attr,
 	&surplus_hugepages_attr.attr,
+	&zeroed_hugepages_attr.attr,
 	NULL,
 };
 
@@ -3716,7 +3935,7 @@ static vm_fault_t hugetlb_cow(struct mm_struct *mm, struct vm_area_struct *vma,
 		if(is_badger_trap_enabled(mm, haddr)
 				&& !(flags & FAULT_FLAG_INSTRUCTION))
 		{
-			// new_entry = pte_mkreserve(new_entry); // TODO markm uncomment
+			new_entry = pte_mkreserve(new_entry);
 		}
 		set_huge_pte_at(mm, haddr, ptep, new_entry);
 		page_remove_rmap(old_page, true);
@@ -3884,7 +4103,14 @@ static vm_fault_t hugetlb_no_page(struct mm_struct *mm,
 			ret = vmf_error(PTR_ERR(page));
 			goto out;
 		}
-		clear_huge_page(page, address, pages_per_huge_page(h));
+		if (PageZeroed(page)) {
+			/* Zeroed in the background, see hugetlb_prezero_workfn() */
+			ClearPageZeroed(page);
+			atomic_long_inc(&h->prezero_hits);
+		} else {
+			clear_huge_page(page, address, pages_per_huge_page(h));
+			atomic_long_inc(&h->prezero_misses);
+		}
 		__SetPageUptodate(page);
 		new_page = true;
 
@@ -3951,7 +4177,7 @@ static vm_fault_t hugetlb_no_page(struct mm_struct *mm,
 
 	/* Make the page table entry as reserved for TLB miss tracking */
 	if(is_badger_trap_enabled(mm, haddr) && !(flags & FAULT_FLAG_INSTRUCTION)) {
-		// new_pte = pte_mkreserve(new_pte);// TODO markm uncomment
+		new_pte = pte_mkreserve(new_pte);
 	}
 
 	set_huge_pte_at(mm, haddr, ptep, new_pte);
@@ -4026,19 +4252,27 @@ static int hugetlb_fake_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 		return VM_FAULT_SIGBUS;
 
 	/* Here where we do all our analysis */
-	if (flags & FAULT_FLAG_WRITE)
-	    atomic64_inc(&mm->bt_stats->total_dtlb_2mb_store_misses);
-	else
-	    atomic64_inc(&mm->bt_stats->total_dtlb_2mb_load_misses);
-
-	/*
-	if (vma) {
-		if (flags & FAULT_FLAG_WRITE)
-		    vma->bt_stats.total_dtlb_2mb_store_misses++;
-		else
-		    vma->bt_stats.total_dtlb_2mb_load_misses++;
+	if (huge_page_size(hstate_vma(vma)) >= PUD_SIZE) {
+	    if (flags & FAULT_FLAG_WRITE) {
+		atomic64_inc(&mm->bt_stats->total_dtlb_1gb_store_misses);
+		if (vma->bt_stats)
+		    atomic64_inc(&vma->bt_stats->stats.total_dtlb_1gb_store_misses);
+	    } else {
+		atomic64_inc(&mm->bt_stats->total_dtlb_1gb_load_misses);
+		if (vma->bt_stats)
+		    atomic64_inc(&vma->bt_stats->stats.total_dtlb_1gb_load_misses);
+	    }
+	} else {
+	    if (flags & FAULT_FLAG_WRITE) {
+		atomic64_inc(&mm->bt_stats->total_dtlb_2mb_store_misses);
+		if (vma->bt_stats)
+		    atomic64_inc(&vma->bt_stats->stats.total_dtlb_2mb_store_misses);
+	    } else {
+		atomic64_inc(&mm->bt_stats->total_dtlb_2mb_load_misses);
+		if (vma->bt_stats)
+		    atomic64_inc(&vma->bt_stats->stats.total_dtlb_2mb_load_misses);
+	    }
 	}
-	*/
 
 	*page_table = pte_mkreserve(*page_table);
 	return 0;
@@ -4086,41 +4320,46 @@ vm_fault_t hugetlb_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	ptep = huge_pte_offset(mm, haddr, huge_page_size(h));
 
 	/*
-	 * Here we check for Huge page that are marked as reserved.
+	 * Here we check for Huge page that are marked as reserved. This works
+	 * the same way for 2MB (PMD) and 1GB (PUD) hstates, since ptep points
+	 * at whichever entry maps the huge page.
 	 *
-	 * As of Linux 5.5.8, hugetlb doesn't apparently support 1GB pages.
+	 * A write to a reserved, write-protected entry is a real COW fault, so
+	 * it is left to the normal path below, which keeps the reserved bit
+	 * (hugetlb_cow either keeps the entry or makes a new reserved one).
 	 */
-	if(mm && mm->badger_trap_was_enabled
-		&& !(flags & FAULT_FLAG_INSTRUCTION) && ptep)
+	if(mm && mm->badger_trap_was_enabled && ptep)
 	{
 		mapping = vma->vm_file->f_mapping;
 		idx = vma_hugecache_offset(h, vma, haddr);
 		hash = hugetlb_fault_mutex_hash(mapping, idx);
 		mutex_lock(&hugetlb_fault_mutex_table[hash]);
 		entry = huge_ptep_get(ptep);
-		if((flags & FAULT_FLAG_WRITE) && is_pte_reserved(entry)
-			&& !huge_pte_write(entry) && pte_present(entry))
+		if (!pte_present(entry)) {
+			/* Nothing to do; migration etc. are handled below. */
+		} else if((flags & FAULT_FLAG_INSTRUCTION)
+			|| !is_badger_trap_enabled(mm, address))
+		{
+			if (is_pte_reserved(entry)) {
+				ptl = huge_pte_lock(h, mm, ptep);
+				entry = huge_ptep_get(ptep);
+				if (pte_present(entry))
+					set_huge_pte_at(mm, haddr, ptep,
+							pte_unreserve(entry));
+				spin_unlock(ptl);
+			}
+		} else if(is_pte_reserved(entry)
+			&& !((flags & FAULT_FLAG_WRITE) && !huge_pte_write(entry)))
 		{
-			ptl = huge_pte_lock(h, mm, ptep);
-		        page = pte_page(entry);
-			if (page != pagecache_page)
-				if (!trylock_page(page)) {
-					need_wait_lock = 1;
-					ret = 0;
-					goto out_ptl;
-				}
-		        get_page(page);
-		        spin_lock(&mm->page_table_lock);
-			ret = hugetlb_cow(mm, vma, address, ptep,
-                                                 pagecache_page, ptl, flags);
-			goto out_put_page;
-		}
-		if(is_pte_reserved(entry) && pte_present(entry)) {
 			ret = hugetlb_fake_fault(mm, vma, address, ptep, flags);
 			goto out_mutex;
-		}
-		if(pte_present(entry) && is_badger_trap_enabled(mm, address)) {
-			//*ptep = pte_mkreserve(*ptep);  // TODO markm uncomment
+		} else if(!is_pte_reserved(entry)) {
+			ptl = huge_pte_lock(h, mm, ptep);
+			entry = huge_ptep_get(ptep);
+			if (pte_present(entry))
+				set_huge_pte_at(mm, haddr, ptep,
+						pte_mkreserve(entry));
+			spin_unlock(ptl);
 		}
 		mutex_unlock(&hugetlb_fault_mutex_table[hash]);
 	}
@@ -9,6 +9,7 @@ import matplotlib.ticker as ticker
 import numpy as np
 import sys
 import re
+import struct
 
 FILE = sys.argv[1]
 
@@ -75,11 +76,47 @@ def get_data(fname):
 
     return data
 
+# Layout of /proc/kbadgerd_results_raw. See include/uapi/linux/kbadgerd.h.
+RESULTS_MAGIC = 0x4744424b
+RESULTS_HEADER = struct.Struct("=IHHiIII")
+RESULTS_RECORD = struct.Struct("=QQQQQQQII")
+HPAGE_SHIFT = 21
+
+def is_binary_results(fname):
+    with open(fname, "rb") as f:
+        magic = f.read(4)
+    return len(magic) == 4 and struct.unpack("=I", magic)[0] == RESULTS_MAGIC
+
+# Read a binary results file, scaling the counts to misses/huge-page/LTU the
+# same way kbadgerd does when it prints its results to dmesg.
+def get_data_binary(fname):
+    data = []
+
+    with open(fname, "rb") as f:
+        buf = f.read()
+
+    (_magic, _version, record_size, _pid, nr_records, sleep_ms, ltu_ms) = \
+            RESULTS_HEADER.unpack_from(buf, 0)
+
+    for i in range(nr_records):
+        (start, end, nsamples, ld_4k, st_4k, ld_2m, st_2m, _flags, _) = \
+                RESULTS_RECORD.unpack_from(buf, RESULTS_HEADER.size + i * record_size)
+
+        size = max((end - start) >> HPAGE_SHIFT, 1)
+        scale = lambda misses: \
+                misses * ltu_ms // (sleep_ms * max(nsamples, 1)) // size
+
+        data.append((start, end,
+            scale(ld_4k), scale(st_4k), scale(ld_2m), scale(st_2m)))
+
+    return data
+
 # raw data in the form of a bunch of tuples:
 #   (start, end, counts...)
 #
 # The ranges may be overlapping though, so we need to handle that case.
-data = sorted(get_data(FILE), key=lambda x: x[0])
+data = sorted(get_data_binary(FILE) if is_binary_results(FILE) else get_data(FILE),
+        key=lambda x: x[0])
 
 for x in data:
     print([hex(v) for v in x])
@@ -14,10 +14,14 @@
 #include <linux/mm.h>
 #include <linux/sort.h>
 #include <linux/rbtree.h>
+#include <linux/interval_tree_generic.h>
 #include <linux/mm_econ.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <uapi/linux/kbadgerd.h>
 
 #define KBADGERD_SLEEP_MS 100
-#define KBADGERD_NEW_VMA_CHECK_RATE 4
+#define KBADGERD_MAX_VMA_EVENTS 32
 #define RANGE_SIZE_THRESHOLD HPAGE_PMD_SIZE
 
 // The minimum number of tlb misses for us to consider looking into a range.
@@ -34,6 +38,10 @@ struct kbadgerd_range {
 	u64 start;
 	u64 end; // exclusive
 
+	// The largest (inclusive) end address in the subtree rooted at
+	// range_node. Maintained by the interval tree code.
+	u64 subtree_last;
+
 	// Has the range ever been explored?
 	bool explored;
 
@@ -83,13 +91,30 @@ struct kbadgerd_state {
 	/* The data collected by inspection. */
 	struct rb_root_cached data;
 
-	/* List of old ranges, sorted by starting address. */
-	struct rb_root old_data;
+	/*
+	 * List of old ranges, sorted by starting address. This is an interval
+	 * tree (see kbadgerd_range_it_*), so that we can find the ranges
+	 * containing an address without walking the whole list.
+	 */
+	struct rb_root_cached old_data;
+
+	/* List of the VMA ranges tracked to detect new ranges. Also an
+	 * interval tree. */
+	struct rb_root_cached range;
 
-	/* List of the VMA ranges tracked to detect new ranges */
-	struct rb_root range;
+	/*
+	 * Address ranges where the inspected process got new or grown VMAs
+	 * since we last looked (see kbadgerd_vma_event()). Overlapping and
+	 * adjacent ranges are merged, and if there are too many, they are
+	 * all merged into one.
+	 */
+	struct {
+		u64 start;
+		u64 end; // exclusive
+	} vma_events[KBADGERD_MAX_VMA_EVENTS];
+	int nr_vma_events;
 
-	/* Protects the three trees.
+	/* Protects the three trees and vma_events.
 	 *
 	 * Lock order: grab mmap_sem and badger_trap_page_table_sem before this lock.
 	 */
@@ -132,11 +157,30 @@ static bool addr_in_range(u64 addr, struct kbadgerd_range *range)
 	return true;
 }
 
+static inline u64 kbadgerd_range_it_start(struct kbadgerd_range *range)
+{
+	return range->start;
+}
+
+static inline u64 kbadgerd_range_it_last(struct kbadgerd_range *range)
+{
+	return range->end - 1;
+}
+
+// The range and old_data trees are augmented interval trees keyed by start
+// address, in the style of lib/interval_tree.c. The overlap of any [a, b] with
+// the ranges in a tree can be found in O(log n + k) time.
+INTERVAL_TREE_DEFINE(struct kbadgerd_range, range_node, u64, subtree_last,
+		     kbadgerd_range_it_start, kbadgerd_range_it_last,
+		     static, kbadgerd_range_it)
+
 static u64 total_misses(const struct badger_trap_stats *stats) {
 	return atomic64_read(&stats->total_dtlb_2mb_load_misses)
 		+ atomic64_read(&stats->total_dtlb_2mb_store_misses)
 		+ atomic64_read(&stats->total_dtlb_4kb_load_misses)
-		+ atomic64_read(&stats->total_dtlb_4kb_store_misses);
+		+ atomic64_read(&stats->total_dtlb_4kb_store_misses)
+		+ atomic64_read(&stats->total_dtlb_1gb_load_misses)
+		+ atomic64_read(&stats->total_dtlb_1gb_store_misses);
 }
 
 /* Compares ranges by size/weight, not memory address. */
@@ -205,74 +249,68 @@ static noinline void kbadgerd_range_insert_by_weight(
 }
 
 static noinline void kbadgerd_range_insert_by_start(
-		struct rb_root *range_root,
+		struct rb_root_cached *range_root,
 		struct kbadgerd_range *new_range,
 		bool allow_overlap)
 {
-	struct rb_node **new = &(range_root->rb_node), *parent = NULL;
+	struct kbadgerd_range *this;
 
-	while (*new) {
-		struct kbadgerd_range *this =
-			container_of(*new, struct kbadgerd_range, range_node);
+	/* The ranges should not overlap*/
+	if (!allow_overlap) {
+		this = kbadgerd_range_it_iter_first(range_root,
+				kbadgerd_range_it_start(new_range),
+				kbadgerd_range_it_last(new_range));
 
-		/* The ranges should not overlap*/
-		if (!allow_overlap &&
-		    ((new_range->start <= this->start && this->start < new_range->end)
-		    || (this->start <= new_range->start && new_range->start < this->end)))
-		{
+		if (this) {
 			pr_err("kbadgerd: Attempted to insert overlapping range!\n");
 			pr_err("kbadgerd: old range=[%llx, %llx) new_range=[%llx, %llx)",
 					this->start, this->end,
 					new_range->start, new_range->end);
-		    	BUG();
+			BUG();
 			return;
 		}
-
-		parent = *new;
-		if (new_range->start < this->start)
-			new = &((*new)->rb_left);
-		else
-			new = &((*new)->rb_right);
 	}
 
-	rb_link_node(&new_range->range_node, parent, new);
-	rb_insert_color(&new_range->range_node, range_root);
+	kbadgerd_range_it_insert(new_range, range_root);
+}
+
+static void kbadgerd_range_remove_by_start(
+		struct rb_root_cached *range_root,
+		struct kbadgerd_range *range)
+{
+	kbadgerd_range_it_remove(range, range_root);
 }
 
 /*
  * Finds the smallest range in the tree that contains the given address and
  * returns it; or returns NULL if none was found.
+ *
+ * If `allow_overlap` is false, the tree has no overlapping ranges, so the
+ * first containing range is the only one.
  */
 static noinline struct kbadgerd_range *
 kbadgerd_range_search_by_addr(
 	u64 addr,
-	struct rb_root *range_root,
+	struct rb_root_cached *range_root,
 	bool allow_overlap)
 {
-	struct rb_node *node = rb_first(range_root);
 	struct kbadgerd_range *range, *best_range = NULL;
 
-	// Since there can be overlapping nodes in the tree, we need to start
-	// at the beginning and iterate until we are sure there can be no more
-	// matches.
-	while (node) {
-		range = container_of(node, struct kbadgerd_range, range_node);
-
-		// Have we reached the first range that is too high to contain
-		// our addr?
-		if (range->start > addr)
-			break;
+	// Only visit the ranges that actually contain addr. Since there can
+	// be overlapping (nested) ranges in old_data, keep the smallest.
+	for (range = kbadgerd_range_it_iter_first(range_root, addr, addr);
+	     range;
+	     range = kbadgerd_range_it_iter_next(range, addr, addr))
+	{
+		if (!allow_overlap)
+			return range;
 
-		// Try to find the smallest containing range.
-		if (addr_in_range(addr, range)
-			&& (!best_range
-			    || ((best_range->end - best_range->start) >
-				(range->end - range->start))))
+		if (!best_range
+		    || ((best_range->end - best_range->start) >
+			(range->end - range->start)))
 		{
 			best_range = range;
 		}
-
-		node = rb_next(node);
 	}
 
 	return best_range;
@@ -314,12 +352,22 @@ static void start_badger_trap(struct kbadgerd_range *range) {
 	badger_trap_walk(state.mm, range->start, range->end - 1, true);
 }
 
+// Scale a miss count summed over nsamples samples to misses per LTU. Each
+// sample lasts state.sleep_interval ms, which is what the results files report.
+static inline u64 misses_per_ltu(u64 misses, u64 nsamples)
+{
+	return misses * MM_ECON_LTU /
+		((u64)state.sleep_interval * max(nsamples, 1ull));
+}
+
 static void print_data(struct kbadgerd_range *range) {
 	u64 ld_4k = atomic64_read_acquire(&range->totals.total_dtlb_4kb_load_misses),
 	    st_4k = atomic64_read_acquire(&range->totals.total_dtlb_4kb_store_misses),
 	    ld_2m = atomic64_read_acquire(&range->totals.total_dtlb_2mb_load_misses),
 	    st_2m = atomic64_read_acquire(&range->totals.total_dtlb_2mb_store_misses),
-	    total = ld_4k + st_4k + ld_2m + st_2m;
+	    ld_1g = atomic64_read_acquire(&range->totals.total_dtlb_1gb_load_misses),
+	    st_1g = atomic64_read_acquire(&range->totals.total_dtlb_1gb_store_misses),
+	    total = ld_4k + st_4k + ld_2m + st_2m + ld_1g + st_1g;
 
 	pr_warn("kbadgerd: [%llx, %llx) (%lld bytes)", range->start, range->end,
 			range->end - range->start);
@@ -334,21 +382,27 @@ static void print_data(struct kbadgerd_range *range) {
 		}
 
 		// Scale time
-		ld_4k *= (MM_ECON_LTU / KBADGERD_SLEEP_MS) / nsamples;
-		st_4k *= (MM_ECON_LTU / KBADGERD_SLEEP_MS) / nsamples;
-		ld_2m *= (MM_ECON_LTU / KBADGERD_SLEEP_MS) / nsamples;
-		st_2m *= (MM_ECON_LTU / KBADGERD_SLEEP_MS) / nsamples;
+		ld_4k = misses_per_ltu(ld_4k, nsamples);
+		st_4k = misses_per_ltu(st_4k, nsamples);
+		ld_2m = misses_per_ltu(ld_2m, nsamples);
+		st_2m = misses_per_ltu(st_2m, nsamples);
+		ld_1g = misses_per_ltu(ld_1g, nsamples);
+		st_1g = misses_per_ltu(st_1g, nsamples);
 
 		// Scale size
 		ld_4k /= size > 0 ? size : 1;
 		st_4k /= size > 0 ? size : 1;
 		ld_2m /= size > 0 ? size : 1;
 		st_2m /= size > 0 ? size : 1;
+		ld_1g /= size > 0 ? size : 1;
+		st_1g /= size > 0 ? size : 1;
 
 		pr_warn("kbadgerd: \t4KB load misses: %lld", ld_4k);
 		pr_warn("kbadgerd: \t4KB store misses: %lld", st_4k);
 		pr_warn("kbadgerd: \t2MB load misses: %lld", ld_2m);
-		pr_warn("kbadgerd: \t2MB store misses: %lld\n", st_2m);
+		pr_warn("kbadgerd: \t2MB store misses: %lld", st_2m);
+		pr_warn("kbadgerd: \t1GB load misses: %lld", ld_1g);
+		pr_warn("kbadgerd: \t1GB store misses: %lld\n", st_1g);
 	} else {
 		pr_warn("kbadgerd: \tNo misses\n");
 	}
@@ -359,7 +413,7 @@ static void print_all_data(void) {
 	// The range tree is used here because it is sorted by the start address
 	// This relies on the invariant that the data and range trees have the
 	// same ranges
-	struct rb_node *node = rb_first(&state.range);
+	struct rb_node *node = rb_first_cached(&state.range);
 
 	pr_warn("kbadgerd: Results of inspection for pid=%d\n", state.pid);
 
@@ -371,7 +425,7 @@ static void print_all_data(void) {
 	}
 
 	pr_warn("kbadgerd: Discarded ranges for pid=%d\n", state.pid);
-	node = rb_first(&state.old_data);
+	node = rb_first_cached(&state.old_data);
 
 	while (node) {
 		range = container_of(node, struct kbadgerd_range, range_node);
@@ -383,54 +437,36 @@ static void print_all_data(void) {
 	pr_warn("kbadgerd: END Results of inspection for pid=%d\n", state.pid);
 }
 
+// Returns a new range for the first part of the VMA that isn't covered by any
+// range yet, or NULL if it is all covered. Call it again to find the next
+// part, if any.
 static struct kbadgerd_range *
-kbadgerd_is_new_range(struct rb_root *root, struct vm_area_struct *vma) {
-	struct rb_node *node = root->rb_node;
+kbadgerd_is_new_range(struct rb_root_cached *root, struct vm_area_struct *vma) {
 	struct kbadgerd_range *range;
 	struct kbadgerd_range *new_range;
 	u64 max_start = vma->vm_start;
 	u64 min_end = vma->vm_end;
 
-	while (node) {
-		range = container_of(node, struct kbadgerd_range, range_node);
-
-		// If the vma is the same or entirely in another range, stop.
-		if (max_start >= range->start && min_end <= range->end) {
-			return NULL;
-		}
-
-		// If the vma completely subsumes another range, shorten it to
-		// one side, and we'll get the other side in a future check.
-		if (max_start <= range->start && min_end >= range->end) {
-			max_start = range->end;
-			node = root->rb_node;
-			continue;
-		}
-
-		// If the start of the range is within an old range and the end is outside
-		// of the old range, we may need to create a new range at the end of the old
-		// range. This can happen if the VMA grows up from the end.
-		// If the range keeps growing, there can be multiple ranges between the VMA
-		// start and end, so make sure to get the largest one.
-		if (max_start < range->end && min_end > range->end) {
-			max_start = range->end;
-			node = root->rb_node;
-			continue;
-		}
-		// Same as above, but for if the VMA grows down from the start
-		if (max_start < range->start && min_end > range->start) {
+	// The ranges in the tree don't overlap, so the ones overlapping the
+	// VMA come out in address order, and the first gap between them (or
+	// after them) is what we want.
+	for (range = kbadgerd_range_it_iter_first(root, vma->vm_start,
+						  vma->vm_end - 1);
+	     range;
+	     range = kbadgerd_range_it_iter_next(range, vma->vm_start,
+						 vma->vm_end - 1))
+	{
+		if (range->start > max_start) {
 			min_end = range->start;
-			node = root->rb_node;
-			continue;
+			break;
 		}
 
-		// Traverse the tree
-		if (max_start < range->start)
-			node = node->rb_left;
-		else
-			node = node->rb_right;
+		max_start = max(max_start, range->end);
 	}
 
+	if (max_start >= min_end)
+		return NULL;
+
 	new_range =
 		(struct kbadgerd_range *)vzalloc(sizeof(struct kbadgerd_range));
 
@@ -455,11 +491,11 @@ kbadgerd_is_new_range(struct rb_root *root, struct vm_area_struct *vma) {
 static struct kbadgerd_range *
 kbadgerd_has_holes(
 	struct rb_root_cached *data_root,
-	struct rb_root *old_data_root,
-	struct rb_root *range_root,
+	struct rb_root_cached *old_data_root,
+	struct rb_root_cached *range_root,
 	struct vm_area_struct *vma)
 {
-	struct rb_node *node = range_root->rb_node;
+	struct rb_node *node = range_root->rb_root.rb_node;
 	struct rb_node **nodes_to_remove;
 	struct kbadgerd_range *range;
 	struct kbadgerd_range *first_range = NULL;
@@ -558,7 +594,7 @@ kbadgerd_has_holes(
 		pr_warn("kbadgerd: VMA overlaps range=[%llx, %llx)\n",
 				range->start, range->end);
 
-		rb_erase(&range->range_node, range_root);
+		kbadgerd_range_remove_by_start(range_root, range);
 		// If this range is current range, it has already been removed
 		// from the data tree.
 		if (range != state.current_range) {
@@ -578,26 +614,93 @@ kbadgerd_has_holes(
 	return new_range;
 }
 
-static noinline void check_for_new_vmas(void) {
+/*
+ * Called by mmap, brk, stack growth and mremap with mmap_sem held for each new
+ * or grown VMA of the inspected process. We just note the range here and
+ * look at it in process_vma_events().
+ */
+static void kbadgerd_vma_event(struct mm_struct *mm,
+			       unsigned long start, unsigned long end)
+{
+	int i;
+
+	spin_lock(&state.lock);
+
+	if (mm != state.mm)
+		goto out;
+
+	// Merge with an overlapping or adjacent range, e.g. a growing heap.
+	for (i = 0; i < state.nr_vma_events; i++) {
+		if (start <= state.vma_events[i].end &&
+		    state.vma_events[i].start <= end)
+			goto merge;
+	}
+
+	if (state.nr_vma_events < KBADGERD_MAX_VMA_EVENTS) {
+		state.vma_events[i].start = start;
+		state.vma_events[i].end = end;
+		state.nr_vma_events++;
+		goto out;
+	}
+
+	// Too many ranges, so just cover them all with the first one.
+	for (i = 1; i < state.nr_vma_events; i++) {
+		state.vma_events[0].start = min(state.vma_events[0].start,
+						state.vma_events[i].start);
+		state.vma_events[0].end = max(state.vma_events[0].end,
+					      state.vma_events[i].end);
+	}
+	state.nr_vma_events = 1;
+	i = 0;
+
+merge:
+	state.vma_events[i].start = min(state.vma_events[i].start, (u64)start);
+	state.vma_events[i].end = max(state.vma_events[i].end, (u64)end);
+out:
+	spin_unlock(&state.lock);
+}
+
+/* Add ranges for the parts of the VMAs reported by kbadgerd_vma_event() that
+ * we don't have yet. */
+static noinline void process_vma_events(void) {
 	struct vm_area_struct *vma = NULL;
 	struct kbadgerd_range *range;
+	int i;
+
+	if (!READ_ONCE(state.nr_vma_events))
+		return;
 
 	down_read(&state.mm->mmap_sem);
 	spin_lock(&state.lock);
 
-	for (vma = state.mm->mmap; vma; vma = vma->vm_next) {
-		range = kbadgerd_has_holes(&state.data, &state.old_data,
-			&state.range, vma);
-
-		if (!range)
-			range = kbadgerd_is_new_range(&state.range, vma);
-
-		if (range) {
-			kbadgerd_range_insert_by_weight(&state.data, range);
-			kbadgerd_range_insert_by_start(&state.range, range, false);
+	for (i = 0; i < state.nr_vma_events; i++) {
+		for (vma = find_vma(state.mm, state.vma_events[i].start);
+		     vma && vma->vm_start < state.vma_events[i].end;
+		     vma = vma->vm_next)
+		{
+			// A VMA may cover several holes between our ranges,
+			// so keep going until it is fully covered.
+			for (;;) {
+				range = kbadgerd_has_holes(&state.data,
+					&state.old_data, &state.range, vma);
+
+				if (!range)
+					range = kbadgerd_is_new_range(
+						&state.range, vma);
+
+				if (!range)
+					break;
+
+				kbadgerd_range_insert_by_weight(&state.data,
+								range);
+				kbadgerd_range_insert_by_start(&state.range,
+							       range, false);
+			}
 		}
 	}
 
+	state.nr_vma_events = 0;
+
 	spin_unlock(&state.lock);
 	up_read(&state.mm->mmap_sem);
 }
@@ -624,7 +727,14 @@ static noinline void start_inspection(void) {
 	state.inspected_task = target_task;
 
 	mmgrab(target_task->mm);
+	spin_lock(&state.lock);
 	state.mm = target_task->mm;
+	state.nr_vma_events = 0;
+	spin_unlock(&state.lock);
+
+	// From here on, we hear about new VMAs instead of rescanning for them.
+	// Any reported before the scan below are already covered by it.
+	badger_trap_set_vma_event_fn(state.mm, kbadgerd_vma_event);
 
 	// Collect a list of address ranges. We collect this list rather than
 	// an array of vm_area_struct because there can be calls to mmap
@@ -634,8 +744,8 @@ static noinline void start_inspection(void) {
 	spin_lock(&state.lock);
 
 	state.data = RB_ROOT_CACHED;
-	state.old_data = RB_ROOT;
-	state.range = RB_ROOT;
+	state.old_data = RB_ROOT_CACHED;
+	state.range = RB_ROOT_CACHED;
 
 	state.current_range = NULL;
 
@@ -719,17 +829,18 @@ static noinline void end_inspection(void) {
 		vfree(range);
 	}
 
-	while ((node = rb_first(&state.old_data))) { // NOTE: assignment
+	while ((node = rb_first_cached(&state.old_data))) { // NOTE: assignment
 		range = container_of(node, struct kbadgerd_range, range_node);
-		rb_erase(node, &state.old_data);
+		kbadgerd_range_remove_by_start(&state.old_data, range);
 		vfree(range);
 	}
 
-	state.range = RB_ROOT;
+	state.range = RB_ROOT_CACHED;
 
 	spin_unlock(&state.lock);
 
 	if (state.mm) {
+		badger_trap_set_vma_event_fn(state.mm, NULL);
 		mmdrop(state.mm);
 		state.mm = NULL;
 	}
@@ -761,7 +872,7 @@ static noinline void process_and_insert_current_range(void) {
 	current_range->nsamples += 1;
 
 	// Remove the range from the range rb tree because it might be split
-	rb_erase(&current_range->range_node, &state.range);
+	kbadgerd_range_remove_by_start(&state.range, current_range);
 
 	// If the size of the current range is smaller than the threshold, we
 	// don't try to break it down further. Just insert it back to the tree.
@@ -887,8 +998,6 @@ static noinline void continue_inspection(void) {
 /* The main loop of kbadgerd. */
 static int kbadgerd_do_work(void *data)
 {
-        u32 i = 0;
-
 	while (!kbadgerd_should_stop) {
 		if (state.active && state.pid_changed) {
 			pr_warn("kbadgerd: pid changed. Ending inspection.");
@@ -896,15 +1005,12 @@ static int kbadgerd_do_work(void *data)
 		}
 
 		if (state.active) {
-                        if (i % KBADGERD_NEW_VMA_CHECK_RATE == 0) {
-				check_for_new_vmas();
-                        }
+			process_vma_events();
 			continue_inspection();
 		} else if (state.pid != 0) {
 			start_inspection();
 		}
 
-                i++;
 		pr_warn_once("kbadgerd: Interval is %d ms.\n", state.sleep_interval);
 		msleep(state.sleep_interval);
 	}
@@ -934,7 +1040,7 @@ static u64 tlb_miss_est_fn(const struct mm_action *action)
 {
 	u64 ret = 0;
 	const u64 addr = action->address;
-	struct kbadgerd_range *range = NULL;
+	struct kbadgerd_range *range = NULL, *old_range;
 
 	// Do a quick check before hand. This is racy, but will be true for all
 	// processes that are not being inspected, so we want it to be fast.
@@ -969,7 +1075,9 @@ static u64 tlb_miss_est_fn(const struct mm_action *action)
 
 	// Check old_data if we don't have enough info yet...
 	if (!range || total_misses(&range->totals) == 0) {
-		range = kbadgerd_range_search_by_addr(addr, &state.range, true);
+		old_range = kbadgerd_range_search_by_addr(addr, &state.old_data, true);
+		if (old_range)
+			range = old_range;
 	}
 
 	// If we found a range, compute the number of misses per page and return.
@@ -988,10 +1096,11 @@ static u64 tlb_miss_est_fn(const struct mm_action *action)
 		}
 
 		// Scale up to be in LTU, then divide by number of samples.
-		if (ret > 0) {
-			BUG_ON(range->nsamples == 0);
-			ret = ret * (MM_ECON_LTU / KBADGERD_SLEEP_MS) / range->nsamples;
-		}
+		//
+		// A range moved to old_data while it was being sampled may
+		// have totals but no completed samples, so treat it as one.
+		if (ret > 0)
+			ret = misses_per_ltu(ret, range->nsamples);
 
 		//pr_warn("mm_econ: estimating page benefit: "
 		//	"misses=%llu size=%llu per-page=%llu\n",
@@ -1005,6 +1114,136 @@ static u64 tlb_miss_est_fn(const struct mm_action *action)
 	return ret;
 }
 
+/******************************************************************************/
+/* Export of results while inspection is running. */
+
+// Fill `res` with the data for `range`.
+//
+// NOTE: caller must hold state.lock.
+static void kbadgerd_range_to_result(struct kbadgerd_range *range,
+		u32 flags, struct kbadgerd_result *res)
+{
+	memset(res, 0, sizeof(*res));
+
+	res->start = range->start;
+	res->end = range->end;
+	res->nsamples = range->nsamples;
+	res->dtlb_4kb_load_misses =
+		atomic64_read(&range->totals.total_dtlb_4kb_load_misses);
+	res->dtlb_4kb_store_misses =
+		atomic64_read(&range->totals.total_dtlb_4kb_store_misses);
+	res->dtlb_2mb_load_misses =
+		atomic64_read(&range->totals.total_dtlb_2mb_load_misses);
+	res->dtlb_2mb_store_misses =
+		atomic64_read(&range->totals.total_dtlb_2mb_store_misses);
+	res->dtlb_1gb_load_misses =
+		atomic64_read(&range->totals.total_dtlb_1gb_load_misses);
+	res->dtlb_1gb_store_misses =
+		atomic64_read(&range->totals.total_dtlb_1gb_store_misses);
+
+	res->flags = flags;
+	if (range->explored)
+		res->flags |= KBADGERD_RESULT_EXPLORED;
+	if (range == state.current_range && !state.current_range_removed)
+		res->flags |= KBADGERD_RESULT_CURRENT;
+}
+
+// Call `fn` on every range kbadgerd knows about: first the live ranges
+// (including the current one) in address order, then the old ranges.
+//
+// NOTE: caller must hold state.lock.
+static u32 kbadgerd_for_each_result(
+		void (*fn)(const struct kbadgerd_result *, void *),
+		void *arg)
+{
+	struct kbadgerd_result res;
+	struct rb_node *node;
+	u32 n = 0;
+
+	for (node = rb_first_cached(&state.range); node; node = rb_next(node)) {
+		kbadgerd_range_to_result(
+			container_of(node, struct kbadgerd_range, range_node),
+			0, &res);
+		if (fn)
+			fn(&res, arg);
+		n++;
+	}
+
+	for (node = rb_first_cached(&state.old_data); node; node = rb_next(node)) {
+		kbadgerd_range_to_result(
+			container_of(node, struct kbadgerd_range, range_node),
+			KBADGERD_RESULT_OLD, &res);
+		if (fn)
+			fn(&res, arg);
+		n++;
+	}
+
+	return n;
+}
+
+static void results_write_one(const struct kbadgerd_result *res, void *arg)
+{
+	seq_write(arg, res, sizeof(*res));
+}
+
+// Binary view of the results, at /proc/kbadgerd_results_raw. seq_file
+// generates the whole file on the first read of each open file, so a reader
+// sees one consistent snapshot no matter how many chunks it reads it in.
+static int kbadgerd_results_raw_show(struct seq_file *m, void *v)
+{
+	struct kbadgerd_results_header hdr = {
+		.magic = KBADGERD_RESULTS_MAGIC,
+		.version = KBADGERD_RESULTS_VERSION,
+		.record_size = sizeof(struct kbadgerd_result),
+		.ltu_ms = MM_ECON_LTU,
+	};
+
+	spin_lock(&state.lock);
+
+	hdr.pid = state.active ? state.pid : 0;
+	hdr.nr_records = kbadgerd_for_each_result(NULL, NULL);
+	hdr.sleep_interval_ms = state.sleep_interval;
+	seq_write(m, &hdr, sizeof(hdr));
+	kbadgerd_for_each_result(results_write_one, m);
+
+	spin_unlock(&state.lock);
+
+	return 0;
+}
+
+static struct proc_dir_entry *kbadgerd_results_raw_ent = NULL;
+
+static void results_show_one(const struct kbadgerd_result *res, void *arg)
+{
+	struct seq_file *m = arg;
+
+	seq_printf(m, "%llx %llx %llu %llu %llu %llu %llu %x %llu %llu\n",
+			res->start, res->end, res->nsamples,
+			res->dtlb_4kb_load_misses, res->dtlb_4kb_store_misses,
+			res->dtlb_2mb_load_misses, res->dtlb_2mb_store_misses,
+			res->flags,
+			res->dtlb_1gb_load_misses, res->dtlb_1gb_store_misses);
+}
+
+// Text view of the same data, at /proc/kbadgerd_results.
+static int kbadgerd_results_show(struct seq_file *m, void *v)
+{
+	spin_lock(&state.lock);
+
+	seq_printf(m, "# pid=%d sleep_interval_ms=%u ltu_ms=%u\n",
+			state.active ? state.pid : 0, state.sleep_interval,
+			MM_ECON_LTU);
+	seq_puts(m, "# start end nsamples ld_4kb st_4kb ld_2mb st_2mb flags "
+			"ld_1gb st_1gb\n");
+	kbadgerd_for_each_result(results_show_one, m);
+
+	spin_unlock(&state.lock);
+
+	return 0;
+}
+
+static struct proc_dir_entry *kbadgerd_results_ent = NULL;
+
 /******************************************************************************/
 /* Module init and deinit */
 
@@ -1144,6 +1383,16 @@ static int do_kbadgerd_init(void)
 	if (err)
 		return err;
 
+	kbadgerd_results_ent = proc_create_single("kbadgerd_results", 0444,
+			NULL, kbadgerd_results_show);
+	if (!kbadgerd_results_ent)
+		pr_warn("kbadgerd: unable to create /proc/kbadgerd_results\n");
+
+	kbadgerd_results_raw_ent = proc_create_single("kbadgerd_results_raw",
+			0444, NULL, kbadgerd_results_raw_show);
+	if (!kbadgerd_results_raw_ent)
+		pr_warn("kbadgerd: unable to create /proc/kbadgerd_results_raw\n");
+
 	register_mm_econ_tlb_miss_estimator(tlb_miss_est_fn);
 
 	return 0;
@@ -1164,6 +1413,11 @@ static void do_kbadgerd_exit(void)
 	}
 
 	kbadgerd_exit_sysfs(kbadgerd_kobj);
+
+	if (kbadgerd_results_ent)
+		proc_remove(kbadgerd_results_ent);
+	if (kbadgerd_results_raw_ent)
+		proc_remove(kbadgerd_results_raw_ent);
 }
 
 static void __exit exit_kbadgerd(void)
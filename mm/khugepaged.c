@@ -51,6 +51,41 @@ static unsigned int khugepaged_max_ptes_swap __read_mostly;
 #define MM_SLOTS_HASH_BITS 10
 static __read_mostly DEFINE_HASHTABLE(mm_slots_hash, MM_SLOTS_HASH_BITS);
 
+/*
+ * Asynchronous promotion queue for huge_addr promotions requested from the
+ * page fault handler. Each node has its own queue and work item, which runs
+ * on an unbound workqueue near that node and allocates from it. Requests for
+ * a 2MB region that is already queued are merged.
+ */
+#define PROMOTE_QUEUE_HASH_BITS 8
+#define PROMOTE_QUEUE_MAX_PENDING 4096
+
+struct promote_req {
+	struct list_head list;
+	struct hlist_node hash;
+	struct mm_struct *mm;
+	unsigned long address; /* huge page aligned */
+};
+
+struct promote_queue {
+	spinlock_t lock;
+	struct list_head reqs;
+	DECLARE_HASHTABLE(pending, PROMOTE_QUEUE_HASH_BITS);
+	unsigned int npending;
+	int node;
+	struct work_struct work;
+};
+
+static struct workqueue_struct *promote_wq;
+static struct promote_queue *promote_queues;
+static bool promote_async __read_mostly = true;
+
+static atomic64_t promote_async_queued = ATOMIC64_INIT(0);
+static atomic64_t promote_async_merged = ATOMIC64_INIT(0);
+static atomic64_t promote_async_dropped = ATOMIC64_INIT(0);
+static atomic64_t promote_async_succeeded = ATOMIC64_INIT(0);
+static atomic64_t promote_async_failed = ATOMIC64_INIT(0);
+
 static struct kmem_cache *mm_slot_cache __read_mostly;
 
 #define MAX_PTE_MAPPED_THP 8
@@ -266,6 +301,52 @@ static struct kobj_attribute khugepaged_max_ptes_swap_attr =
 	__ATTR(max_ptes_swap, 0644, khugepaged_max_ptes_swap_show,
 	       khugepaged_max_ptes_swap_store);
 
+/*
+ * promote_async controls whether huge_addr promotions triggered by a page
+ * fault are queued to a per-node worker (1) or done inline in the fault (0).
+ */
+static ssize_t promote_async_show(struct kobject *kobj,
+				  struct kobj_attribute *attr,
+				  char *buf)
+{
+	return sprintf(buf, "%d\n", promote_async);
+}
+
+static ssize_t promote_async_store(struct kobject *kobj,
+				   struct kobj_attribute *attr,
+				   const char *buf, size_t count)
+{
+	bool val;
+	int err;
+
+	err = kstrtobool(buf, &val);
+	if (err)
+		return -EINVAL;
+
+	promote_async = val;
+
+	return count;
+}
+static struct kobj_attribute promote_async_attr =
+	__ATTR(promote_async, 0644, promote_async_show,
+	       promote_async_store);
+
+static ssize_t promote_async_stats_show(struct kobject *kobj,
+					struct kobj_attribute *attr,
+					char *buf)
+{
+	return sprintf(buf,
+		       "queued=%lld\nmerged=%lld\ndropped=%lld\n"
+		       "succeeded=%lld\nfailed=%lld\n",
+		       atomic64_read(&promote_async_queued),
+		       atomic64_read(&promote_async_merged),
+		       atomic64_read(&promote_async_dropped),
+		       atomic64_read(&promote_async_succeeded),
+		       atomic64_read(&promote_async_failed));
+}
+static struct kobj_attribute promote_async_stats_attr =
+	__ATTR_RO(promote_async_stats);
+
 static struct attribute *khugepaged_attr[] = {
 	&khugepaged_defrag_attr.attr,
 	&khugepaged_max_ptes_none_attr.attr,
@@ -275,6 +356,8 @@ static struct attribute *khugepaged_attr[] = {
 	&scan_sleep_millisecs_attr.attr,
 	&alloc_sleep_millisecs_attr.attr,
 	&khugepaged_max_ptes_swap_attr.attr,
+	&promote_async_attr.attr,
+	&promote_async_stats_attr.attr,
 	NULL,
 };
 
@@ -325,6 +408,43 @@ int hugepage_madvise(struct vm_area_struct *vma,
 	return 0;
 }
 
+static void promote_queue_work_fn(struct work_struct *work);
+
+static void __init promote_queue_init(void)
+{
+	struct promote_queue *q;
+	int node;
+
+	promote_wq = alloc_workqueue("khugepaged_promote", WQ_UNBOUND, 0);
+	if (!promote_wq)
+		goto fail;
+
+	promote_queues = kcalloc(nr_node_ids, sizeof(struct promote_queue),
+				 GFP_KERNEL);
+	if (!promote_queues) {
+		destroy_workqueue(promote_wq);
+		promote_wq = NULL;
+		goto fail;
+	}
+
+	for (node = 0; node < nr_node_ids; node++) {
+		q = &promote_queues[node];
+		spin_lock_init(&q->lock);
+		INIT_LIST_HEAD(&q->reqs);
+		hash_init(q->pending);
+		q->npending = 0;
+		q->node = node;
+		INIT_WORK(&q->work, promote_queue_work_fn);
+	}
+
+	return;
+
+fail:
+	// Not fatal: promotions are just done synchronously.
+	pr_warn("khugepaged: unable to set up async promotion queues\n");
+	promote_async = false;
+}
+
 int __init khugepaged_init(void)
 {
 	mm_slot_cache = kmem_cache_create("khugepaged_mm_slot",
@@ -337,12 +457,21 @@ int __init khugepaged_init(void)
 	khugepaged_max_ptes_none = HPAGE_PMD_NR - 1;
 	khugepaged_max_ptes_swap = HPAGE_PMD_NR / 8;
 
+	promote_queue_init();
+
 	return 0;
 }
 
 void __init khugepaged_destroy(void)
 {
 	kmem_cache_destroy(mm_slot_cache);
+
+	if (promote_wq) {
+		destroy_workqueue(promote_wq);
+		promote_wq = NULL;
+	}
+	kfree(promote_queues);
+	promote_queues = NULL;
 }
 
 static inline struct mm_slot *alloc_mm_slot(void)
@@ -619,6 +748,24 @@ static int __collapse_huge_page_isolate(struct vm_area_struct *vma,
 	return 0;
 }
 
+struct collapse_copy_arg {
+	pte_t *pte;
+	struct page *page;
+	struct vm_area_struct *vma;
+};
+
+static void collapse_copy_subpage(unsigned long addr, int idx, void *arg)
+{
+	struct collapse_copy_arg *copy_arg = arg;
+	pte_t pteval = copy_arg->pte[idx];
+
+	if (pte_none(pteval) || is_zero_pfn(pte_pfn(pteval)))
+		clear_user_highpage(copy_arg->page + idx, addr);
+	else
+		copy_user_highpage(copy_arg->page + idx, pte_page(pteval),
+				   addr, copy_arg->vma);
+}
+
 static void __collapse_huge_page_copy(pte_t *pte, struct page *page,
 				      struct vm_area_struct *vma,
 				      unsigned long address,
@@ -627,6 +774,21 @@ static void __collapse_huge_page_copy(pte_t *pte, struct page *page,
 {
 	u64 start = rdtsc();
 	pte_t *_pte;
+	bool copied = false;
+	struct collapse_copy_arg copy_arg = {
+		.pte = pte,
+		.page = page,
+		.vma = vma,
+	};
+
+	// Try to do the clearing/copying with multiple threads first, then
+	// fix up the page tables and release the old pages below. The helpers
+	// need to read the ptes, so this can't work if they are kmapped.
+	if (!IS_ENABLED(CONFIG_HIGHPTE))
+		copied = process_huge_page_mt(address, HPAGE_PMD_NR,
+					      collapse_copy_subpage, &copy_arg,
+					      page_to_nid(page));
+
 	for (_pte = pte; _pte < pte + HPAGE_PMD_NR;
 				_pte++, page++, address += PAGE_SIZE) {
 		pte_t pteval = *_pte;
@@ -634,7 +796,8 @@ static void __collapse_huge_page_copy(pte_t *pte, struct page *page,
 
 		if (pte_none(pteval) || is_zero_pfn(pte_pfn(pteval))) {
 			mm_stats_set_flag(pftrace, MM_STATS_PF_CLEARED_MEM);
-			clear_user_highpage(page, address);
+			if (!copied)
+				clear_user_highpage(page, address);
 			add_mm_counter(vma->vm_mm, MM_ANONPAGES, 1);
 			if (is_zero_pfn(pte_pfn(pteval))) {
 				/*
@@ -651,7 +814,8 @@ static void __collapse_huge_page_copy(pte_t *pte, struct page *page,
 		} else {
 			mm_stats_set_flag(pftrace, MM_STATS_PF_HUGE_COPY);
 			src_page = pte_page(pteval);
-			copy_user_highpage(page, src_page, address, vma);
+			if (!copied)
+				copy_user_highpage(page, src_page, address, vma);
 			VM_BUG_ON_PAGE(page_mapcount(src_page) != 1, src_page);
 			release_pte_page(src_page);
 			/*
@@ -1266,10 +1430,16 @@ static int khugepaged_scan_pmd(struct mm_struct *mm,
 		mm_action.action = MM_ACTION_PROMOTE_HUGE;
 		mm_action.huge_page_order = HPAGE_PMD_ORDER;
 		mm_estimate_changes(&mm_action, &mm_cost_delta);
-		should_do = mm_decide(&mm_cost_delta);
+		should_do = mm_decide(&mm_action, &mm_cost_delta);
 
 		if (should_do) {
+			// Go where most of the base pages are, unless the
+			// estimator finds a better node near there (e.g.,
+			// one that actually has free huge pages).
 			node = khugepaged_find_target_node();
+			if (mm_econ_is_on())
+				node = mm_econ_huge_page_node(mm, vma,
+						address, node);
 			/* collapse_huge_page will return with the mmap_sem released */
 			collapse_huge_page(mm, address, hpage, node, referenced,
 					/* force */ false, &pftrace);
@@ -1331,6 +1501,147 @@ promote_to_huge(struct mm_struct *mm,
 	return result;
 }
 
+static inline unsigned long promote_req_key(struct mm_struct *mm,
+					    unsigned long address)
+{
+	return (unsigned long)mm ^ address;
+}
+
+/*
+ * Queue a promotion of the huge page at `address` (which must be huge page
+ * aligned) in `mm` to the worker of the current node. Returns false if the
+ * caller should do the promotion synchronously instead (i.e. async
+ * promotion is off or the request could not be allocated).
+ *
+ * Requests for a region that is already queued are merged. If the queue is
+ * full, the request is dropped; a later fault in the same region will queue
+ * it again.
+ */
+bool promote_to_huge_async(struct mm_struct *mm, unsigned long address)
+{
+	const unsigned long key = promote_req_key(mm, address);
+	struct promote_queue *q;
+	struct promote_req *req, *new_req;
+	unsigned long flags;
+
+	VM_BUG_ON(address & ~HPAGE_PMD_MASK);
+
+	if (!READ_ONCE(promote_async) || !promote_queues)
+		return false;
+
+	q = &promote_queues[numa_node_id()];
+
+	new_req = kmalloc(sizeof(*new_req), GFP_KERNEL);
+	if (!new_req)
+		return false;
+
+	spin_lock_irqsave(&q->lock, flags);
+
+	hash_for_each_possible(q->pending, req, hash, key) {
+		if (req->mm == mm && req->address == address) {
+			spin_unlock_irqrestore(&q->lock, flags);
+			kfree(new_req);
+			atomic64_inc(&promote_async_merged);
+			return true;
+		}
+	}
+
+	if (q->npending >= PROMOTE_QUEUE_MAX_PENDING) {
+		spin_unlock_irqrestore(&q->lock, flags);
+		kfree(new_req);
+		atomic64_inc(&promote_async_dropped);
+		return true;
+	}
+
+	// Keep the mm_struct around until the worker is done with it. The
+	// worker only does the promotion if the address space is still alive.
+	mmgrab(mm);
+	new_req->mm = mm;
+	new_req->address = address;
+	list_add_tail(&new_req->list, &q->reqs);
+	hash_add(q->pending, &new_req->hash, key);
+	q->npending++;
+
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	atomic64_inc(&promote_async_queued);
+	queue_work_node(q->node, promote_wq, &q->work);
+
+	return true;
+}
+
+static void promote_queue_do_one(struct promote_queue *q,
+				 struct promote_req *req)
+{
+	struct mm_struct *mm = req->mm;
+	struct vm_area_struct *vma;
+	struct page *hpage = NULL;
+	struct mm_stats_pftrace pftrace; // not part of any #PF
+	int result = SCAN_ANY_PROCESS;
+
+	mm_stats_pftrace_init(&pftrace);
+
+	if (!mmget_not_zero(mm))
+		goto out;
+
+	down_read(&mm->mmap_sem);
+
+	// Linux doesn't support huge pages for file-backed memory.
+	vma = find_vma(mm, req->address);
+	if (!vma || vma->vm_start > req->address || vma->vm_file) {
+		up_read(&mm->mmap_sem);
+		result = SCAN_VMA_CHECK;
+		goto out_mmput;
+	}
+
+	down_read(&mm->badger_trap_page_table_sem);
+
+	// Releases mmap_sem and badger_trap_page_table_sem.
+	result = collapse_huge_page(mm, req->address, &hpage, q->node, 512,
+			/* force */ true, &pftrace);
+
+	if (!IS_ERR_OR_NULL(hpage))
+		put_page(hpage);
+
+out_mmput:
+	mmput(mm);
+out:
+	if (result == SCAN_SUCCEED) {
+		atomic64_inc(&promote_async_succeeded);
+		mm_register_promotion(mm, req->address);
+	} else {
+		atomic64_inc(&promote_async_failed);
+	}
+}
+
+static void promote_queue_work_fn(struct work_struct *work)
+{
+	struct promote_queue *q = container_of(work, struct promote_queue, work);
+	struct promote_req *req;
+	unsigned long flags;
+
+	while (true) {
+		spin_lock_irqsave(&q->lock, flags);
+		req = list_first_entry_or_null(&q->reqs, struct promote_req, list);
+		if (req) {
+			list_del(&req->list);
+			hash_del(&req->hash);
+			q->npending--;
+		}
+		spin_unlock_irqrestore(&q->lock, flags);
+
+		if (!req)
+			break;
+
+		promote_queue_do_one(q, req);
+
+		mmdrop(req->mm);
+		kfree(req);
+
+		cond_resched();
+	}
+}
+
 static void collect_mm_slot(struct mm_slot *mm_slot)
 {
 	struct mm_struct *mm = mm_slot->mm;
@@ -1932,6 +2243,8 @@ static void khugepaged_scan_file(struct mm_struct *mm,
 	int present, swap;
 	int node = NUMA_NO_NODE;
 	int result = SCAN_SUCCEED;
+	struct mm_cost_delta mm_cost_delta;
+	struct mm_action mm_action;
 
 	present = 0;
 	swap = 0;
@@ -1991,8 +2304,24 @@ static void khugepaged_scan_file(struct mm_struct *mm,
 		if (present < HPAGE_PMD_NR - khugepaged_max_ptes_none) {
 			result = SCAN_EXCEED_NONE_PTE;
 		} else {
-			node = khugepaged_find_target_node();
-			collapse_file(mm, file, start, hpage, node);
+			// Run the estimator to check if this part of the page
+			// cache should be huge. The file's profile is keyed on
+			// offsets, so pass the inode and the offset.
+			mm_action.address = (u64)start << PAGE_SHIFT;
+			mm_action.action = MM_ACTION_PROMOTE_HUGE_FILE;
+			mm_action.huge_page_order = HPAGE_PMD_ORDER;
+			mm_action.inode = file_inode(file);
+			mm_estimate_changes(&mm_action, &mm_cost_delta);
+
+			if (mm_decide(&mm_action, &mm_cost_delta)) {
+				node = khugepaged_find_target_node();
+				if (mm_econ_is_on())
+					node = mm_econ_huge_page_node(mm,
+							NULL, 0, node);
+				collapse_file(mm, file, start, hpage, node);
+			} else {
+				result = SCAN_MM_ECON_CANCEL;
+			}
 		}
 	}
 
@@ -2157,7 +2486,7 @@ static int khugepaged_wait_event(void)
     };
     bool should_run;
     mm_estimate_changes(&mm_action, &mm_cost_delta);
-    should_run = mm_decide(&mm_cost_delta);
+    should_run = mm_decide(&mm_action, &mm_cost_delta);
 
 	return should_run &&
         (!list_empty(&khugepaged_scan.mm_head) ||
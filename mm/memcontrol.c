@@ -4629,6 +4629,96 @@ static ssize_t memcg_write_event_control(struct kernfs_open_file *of,
 	return ret;
 }
 
+#ifdef CONFIG_MM_ECON
+static int memory_econ_mode_show(struct seq_file *m, void *v)
+{
+	int mode = READ_ONCE(mem_cgroup_from_seq(m)->econ.mode);
+
+	if (mode == MEMCG_ECON_INHERIT)
+		seq_puts(m, "inherit\n");
+	else
+		seq_printf(m, "%d\n", mode);
+
+	return 0;
+}
+
+static ssize_t memory_econ_mode_write(struct kernfs_open_file *of,
+				      char *buf, size_t nbytes, loff_t off)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(of_css(of));
+	int ret, mode;
+
+	buf = strstrip(buf);
+	if (!strcmp(buf, "inherit")) {
+		mode = MEMCG_ECON_INHERIT;
+	} else {
+		ret = kstrtoint(buf, 0, &mode);
+		if (ret)
+			return ret;
+
+		if (mode != MEMCG_ECON_OFF && mode != MEMCG_ECON_ON &&
+		    mode != MEMCG_ECON_BUDGETED)
+			return -EINVAL;
+	}
+
+	WRITE_ONCE(memcg->econ.mode, mode);
+
+	return nbytes;
+}
+
+static int memory_econ_budget_show(struct seq_file *m, void *v)
+{
+	u64 budget = READ_ONCE(mem_cgroup_from_seq(m)->econ.budget);
+
+	if (budget == U64_MAX)
+		seq_puts(m, "max\n");
+	else
+		seq_printf(m, "%llu\n", budget);
+
+	return 0;
+}
+
+static ssize_t memory_econ_budget_write(struct kernfs_open_file *of,
+					char *buf, size_t nbytes, loff_t off)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(of_css(of));
+	u64 budget;
+	int ret;
+
+	buf = strstrip(buf);
+	if (!strcmp(buf, "max")) {
+		budget = U64_MAX;
+	} else {
+		ret = kstrtou64(buf, 0, &budget);
+		if (ret)
+			return ret;
+	}
+
+	WRITE_ONCE(memcg->econ.budget, budget);
+
+	return nbytes;
+}
+
+static int memory_econ_stat_show(struct seq_file *m, void *v)
+{
+	struct memcg_econ *econ = &mem_cgroup_from_seq(m)->econ;
+
+	seq_printf(m, "decisions %lld\n", atomic64_read(&econ->decisions));
+	seq_printf(m, "decisions_yes %lld\n",
+		   atomic64_read(&econ->decisions_yes));
+	seq_printf(m, "decisions_over_budget %lld\n",
+		   atomic64_read(&econ->decisions_over_budget));
+	seq_printf(m, "cost_charged %lld\n",
+		   atomic64_read(&econ->cost_charged));
+	seq_printf(m, "ltu_spent %lld\n", atomic64_read(&econ->ltu_spent));
+	seq_printf(m, "hp_promotions %lld\n",
+		   atomic64_read(&econ->hp_promotions));
+	seq_printf(m, "eager_bytes %lld\n", atomic64_read(&econ->eager_bytes));
+
+	return 0;
+}
+#endif /* CONFIG_MM_ECON */
+
 static struct cftype mem_cgroup_legacy_files[] = {
 	{
 		.name = "usage_in_bytes",
@@ -4696,6 +4786,25 @@ static struct cftype mem_cgroup_legacy_files[] = {
 	{
 		.name = "pressure_level",
 	},
+#ifdef CONFIG_MM_ECON
+	{
+		.name = "econ.mode",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = memory_econ_mode_show,
+		.write = memory_econ_mode_write,
+	},
+	{
+		.name = "econ.budget",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = memory_econ_budget_show,
+		.write = memory_econ_budget_write,
+	},
+	{
+		.name = "econ.stat",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = memory_econ_stat_show,
+	},
+#endif
 #ifdef CONFIG_NUMA
 	{
 		.name = "numa_stat",
@@ -4979,6 +5088,11 @@ mem_cgroup_css_alloc(struct cgroup_subsys_state *parent_css)
 
 	memcg->high = PAGE_COUNTER_MAX;
 	memcg->soft_limit = PAGE_COUNTER_MAX;
+#ifdef CONFIG_MM_ECON
+	memcg->econ.mode = MEMCG_ECON_INHERIT;
+	memcg->econ.budget = U64_MAX;
+	memcg->econ.ltu_start = jiffies;
+#endif
 	if (parent) {
 		memcg->swappiness = mem_cgroup_swappiness(parent);
 		memcg->oom_kill_disable = parent->oom_kill_disable;
@@ -6150,6 +6264,25 @@ static struct cftype memory_files[] = {
 		.seq_show = memory_oom_group_show,
 		.write = memory_oom_group_write,
 	},
+#ifdef CONFIG_MM_ECON
+	{
+		.name = "econ.mode",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = memory_econ_mode_show,
+		.write = memory_econ_mode_write,
+	},
+	{
+		.name = "econ.budget",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = memory_econ_budget_show,
+		.write = memory_econ_budget_write,
+	},
+	{
+		.name = "econ.stat",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = memory_econ_stat_show,
+	},
+#endif
 	{ }	/* terminate */
 };
 
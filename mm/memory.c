@@ -76,6 +76,10 @@
 #include <linux/proc_fs.h>
 #include <linux/memory.h>
 #include <linux/badger_trap.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
 
 #include <trace/events/kmem.h>
 
@@ -4047,10 +4051,11 @@ static vm_fault_t do_numa_page(struct vm_fault *vmf)
 
 static inline vm_fault_t create_huge_pmd(struct vm_fault *vmf,
 					 struct mm_stats_pftrace *pftrace,
-					 bool require_prezeroed)
+					 bool require_prezeroed, int nid)
 {
 	if (vma_is_anonymous(vmf->vma))
-		return do_huge_pmd_anonymous_page(vmf, pftrace, require_prezeroed);
+		return do_huge_pmd_anonymous_page(vmf, pftrace,
+						  require_prezeroed, nid);
 	if (vmf->vma->vm_ops->huge_fault)
 		return vmf->vma->vm_ops->huge_fault(vmf, PE_SIZE_PMD);
 	return VM_FAULT_FALLBACK;
@@ -4156,14 +4161,12 @@ static int do_fake_page_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	else
 	    atomic64_inc(&mm->bt_stats->total_dtlb_4kb_load_misses);
 
-	/*
-	if (vma) {
+	if (vma && vma->bt_stats) {
 	    if (flags & FAULT_FLAG_WRITE)
-		vma->bt_stats.total_dtlb_4kb_store_misses++;
+		atomic64_inc(&vma->bt_stats->stats.total_dtlb_4kb_store_misses);
 	    else
-		vma->bt_stats.total_dtlb_4kb_load_misses++;
+		atomic64_inc(&vma->bt_stats->stats.total_dtlb_4kb_load_misses);
 	}
-	*/
 
 	pte_offset_map_lock(mm, pmd, address, &ptl);
 	*page_table = pte_mkreserve(*page_table);
@@ -4414,19 +4417,77 @@ static int transparent_fake_fault(struct vm_fault *vmf)
 	else
 	    atomic64_inc(&vmf->vma->vm_mm->bt_stats->total_dtlb_2mb_load_misses);
 
-	/*
-	if (vmf->vma) {
+	if (vmf->vma->bt_stats) {
 	    if (vmf->flags & FAULT_FLAG_WRITE)
-		vmf->vma->bt_stats.total_dtlb_2mb_store_misses++;
+		atomic64_inc(&vmf->vma->bt_stats->stats.total_dtlb_2mb_store_misses);
 	    else
-		vmf->vma->bt_stats.total_dtlb_2mb_load_misses++;
+		atomic64_inc(&vmf->vma->bt_stats->stats.total_dtlb_2mb_load_misses);
 	}
-	*/
 
         *vmf->pmd = pmd_mkreserve(*vmf->pmd);
         return 0;
 }
 
+/*
+ * Same as transparent_fake_fault, but for a 1GB page mapped by a pud. orig_pud
+ * is the value of the pud that was read without the lock.
+ */
+static int transparent_1gb_fake_fault(struct vm_fault *vmf, pud_t orig_pud)
+{
+	struct mm_struct *mm = vmf->vma->vm_mm;
+	unsigned long *touch_page_addr;
+	unsigned long touched;
+	unsigned long ret;
+	spinlock_t *ptl;
+	pud_t entry;
+
+	// If the pud changed under us (e.g. it was split or zapped), just let
+	// the access fault again.
+	ptl = pud_lock(mm, vmf->pud);
+	if (unlikely(!pud_same(*vmf->pud, orig_pud))) {
+		spin_unlock(ptl);
+		return 0;
+	}
+
+	entry = orig_pud;
+	if (vmf->flags & FAULT_FLAG_WRITE)
+		entry = pud_mkdirty(entry);
+	entry = pud_mkyoung(entry);
+	entry = pud_unreserve(entry);
+	*vmf->pud = entry;
+	spin_unlock(ptl);
+
+	touch_page_addr = (void *)(vmf->address & PAGE_MASK);
+	ret = copy_from_user(&touched,
+		(__force const void __user *)touch_page_addr,
+		sizeof(unsigned long));
+
+	if (ret)
+		return VM_FAULT_SIGBUS;
+
+	/* Here where we do all our analysis */
+	if (vmf->flags & FAULT_FLAG_WRITE)
+	    atomic64_inc(&vmf->vma->vm_mm->bt_stats->total_dtlb_1gb_store_misses);
+	else
+	    atomic64_inc(&vmf->vma->vm_mm->bt_stats->total_dtlb_1gb_load_misses);
+
+	if (vmf->vma->bt_stats) {
+	    if (vmf->flags & FAULT_FLAG_WRITE)
+		atomic64_inc(&vmf->vma->bt_stats->stats.total_dtlb_1gb_store_misses);
+	    else
+		atomic64_inc(&vmf->vma->bt_stats->stats.total_dtlb_1gb_load_misses);
+	}
+
+	// Re-arm the trap, unless the pud no longer maps the same page. The
+	// hardware may have set the dirty bit meanwhile, so don't use pud_same.
+	ptl = pud_lock(mm, vmf->pud);
+	if (pud_present(*vmf->pud) && pud_pfn(*vmf->pud) == pud_pfn(entry))
+		*vmf->pud = pud_mkreserve(*vmf->pud);
+	spin_unlock(ptl);
+
+	return 0;
+}
+
 /*
  * By the time we get here, we already hold the mm semaphore
  *
@@ -4463,9 +4524,12 @@ static vm_fault_t __handle_mm_fault(struct vm_area_struct *vma,
 
 	vmf.pud = pud_offset(p4d, address);
 
-	/* Check for transparent 1GB huge pages that are marked reserved. */
+	/*
+	 * Check for transparent 1GB huge pages that are marked reserved. Linux
+	 * only has these for DAX, so they are also pud_devmap.
+	 */
 	if (mm && mm->badger_trap_was_enabled && !(vmf.flags & FAULT_FLAG_INSTRUCTION)
-		&& vmf.pud && pud_trans_huge(*vmf.pud))
+		&& vmf.pud && (pud_trans_huge(*vmf.pud) || pud_devmap(*vmf.pud)))
 	{
 	    pud_t orig_pud = *vmf.pud;
 
@@ -4474,10 +4538,24 @@ static vm_fault_t __handle_mm_fault(struct vm_area_struct *vma,
 	    {
 		mm_stats_set_flag(pftrace, MM_STATS_PF_VERY_HUGE_PAGE);
 		mm_stats_set_flag(pftrace, MM_STATS_PF_WP);
-		// NOTE: This is pseudocode... Linux doesn't support
-		// transparent 1GB huge pages yet...
-		//
-		// return do_huge_pud_wp_page();
+
+		// As for ptes, we don't want wp_huge_pud to see the magical
+		// reserved bit, so put it back afterwards.
+		ptl = pud_lock(mm, vmf.pud);
+		*vmf.pud = pud_unreserve(*vmf.pud);
+		orig_pud = *vmf.pud;
+		spin_unlock(ptl);
+
+		ret = wp_huge_pud(&vmf, orig_pud);
+
+		ptl = pud_lock(mm, vmf.pud);
+		if (pud_present(*vmf.pud)
+			&& (pud_trans_huge(*vmf.pud) || pud_devmap(*vmf.pud)))
+		    *vmf.pud = pud_mkreserve(*vmf.pud);
+		spin_unlock(ptl);
+
+		if (!(ret & VM_FAULT_FALLBACK))
+		    return ret;
 		goto escape_pud;
 	    }
 
@@ -4485,12 +4563,8 @@ static vm_fault_t __handle_mm_fault(struct vm_area_struct *vma,
 	    {
 		mm_stats_set_flag(pftrace, MM_STATS_PF_VERY_HUGE_PAGE);
 		mm_stats_set_flag(pftrace, MM_STATS_PF_BADGER_TRAP);
-		// NOTE: This is pseudocode... Linux doesn't support
-		// transparent 1GB huge pages yet...
-		//
-		// ret = transparent_1gb_fake_fault();
-		// return ret;
-		goto escape_pud;
+		ret = transparent_1gb_fake_fault(&vmf, orig_pud);
+		return ret;
 	    }
 
 	    ptl = pud_lock(mm, vmf.pud);
@@ -4498,7 +4572,7 @@ static vm_fault_t __handle_mm_fault(struct vm_area_struct *vma,
 	    if (pud_present(*vmf.pud)
 		    && is_badger_trap_enabled(vmf.vma->vm_mm, vmf.address))
 	    {
-		// *vmf.pud = pud_mkreserve(*vmf.pud); // TODO markm uncomment
+		*vmf.pud = pud_mkreserve(*vmf.pud);
 	    } else if (pud_present(*vmf.pud))
 	    {
 		*vmf.pud = pud_unreserve(*vmf.pud);
@@ -4520,7 +4594,7 @@ static vm_fault_t __handle_mm_fault(struct vm_area_struct *vma,
 		mm_action.action = MM_ACTION_PROMOTE_HUGE;
 		mm_action.huge_page_order = HPAGE_PUD_SHIFT-PAGE_SHIFT;
 		mm_estimate_changes(&mm_action, &mm_cost_delta);
-		should_do = mm_decide(&mm_cost_delta);
+		should_do = mm_decide(&mm_action, &mm_cost_delta);
 
 		if (should_do) {
 			ret = create_huge_pud(&vmf);
@@ -4605,10 +4679,13 @@ static vm_fault_t __handle_mm_fault(struct vm_area_struct *vma,
 		mm_action.action = MM_ACTION_PROMOTE_HUGE;
 		mm_action.huge_page_order = HPAGE_PMD_ORDER;
 		mm_estimate_changes(&mm_action, &mm_cost_delta);
-		should_do = mm_decide(&mm_cost_delta);
+		should_do = mm_decide(&mm_action, &mm_cost_delta);
 
 		if (should_do) {
-			ret = create_huge_pmd(&vmf, pftrace, mm_cost_delta.extra);
+			// Allocate from the node the estimator picked, if any.
+			ret = create_huge_pmd(&vmf, pftrace, mm_cost_delta.extra,
+					mm_econ_is_on() ? mm_cost_delta.nid
+							: NUMA_NO_NODE);
 			if (!(ret & VM_FAULT_FALLBACK))
 				return ret;
 		}
@@ -5204,6 +5281,299 @@ static inline void process_huge_page(
 	mm_stats_hist_measure(&mm_process_huge_page_cycles, rdtsc() - start);
 }
 
+/*
+ * Multi-threaded clearing/copying of huge pages.
+ *
+ * When enabled, a huge page with at least huge_page_mt_min_pages subpages is
+ * split into equal chunks. The chunks are handed to idle CPUs on the node of
+ * the huge page, while the calling thread does the chunk containing the
+ * target subpage (target subpage last, as in process_huge_page()). The caller
+ * then takes back any chunk that no worker has started yet and does it
+ * itself, so a fault never waits on a worker that can't get a thread (e.g.
+ * under memory pressure), only on chunks that are already being processed.
+ *
+ * Off by default. Compare mm_process_huge_page_mt_cycles against
+ * mm_process_huge_page_cycles to decide whether it wins on a given machine,
+ * and tune the threshold accordingly.
+ */
+#define HUGE_PAGE_MT_MAX_THREADS 16
+
+static bool huge_page_mt_enabled __read_mostly = false;
+// 2MB by default, so that smaller compound pages never go multi-threaded.
+static unsigned int huge_page_mt_min_pages __read_mostly =
+	1 << (PMD_SHIFT - PAGE_SHIFT);
+// Including the calling thread.
+static unsigned int huge_page_mt_threads __read_mostly = 4;
+
+static struct workqueue_struct *huge_page_mt_wq;
+
+static atomic64_t huge_page_mt_count = ATOMIC64_INIT(0);
+static atomic64_t huge_page_mt_no_idle = ATOMIC64_INIT(0);
+static atomic64_t huge_page_mt_helpers = ATOMIC64_INIT(0);
+static atomic64_t huge_page_mt_inline = ATOMIC64_INIT(0);
+
+struct huge_page_mt_chunk {
+	struct work_struct work;
+	void (*process_subpage)(unsigned long addr, int idx, void *arg);
+	void *arg;
+	unsigned long addr; // start of the huge page
+	unsigned int start, end; // subpage indices [start, end)
+};
+
+static void huge_page_mt_do_chunk(struct huge_page_mt_chunk *chunk)
+{
+	unsigned int i;
+
+	for (i = chunk->start; i < chunk->end; i++) {
+		cond_resched();
+		chunk->process_subpage(chunk->addr + i * PAGE_SIZE, i,
+				       chunk->arg);
+	}
+}
+
+static void huge_page_mt_work_fn(struct work_struct *work)
+{
+	huge_page_mt_do_chunk(
+		container_of(work, struct huge_page_mt_chunk, work));
+}
+
+/*
+ * Process all subpages of the specified huge page with the specified
+ * operation, using idle CPUs on node `nid` to help.
+ *
+ * Returns true if the huge page was processed. Returns false (and does
+ * nothing) if multi-threading is disabled, the page is below the threshold,
+ * or there are no idle CPUs; the caller should then process the huge page
+ * itself.
+ */
+bool process_huge_page_mt(
+	unsigned long addr_hint, unsigned int pages_per_huge_page,
+	void (*process_subpage)(unsigned long addr, int idx, void *arg),
+	void *arg, int nid)
+{
+	struct huge_page_mt_chunk chunks[HUGE_PAGE_MT_MAX_THREADS];
+	int cpus[HUGE_PAGE_MT_MAX_THREADS];
+	unsigned long addr = addr_hint &
+		~(((unsigned long)pages_per_huge_page << PAGE_SHIFT) - 1);
+	unsigned int nthreads, max_threads, per_chunk, target, local;
+	unsigned int i, h, start_idx, end_idx;
+	int cpu, this_cpu;
+	u64 start;
+
+	if (!READ_ONCE(huge_page_mt_enabled) || !huge_page_mt_wq)
+		return false;
+	if (pages_per_huge_page < READ_ONCE(huge_page_mt_min_pages))
+		return false;
+
+	max_threads = min_t(unsigned int, READ_ONCE(huge_page_mt_threads),
+			    HUGE_PAGE_MT_MAX_THREADS);
+	if (max_threads < 2)
+		return false;
+
+	might_sleep();
+	start = rdtsc();
+
+	if (nid == NUMA_NO_NODE)
+		nid = numa_node_id();
+
+	// Pick helpers among the idle CPUs of the node. This is racy, but it
+	// only has to be a good guess.
+	nthreads = 1;
+	this_cpu = get_cpu();
+	for_each_cpu_and(cpu, cpumask_of_node(nid), cpu_online_mask) {
+		if (nthreads >= max_threads)
+			break;
+		if (cpu == this_cpu || !idle_cpu(cpu))
+			continue;
+		cpus[nthreads++] = cpu;
+	}
+	put_cpu();
+
+	if (nthreads < 2) {
+		atomic64_inc(&huge_page_mt_no_idle);
+		return false;
+	}
+
+	per_chunk = DIV_ROUND_UP(pages_per_huge_page, nthreads);
+	target = (addr_hint - addr) / PAGE_SIZE;
+	local = target / per_chunk;
+
+	// Hand out every chunk except the one with the target subpage.
+	for (i = 0, h = 1; i < nthreads; i++) {
+		if (i == local)
+			continue;
+
+		start_idx = i * per_chunk;
+		end_idx = min(start_idx + per_chunk, pages_per_huge_page);
+		if (start_idx >= end_idx)
+			continue;
+
+		chunks[h].process_subpage = process_subpage;
+		chunks[h].arg = arg;
+		chunks[h].addr = addr;
+		chunks[h].start = start_idx;
+		chunks[h].end = end_idx;
+		INIT_WORK_ONSTACK(&chunks[h].work, huge_page_mt_work_fn);
+
+		queue_work_on(cpus[h], huge_page_mt_wq, &chunks[h].work);
+		h++;
+	}
+
+	// Our own chunk, target subpage last to keep its cache lines hot.
+	start_idx = local * per_chunk;
+	end_idx = min(start_idx + per_chunk, pages_per_huge_page);
+	for (i = start_idx; i < end_idx; i++) {
+		if (i == target)
+			continue;
+		cond_resched();
+		process_subpage(addr + i * PAGE_SIZE, i, arg);
+	}
+	process_subpage(addr + target * PAGE_SIZE, target, arg);
+
+	// Wait for the chunks that a worker has picked up, and do the rest
+	// ourselves rather than waiting for a worker to become available.
+	while (--h > 0) {
+		if (cancel_work_sync(&chunks[h].work)) {
+			huge_page_mt_do_chunk(&chunks[h]);
+			atomic64_inc(&huge_page_mt_inline);
+		} else {
+			atomic64_inc(&huge_page_mt_helpers);
+		}
+		destroy_work_on_stack(&chunks[h].work);
+	}
+
+	atomic64_inc(&huge_page_mt_count);
+	mm_stats_hist_measure(&mm_process_huge_page_mt_cycles, rdtsc() - start);
+
+	return true;
+}
+
+static ssize_t huge_page_mt_enabled_show(struct kobject *kobj,
+					 struct kobj_attribute *attr,
+					 char *buf)
+{
+	return sprintf(buf, "%d\n", huge_page_mt_enabled);
+}
+
+static ssize_t huge_page_mt_enabled_store(struct kobject *kobj,
+					  struct kobj_attribute *attr,
+					  const char *buf, size_t count)
+{
+	bool val;
+
+	if (kstrtobool(buf, &val))
+		return -EINVAL;
+
+	huge_page_mt_enabled = val;
+
+	return count;
+}
+static struct kobj_attribute huge_page_mt_enabled_attr =
+	__ATTR(enabled, 0644, huge_page_mt_enabled_show,
+	       huge_page_mt_enabled_store);
+
+static ssize_t huge_page_mt_min_pages_show(struct kobject *kobj,
+					   struct kobj_attribute *attr,
+					   char *buf)
+{
+	return sprintf(buf, "%u\n", huge_page_mt_min_pages);
+}
+
+static ssize_t huge_page_mt_min_pages_store(struct kobject *kobj,
+					    struct kobj_attribute *attr,
+					    const char *buf, size_t count)
+{
+	unsigned int val;
+
+	if (kstrtouint(buf, 0, &val) || val < HUGE_PAGE_MT_MAX_THREADS)
+		return -EINVAL;
+
+	huge_page_mt_min_pages = val;
+
+	return count;
+}
+static struct kobj_attribute huge_page_mt_min_pages_attr =
+	__ATTR(min_pages, 0644, huge_page_mt_min_pages_show,
+	       huge_page_mt_min_pages_store);
+
+static ssize_t huge_page_mt_threads_show(struct kobject *kobj,
+					 struct kobj_attribute *attr,
+					 char *buf)
+{
+	return sprintf(buf, "%u\n", huge_page_mt_threads);
+}
+
+static ssize_t huge_page_mt_threads_store(struct kobject *kobj,
+					  struct kobj_attribute *attr,
+					  const char *buf, size_t count)
+{
+	unsigned int val;
+
+	if (kstrtouint(buf, 0, &val) || val < 1
+		|| val > HUGE_PAGE_MT_MAX_THREADS)
+		return -EINVAL;
+
+	huge_page_mt_threads = val;
+
+	return count;
+}
+static struct kobj_attribute huge_page_mt_threads_attr =
+	__ATTR(threads, 0644, huge_page_mt_threads_show,
+	       huge_page_mt_threads_store);
+
+static ssize_t huge_page_mt_stats_show(struct kobject *kobj,
+				       struct kobj_attribute *attr,
+				       char *buf)
+{
+	return sprintf(buf, "count=%lld\nno_idle=%lld\nhelpers=%lld\n"
+		       "inline=%lld\n",
+		       atomic64_read(&huge_page_mt_count),
+		       atomic64_read(&huge_page_mt_no_idle),
+		       atomic64_read(&huge_page_mt_helpers),
+		       atomic64_read(&huge_page_mt_inline));
+}
+static struct kobj_attribute huge_page_mt_stats_attr =
+	__ATTR(stats, 0444, huge_page_mt_stats_show, NULL);
+
+static struct attribute *huge_page_mt_attr[] = {
+	&huge_page_mt_enabled_attr.attr,
+	&huge_page_mt_min_pages_attr.attr,
+	&huge_page_mt_threads_attr.attr,
+	&huge_page_mt_stats_attr.attr,
+	NULL,
+};
+
+static const struct attribute_group huge_page_mt_attr_group = {
+	.attrs = huge_page_mt_attr,
+};
+
+static int __init huge_page_mt_init(void)
+{
+	struct kobject *kobj;
+	int err;
+
+	huge_page_mt_wq = alloc_workqueue("huge_page_mt",
+					 WQ_HIGHPRI | WQ_MEM_RECLAIM, 0);
+	if (!huge_page_mt_wq)
+		return -ENOMEM;
+
+	kobj = kobject_create_and_add("huge_page_mt", mm_kobj);
+	if (unlikely(!kobj)) {
+		pr_err("failed to create huge_page_mt kobject\n");
+		return -ENOMEM;
+	}
+
+	err = sysfs_create_group(kobj, &huge_page_mt_attr_group);
+	if (err) {
+		pr_err("failed to register huge_page_mt group\n");
+		kobject_put(kobj);
+		return err;
+	}
+
+	return 0;
+}
+subsys_initcall(huge_page_mt_init);
+
 static void clear_gigantic_page(struct page *page,
 				unsigned long addr,
 				unsigned int pages_per_huge_page)
@@ -5228,6 +5598,14 @@ static void clear_subpage(unsigned long addr, int idx, void *arg)
 	clear_user_highpage(page + idx, addr);
 }
 
+// Gigantic pages may span sections, so the struct pages are not contiguous.
+static void clear_gigantic_subpage(unsigned long addr, int idx, void *arg)
+{
+	struct page *page = arg;
+
+	clear_user_highpage(nth_page(page, idx), addr);
+}
+
 void clear_huge_page(struct page *page,
 		     unsigned long addr_hint, unsigned int pages_per_huge_page)
 {
@@ -5236,11 +5614,17 @@ void clear_huge_page(struct page *page,
 	u64 start = rdtsc();
 
 	if (unlikely(pages_per_huge_page > MAX_ORDER_NR_PAGES)) {
-		clear_gigantic_page(page, addr, pages_per_huge_page);
+		if (!process_huge_page_mt(addr_hint, pages_per_huge_page,
+					  clear_gigantic_subpage, page,
+					  page_to_nid(page)))
+			clear_gigantic_page(page, addr, pages_per_huge_page);
 		return;
 	}
 
-	process_huge_page(addr_hint, pages_per_huge_page, clear_subpage, page);
+	if (!process_huge_page_mt(addr_hint, pages_per_huge_page,
+				  clear_subpage, page, page_to_nid(page)))
+		process_huge_page(addr_hint, pages_per_huge_page,
+				  clear_subpage, page);
 
 	mm_stats_hist_measure(&mm_huge_page_fault_clear_cycles, rdtsc() - start);
 }
@@ -5278,6 +5662,15 @@ static void copy_subpage(unsigned long addr, int idx, void *arg)
 			   addr, copy_arg->vma);
 }
 
+static void copy_gigantic_subpage(unsigned long addr, int idx, void *arg)
+{
+	struct copy_subpage_arg *copy_arg = arg;
+
+	copy_user_highpage(nth_page(copy_arg->dst, idx),
+			   nth_page(copy_arg->src, idx),
+			   addr, copy_arg->vma);
+}
+
 void copy_user_huge_page(struct page *dst, struct page *src,
 			 unsigned long addr_hint, struct vm_area_struct *vma,
 			 unsigned int pages_per_huge_page)
@@ -5292,12 +5685,18 @@ void copy_user_huge_page(struct page *dst, struct page *src,
 	u64 start = rdtsc();
 
 	if (unlikely(pages_per_huge_page > MAX_ORDER_NR_PAGES)) {
-		copy_user_gigantic_page(dst, src, addr, vma,
-					pages_per_huge_page);
+		if (!process_huge_page_mt(addr_hint, pages_per_huge_page,
+					  copy_gigantic_subpage, &arg,
+					  page_to_nid(dst)))
+			copy_user_gigantic_page(dst, src, addr, vma,
+						pages_per_huge_page);
 		return;
 	}
 
-	process_huge_page(addr_hint, pages_per_huge_page, copy_subpage, &arg);
+	if (!process_huge_page_mt(addr_hint, pages_per_huge_page,
+				  copy_subpage, &arg, page_to_nid(dst)))
+		process_huge_page(addr_hint, pages_per_huge_page,
+				  copy_subpage, &arg);
 
 	mm_stats_hist_measure(&mm_huge_page_fault_cow_copy_huge_cycles, rdtsc() - start);
 }
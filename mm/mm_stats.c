@@ -9,6 +9,18 @@
 #include <linux/fs.h>
 #include <linux/hashtable.h>
 #include <linux/cred.h>
+#include <linux/cgroup.h>
+#include <linux/rcupdate.h>
+#include <linux/mutex.h>
+#include <linux/atomic.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/sched.h>
+#include <linux/mm_types.h>
+#include <linux/topology.h>
+#include <linux/ptrace.h>
+#include <linux/mm_econ.h>
+#include <uapi/linux/pftrace.h>
 
 #define MM_STATS_INSTR_BUFSIZE 24
 
@@ -474,6 +486,569 @@ static inline void rejected_sample(struct mm_stats_pftrace *trace)
     node->count += 1;
 }
 
+// Filters to trace the faults of only some processes, cgroups or address
+// ranges, each with its own sample rate and threshold. If there are any
+// filters, a fault that doesn't match one is dropped before anything else is
+// done with it. Otherwise, all faults are subject to pftrace_threshold.
+//
+// Reading /proc/pftrace_filters lists the filters, one per line. Writing adds
+// one filter, given as space-separated fields, all of them optional:
+//
+//     tgid=<pid>               only this process (0: any)
+//     cgroup=<id>              only this cgroup on the default hierarchy (0: any)
+//     flags=<val>[/<mask>]     only faults whose bitflags & mask == val, with
+//                              mask defaulting to val
+//     addr=<start>-<end>       only faults in [start, end)
+//     rate=<n>                 trace 1 in n matching faults (default 1)
+//     threshold=<cycles>       instead of pftrace_threshold
+//
+// Writing "clear" removes all filters. The first matching filter applies.
+#define MM_STATS_PFTRACE_MAX_FILTERS 16
+
+struct pftrace_filter {
+    pid_t tgid;
+    u64 cgroup;
+    mm_stats_bitflags_t flags;
+    mm_stats_bitflags_t flags_mask;
+    u64 addr_start;
+    u64 addr_end; // exclusive; 0 means no address filter
+    u64 rate;
+    u64 threshold; // U64_MAX means pftrace_threshold
+
+    // Number of faults that matched, and of those that were sampled.
+    atomic64_t nmatched;
+    atomic64_t nsampled;
+};
+
+struct pftrace_filters {
+    struct rcu_head rcu;
+    int n;
+    struct pftrace_filter filters[];
+};
+
+static struct pftrace_filters __rcu *pftrace_filters = NULL;
+static DEFINE_MUTEX(pftrace_filters_mutex);
+
+static bool pftrace_filter_match(const struct pftrace_filter *f,
+        const struct mm_stats_pftrace *trace, unsigned long address)
+{
+    if (f->tgid && f->tgid != current->tgid)
+        return false;
+    if ((trace->bitflags & f->flags_mask) != f->flags)
+        return false;
+    if (f->addr_end && (address < f->addr_start || address >= f->addr_end))
+        return false;
+#ifdef CONFIG_CGROUPS
+    if (f->cgroup && f->cgroup != cgroup_id(task_dfl_cgroup(current)))
+        return false;
+#endif
+    return true;
+}
+
+// Decide whether to keep looking at the sample, and if so, set *threshold to
+// the threshold to apply to it.
+static bool pftrace_filter(const struct mm_stats_pftrace *trace,
+        unsigned long address, u64 *threshold)
+{
+    struct pftrace_filters *filters;
+    struct pftrace_filter *f;
+    bool keep = true;
+    int i;
+
+    *threshold = pftrace_threshold;
+
+    rcu_read_lock();
+    filters = rcu_dereference(pftrace_filters);
+    if (!filters)
+        goto out;
+
+    keep = false;
+    for (i = 0; i < filters->n; i++) {
+        f = &filters->filters[i];
+        if (!pftrace_filter_match(f, trace, address))
+            continue;
+
+        if (atomic64_inc_return(&f->nmatched) % f->rate == 0) {
+            atomic64_inc(&f->nsampled);
+            keep = true;
+            if (f->threshold != U64_MAX)
+                *threshold = f->threshold;
+        }
+        break;
+    }
+
+out:
+    rcu_read_unlock();
+    return keep;
+}
+
+static struct proc_dir_entry *pftrace_filters_ent;
+static ssize_t pftrace_filters_read_cb(
+        struct file *file, char __user *ubuf, size_t count, loff_t *ppos)
+{
+    struct pftrace_filters *filters;
+    struct pftrace_filter *f;
+    ssize_t len = 0;
+    ssize_t ret;
+    char *buf;
+    int i;
+
+    buf = (char *)vmalloc(PAGE_SIZE);
+    if (!buf)
+        return -ENOMEM;
+
+    rcu_read_lock();
+    filters = rcu_dereference(pftrace_filters);
+    for (i = 0; filters && i < filters->n; i++) {
+        f = &filters->filters[i];
+        len += scnprintf(&buf[len], PAGE_SIZE - len,
+                "tgid=%d cgroup=%llu flags=0x%llx/0x%llx addr=0x%llx-0x%llx "
+                "rate=%llu threshold=",
+                f->tgid, f->cgroup, f->flags, f->flags_mask,
+                f->addr_start, f->addr_end, f->rate);
+        if (f->threshold == U64_MAX)
+            len += scnprintf(&buf[len], PAGE_SIZE - len, "default");
+        else
+            len += scnprintf(&buf[len], PAGE_SIZE - len, "%llu",
+                    f->threshold);
+        len += scnprintf(&buf[len], PAGE_SIZE - len,
+                " matched=%lld sampled=%lld\n",
+                atomic64_read(&f->nmatched), atomic64_read(&f->nsampled));
+    }
+    rcu_read_unlock();
+
+    ret = simple_read_from_buffer(ubuf, count, ppos, buf, len);
+    vfree(buf);
+    return ret;
+}
+
+static int pftrace_filter_parse(char *input, struct pftrace_filter *f)
+{
+    char *tok, *val, *val2;
+    u64 tgid;
+    int ret = 0;
+
+    memset(f, 0, sizeof(*f));
+    f->rate = 1;
+    f->threshold = U64_MAX;
+
+    while ((tok = strsep(&input, " \t")) != NULL) { // NOTE: assignment
+        if (tok[0] == '\0')
+            continue;
+
+        val = strchr(tok, '=');
+        if (!val)
+            return -EINVAL;
+        *val++ = '\0';
+
+        if (strcmp(tok, "tgid") == 0) {
+            ret = kstrtou64(val, 0, &tgid);
+            if (!ret && tgid > PID_MAX_LIMIT)
+                ret = -EINVAL;
+            f->tgid = tgid;
+        } else if (strcmp(tok, "cgroup") == 0) {
+            ret = kstrtou64(val, 0, &f->cgroup);
+        } else if (strcmp(tok, "flags") == 0) {
+            val2 = strchr(val, '/');
+            if (val2)
+                *val2++ = '\0';
+            ret = kstrtou64(val, 0, &f->flags);
+            if (!ret)
+                ret = val2 ? kstrtou64(val2, 0, &f->flags_mask) : 0;
+            if (!val2)
+                f->flags_mask = f->flags;
+            f->flags &= f->flags_mask;
+        } else if (strcmp(tok, "addr") == 0) {
+            val2 = strchr(val, '-');
+            if (!val2)
+                return -EINVAL;
+            *val2++ = '\0';
+            ret = kstrtou64(val, 0, &f->addr_start);
+            if (!ret)
+                ret = kstrtou64(val2, 0, &f->addr_end);
+            if (!ret && f->addr_end <= f->addr_start)
+                ret = -EINVAL;
+        } else if (strcmp(tok, "rate") == 0) {
+            ret = kstrtou64(val, 0, &f->rate);
+            if (!ret && f->rate == 0)
+                ret = -EINVAL;
+        } else if (strcmp(tok, "threshold") == 0) {
+            ret = kstrtou64(val, 0, &f->threshold);
+        } else {
+            ret = -EINVAL;
+        }
+
+        if (ret)
+            return ret;
+    }
+
+    return 0;
+}
+
+static ssize_t pftrace_filters_write_cb(
+        struct file *file, const char __user *ubuf, size_t len, loff_t *offset)
+{
+    struct pftrace_filters *old, *new = NULL;
+    struct pftrace_filter f;
+    char *input;
+    ssize_t ret;
+    int n;
+
+    input = memdup_user_nul(ubuf, len);
+    if (IS_ERR(input))
+        return PTR_ERR(input);
+
+    mutex_lock(&pftrace_filters_mutex);
+    old = rcu_dereference_protected(pftrace_filters,
+            lockdep_is_held(&pftrace_filters_mutex));
+
+    if (strcmp(strim(input), "clear") == 0)
+        goto replace;
+
+    ret = pftrace_filter_parse(strim(input), &f);
+    if (ret)
+        goto out;
+
+    n = old ? old->n : 0;
+    if (n == MM_STATS_PFTRACE_MAX_FILTERS) {
+        ret = -ENOSPC;
+        goto out;
+    }
+
+    new = kzalloc(struct_size(new, filters, n + 1), GFP_KERNEL);
+    if (!new) {
+        ret = -ENOMEM;
+        goto out;
+    }
+    if (old)
+        memcpy(new->filters, old->filters, n * sizeof(f));
+    new->filters[n] = f;
+    new->n = n + 1;
+
+replace:
+    rcu_assign_pointer(pftrace_filters, new);
+    if (old)
+        kfree_rcu(old, rcu);
+    ret = len;
+out:
+    mutex_unlock(&pftrace_filters_mutex);
+    kfree(input);
+    return ret;
+}
+
+static struct file_operations pftrace_filters_ops =
+{
+    .read = pftrace_filters_read_cb,
+    .write = pftrace_filters_write_cb,
+};
+
+// The heatmap: while /proc/pftrace_heatmap_enable is set, every fault that
+// passes the filters above (but regardless of any threshold) is added to a
+// summary of fault latency for its process and 2MB region. This doesn't need
+// pftrace_enable or the trace file.
+//
+// Reading /proc/pftrace_heatmap gives one line per region, in no particular
+// order:
+//
+//     <pid> <start> <nfaults> <nhuge> <cycles> <max_cycles> <filter>
+//
+// where nhuge of the nfaults faults mapped a huge page, cycles is their total
+// latency and <filter> is a huge page filter for the region in the format of
+// /proc/<pid>/mmap_filters. Its benefit is the latency of the base page faults
+// alone, which is what a huge page would have saved. So
+//
+//     awk '$1 == <pid> { print $7 }' /proc/pftrace_heatmap
+//
+// is a huge page profile for a later run of the same program, as long as it
+// lays out its address space the same way. Writing "clear" empties the
+// heatmap.
+//
+// Regions are spread over PFTRACE_HEATMAP_NR_SHARDS shards by a hash of their
+// pid and address, each with its own lock, so faults on different CPUs rarely
+// contend. The regions themselves come from a pool that is allocated the first
+// time the heatmap is enabled, so faults never allocate memory.
+#define PFTRACE_HEATMAP_SHIFT 21
+#define PFTRACE_HEATMAP_NR_SHARDS 64
+#define PFTRACE_HEATMAP_SHARD_HASH_BITS 6
+#define PFTRACE_HEATMAP_MAX_REGIONS (1 << 16)
+
+static int pftrace_heatmap_alloc(void);
+MM_STATS_PROC_CREATE_INT_INNER(int, pftrace_heatmap_enable, 0, "%d", {
+    long err;
+
+    if (pftrace_heatmap_enable) {
+        err = pftrace_heatmap_alloc();
+        if (err) {
+            pftrace_heatmap_enable = 0;
+            return err;
+        }
+    }
+})
+// Faults not counted because the heatmap was full.
+MM_STATS_PROC_CREATE_INT(u64, pftrace_heatmap_dropped, 0, "%llu")
+
+struct pftrace_heatmap_region {
+    struct hlist_node node;
+    pid_t pid;
+    enum mm_memory_section section;
+    u64 start;
+    u64 nfaults;
+    u64 nhuge;
+    u64 cycles;
+    u64 base_cycles;
+    u64 max_cycles;
+};
+
+struct pftrace_heatmap_shard {
+    spinlock_t lock;
+    DECLARE_HASHTABLE(regions, PFTRACE_HEATMAP_SHARD_HASH_BITS);
+    // Unused regions of the pool that belong to this shard.
+    struct hlist_head free;
+} ____cacheline_aligned_in_smp;
+
+static struct pftrace_heatmap_shard
+pftrace_heatmap_shards[PFTRACE_HEATMAP_NR_SHARDS];
+
+// The pool of regions. Never freed once allocated, since faults may be using
+// it at any time.
+static struct pftrace_heatmap_region *pftrace_heatmap_pool = NULL;
+static DEFINE_MUTEX(pftrace_heatmap_pool_mutex);
+
+static const char *pftrace_heatmap_section_names[] = {
+    [SectionCode] = "code",
+    [SectionData] = "data",
+    [SectionHeap] = "heap",
+    [SectionMmap] = "mmap",
+};
+
+static void pftrace_heatmap_init(void)
+{
+    int i;
+
+    for (i = 0; i < PFTRACE_HEATMAP_NR_SHARDS; i++) {
+        spin_lock_init(&pftrace_heatmap_shards[i].lock);
+        hash_init(pftrace_heatmap_shards[i].regions);
+        INIT_HLIST_HEAD(&pftrace_heatmap_shards[i].free);
+    }
+}
+
+// Allocate the pool and split it evenly among the shards, if not done yet.
+static int pftrace_heatmap_alloc(void)
+{
+    struct pftrace_heatmap_region *pool;
+    int i, ret = 0;
+
+    mutex_lock(&pftrace_heatmap_pool_mutex);
+
+    if (pftrace_heatmap_pool)
+        goto out;
+
+    pool = vzalloc(array_size(PFTRACE_HEATMAP_MAX_REGIONS, sizeof(*pool)));
+    if (!pool) {
+        ret = -ENOMEM;
+        goto out;
+    }
+
+    // Nobody looks at the shards until the pool is published below.
+    for (i = 0; i < PFTRACE_HEATMAP_MAX_REGIONS; i++) {
+        hlist_add_head(&pool[i].node,
+                &pftrace_heatmap_shards[i % PFTRACE_HEATMAP_NR_SHARDS].free);
+    }
+
+    smp_store_release(&pftrace_heatmap_pool, pool);
+
+out:
+    mutex_unlock(&pftrace_heatmap_pool_mutex);
+    return ret;
+}
+
+static inline u32 pftrace_heatmap_key(pid_t pid, u64 start)
+{
+    return hash_64(start ^ pid, 32);
+}
+
+static inline struct pftrace_heatmap_shard *pftrace_heatmap_shard(u32 key)
+{
+    return &pftrace_heatmap_shards[key % PFTRACE_HEATMAP_NR_SHARDS];
+}
+
+// Which section the filters in mmap_filters would see `address` as part of.
+// A region can span two sections, in which case it gets an entry for each.
+static enum mm_memory_section pftrace_heatmap_section(unsigned long address)
+{
+    struct mm_struct *mm = current->mm;
+
+    if (!mm)
+        return SectionMmap;
+    if (address >= mm->start_code && address < mm->end_code)
+        return SectionCode;
+    if (address >= mm->start_data && address < mm->end_data)
+        return SectionData;
+    if (address >= mm->start_brk && address < mm->brk)
+        return SectionHeap;
+    return SectionMmap;
+}
+
+static void pftrace_heatmap_account(const struct mm_stats_pftrace *trace)
+{
+    const u64 start = trace->address & ~((1ull << PFTRACE_HEATMAP_SHIFT) - 1);
+    const u64 cycles = trace->end_tsc - trace->start_tsc;
+    const enum mm_memory_section section =
+        pftrace_heatmap_section(trace->address);
+    const u32 key = pftrace_heatmap_key(trace->pid, start);
+    struct pftrace_heatmap_shard *shard = pftrace_heatmap_shard(key);
+    struct pftrace_heatmap_region *r;
+    unsigned long flags;
+    bool found = false;
+
+    // Enabled, but the pool isn't there yet.
+    if (!smp_load_acquire(&pftrace_heatmap_pool))
+        return;
+
+    spin_lock_irqsave(&shard->lock, flags);
+
+    hash_for_each_possible(shard->regions, r, node, key)
+    {
+        if (r->start == start && r->pid == trace->pid
+                && r->section == section) {
+            found = true;
+            break;
+        }
+    }
+
+    if (!found) {
+        if (hlist_empty(&shard->free)) {
+            pftrace_heatmap_dropped += 1;
+            goto out;
+        }
+
+        r = hlist_entry(shard->free.first, struct pftrace_heatmap_region, node);
+        hlist_del(&r->node);
+        memset(r, 0, sizeof(*r));
+        r->pid = trace->pid;
+        r->section = section;
+        r->start = start;
+        hash_add(shard->regions, &r->node, key);
+    }
+
+    r->nfaults += 1;
+    r->cycles += cycles;
+    if (cycles > r->max_cycles)
+        r->max_cycles = cycles;
+    if (trace->bitflags & (1ull << MM_STATS_PF_HUGE_PAGE))
+        r->nhuge += 1;
+    else
+        r->base_cycles += cycles;
+
+out:
+    spin_unlock_irqrestore(&shard->lock, flags);
+}
+
+static void pftrace_heatmap_clear(void)
+{
+    struct pftrace_heatmap_shard *shard;
+    struct pftrace_heatmap_region *r;
+    struct hlist_node *tmp;
+    unsigned long flags;
+    int i, bkt;
+
+    for (i = 0; i < PFTRACE_HEATMAP_NR_SHARDS; i++) {
+        shard = &pftrace_heatmap_shards[i];
+
+        spin_lock_irqsave(&shard->lock, flags);
+        hash_for_each_safe(shard->regions, bkt, tmp, r, node) {
+            hash_del(&r->node);
+            hlist_add_head(&r->node, &shard->free);
+        }
+        spin_unlock_irqrestore(&shard->lock, flags);
+    }
+}
+
+// Shards are printed one at a time, so faults are only held up by the shard
+// being printed.
+static int pftrace_heatmap_show(struct seq_file *m, void *v)
+{
+    struct pftrace_heatmap_shard *shard;
+    struct pftrace_heatmap_region *r;
+    unsigned long flags;
+    int i, bkt;
+
+    for (i = 0; i < PFTRACE_HEATMAP_NR_SHARDS; i++) {
+        shard = &pftrace_heatmap_shards[i];
+
+        spin_lock_irqsave(&shard->lock, flags);
+        hash_for_each(shard->regions, bkt, r, node) {
+            seq_printf(m, "%d 0x%llx %llu %llu %llu %llu "
+                    "huge,%s,%llu,addr,>,0x%llx,addr,<,0x%llx\n",
+                    r->pid, r->start, r->nfaults, r->nhuge, r->cycles,
+                    r->max_cycles, pftrace_heatmap_section_names[r->section],
+                    r->base_cycles, r->start,
+                    r->start + (1ull << PFTRACE_HEATMAP_SHIFT));
+        }
+        spin_unlock_irqrestore(&shard->lock, flags);
+
+        cond_resched();
+    }
+
+    return 0;
+}
+
+static int pftrace_heatmap_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, pftrace_heatmap_show, NULL);
+}
+
+static ssize_t pftrace_heatmap_write_cb(
+        struct file *file, const char __user *ubuf, size_t len, loff_t *offset)
+{
+    char *input;
+    ssize_t ret = len;
+
+    input = memdup_user_nul(ubuf, len);
+    if (IS_ERR(input))
+        return PTR_ERR(input);
+
+    if (strcmp(strim(input), "clear") == 0)
+        pftrace_heatmap_clear();
+    else
+        ret = -EINVAL;
+
+    kfree(input);
+    return ret;
+}
+
+static struct proc_dir_entry *pftrace_heatmap_ent;
+static struct file_operations pftrace_heatmap_ops =
+{
+    .open = pftrace_heatmap_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release,
+    .write = pftrace_heatmap_write_cb,
+};
+
+// Records are written as-is, so they must have the layout the header claims.
+static_assert(sizeof(struct mm_stats_pftrace) == sizeof(struct pftrace_record));
+static_assert(offsetof(struct mm_stats_pftrace, address)
+        == PFTRACE_RECORD_V0_SIZE);
+static_assert(offsetof(struct mm_stats_pftrace, nid)
+        == offsetof(struct pftrace_record, nid));
+
+static long write_pftrace_header(void)
+{
+    struct pftrace_header header = {
+        .magic = PFTRACE_MAGIC,
+        .version = PFTRACE_VERSION,
+        .record_size = sizeof(struct pftrace_record),
+    };
+    ssize_t written;
+
+    written = kernel_write(pftrace_file, &header, sizeof(header), &pftrace_pos);
+    if (written < 0)
+        return written;
+    return written == sizeof(header) ? 0 : -EIO;
+}
+
 static inline int open_pftrace_file(bool reopen) {
     struct file *file;
     long err;
@@ -498,9 +1073,16 @@ static inline int open_pftrace_file(bool reopen) {
         return err;
     }
 
-    // Successfully opened the file!
-
+    // Successfully opened the file! Start it with the header.
     pftrace_file = file;
+    pftrace_pos = 0;
+    err = write_pftrace_header();
+    if (err) {
+        pr_err("mm_stats: Failed to write pftrace header. errno=%ld\n", err);
+        filp_close(pftrace_file, NULL);
+        pftrace_file = NULL;
+        return err;
+    }
 
     pr_warn("mm_stats: Successfully opened %s current->uid=%u\n",
             MM_STATS_PFTRACE_FNAME, __kuid_val(current_cred()->uid));
@@ -512,17 +1094,35 @@ void mm_stats_pftrace_init(struct mm_stats_pftrace *trace)
     memset(trace, 0, sizeof(struct mm_stats_pftrace));
 }
 
-void mm_stats_pftrace_submit(struct mm_stats_pftrace *trace, struct pt_regs *regs)
+void mm_stats_pftrace_submit(struct mm_stats_pftrace *trace, struct pt_regs *regs,
+        unsigned long address)
 {
     long err, i;
     ssize_t total_written = 0, written;
+    u64 threshold;
 
     // Check if pftrace is on.
+    if (!pftrace_enable && !pftrace_heatmap_enable) return;
+
+    // Drop faults the filters don't want, or that were not sampled, without
+    // even counting them as rejected.
+    if (!pftrace_filter(trace, address, &threshold)) return;
+
+    // Record where the fault happened. For faults taken in the kernel (e.g.
+    // copy_from_user), the user ip saved on syscall entry says nothing about
+    // which access faulted, so record 0 instead.
+    trace->address = address;
+    trace->ip = user_mode(regs) ? regs->ip : 0;
+    trace->pid = current->tgid;
+    trace->nid = numa_node_id();
+
+    if (pftrace_heatmap_enable)
+        pftrace_heatmap_account(trace);
+
     if (!pftrace_enable) return;
 
     // Filter out some events.
-    // TODO: more complex filter...
-    if (trace->end_tsc - trace->start_tsc < pftrace_threshold) {
+    if (trace->end_tsc - trace->start_tsc < threshold) {
         rejected_sample(trace);
         return;
     }
@@ -664,6 +1264,9 @@ MM_STATS_PROC_CREATE_HIST(mm_huge_page_promotion_copy_pages_cycles);
 // huge pages.
 MM_STATS_PROC_CREATE_HIST(mm_process_huge_page_cycles);
 MM_STATS_PROC_CREATE_HIST(mm_process_huge_page_single_page_cycles);
+// Same as mm_process_huge_page_cycles, but for huge pages that were cleared or
+// copied by multiple threads (see process_huge_page_mt).
+MM_STATS_PROC_CREATE_HIST(mm_process_huge_page_mt_cycles);
 
 // Histograms of estimated costs and benefits for mm_econ.
 MM_STATS_PROC_CREATE_HIST(mm_econ_cost);
@@ -678,6 +1281,13 @@ void mm_stats_init(void)
     hash_init(pftrace_rejected_samples);
     rejected_hash_ent = proc_create("pftrace_rejected",
             0444, NULL, &rejected_hash_ops);
+    pftrace_filters_ent = proc_create("pftrace_filters",
+            0644, NULL, &pftrace_filters_ops);
+    pftrace_heatmap_init();
+    MM_STATS_INIT_INT(pftrace_heatmap_enable);
+    MM_STATS_INIT_INT(pftrace_heatmap_dropped);
+    pftrace_heatmap_ent = proc_create("pftrace_heatmap",
+            0644, NULL, &pftrace_heatmap_ops);
 
     MM_STATS_INIT_HIST(mm_base_page_fault_cycles);
     MM_STATS_INIT_HIST(mm_huge_page_fault_cycles);
@@ -694,6 +1304,7 @@ void mm_stats_init(void)
     MM_STATS_INIT_HIST(mm_huge_page_promotion_copy_pages_cycles);
     MM_STATS_INIT_HIST(mm_process_huge_page_cycles);
     MM_STATS_INIT_HIST(mm_process_huge_page_single_page_cycles);
+    MM_STATS_INIT_HIST(mm_process_huge_page_mt_cycles);
 
     MM_STATS_INIT_HIST(mm_econ_cost);
     MM_STATS_INIT_HIST(mm_econ_benefit);
@@ -48,6 +48,9 @@
 #include <linux/oom.h>
 #include <linux/sched/mm.h>
 #include <linux/mm_econ.h>
+#include <linux/badger_trap.h>
+#include <linux/fadvise.h>
+#include <linux/workqueue.h>
 
 #include <linux/uaccess.h>
 #include <asm/cacheflush.h>
@@ -293,7 +296,7 @@ SYSCALL_DEFINE1(brk, unsigned long, brk)
 		mm_action.len = newbrk - oldbrk;
 		mm_action.action = MM_ACTION_EAGER_PAGING;
 		mm_estimate_changes(&mm_action, &mm_cost_delta);
-		should_do = mm_decide(&mm_cost_delta);
+		should_do = mm_decide(&mm_action, &mm_cost_delta);
 
 		if (should_do) {
 			ranges = (struct range*)mm_cost_delta.extra;
@@ -1631,6 +1634,131 @@ unsigned long do_mmap(struct file *file, unsigned long addr,
 	return ret;
 }
 
+#ifdef CONFIG_MM_ECON
+/*
+ * Eager paging for file mappings. Reading the file in and mapping it one
+ * fault (or fault-around block) at a time is what makes cold starts on large
+ * mapped files slow, so for ranges the profile says will be used, we start
+ * readahead right away and pre-map the range from a worker once the pages
+ * arrive.
+ *
+ * The pre-mapping is a read fault on every page, so private writable mappings
+ * are not COWed until the process actually writes to them. The process can
+ * munmap or mmap over the range before the worker runs, so each chunk is only
+ * pre-mapped if it still maps the same part of the same file.
+ */
+struct file_premap_work {
+	struct work_struct work;
+	struct mm_struct *mm;
+	struct file *file;
+	unsigned long start;
+	unsigned long end;
+	unsigned long pgoff;		/* file page mapped at start */
+};
+
+/*
+ * Pre-mapping is done FILE_PREMAP_CHUNK pages at a time, dropping mmap_sem in
+ * between, and at most FILE_PREMAP_MAX_INFLIGHT ranges are queued at once.
+ * Ranges beyond that only get readahead.
+ */
+#define FILE_PREMAP_CHUNK		512
+#define FILE_PREMAP_MAX_INFLIGHT	64
+
+static atomic_t file_premap_inflight = ATOMIC_INIT(0);
+
+/*
+ * Pre-map one chunk at addr, if it is still mapped from the same place in the
+ * same file. Returns the address to continue from, or 0 to stop.
+ */
+static unsigned long file_premap_chunk(struct file_premap_work *pw,
+				       unsigned long addr)
+{
+	struct mm_struct *mm = pw->mm;
+	struct vm_area_struct *vma;
+	unsigned long end, pgoff;
+	int locked = 1;
+	long ret;
+
+	pgoff = pw->pgoff + ((addr - pw->start) >> PAGE_SHIFT);
+
+	down_read(&mm->mmap_sem);
+
+	/* The mapping may have been unmapped or replaced since the mmap. */
+	vma = find_vma(mm, addr);
+	if (!vma || vma->vm_start > addr || vma->vm_file != pw->file ||
+	    vma->vm_pgoff + ((addr - vma->vm_start) >> PAGE_SHIFT) != pgoff) {
+		up_read(&mm->mmap_sem);
+		return 0;
+	}
+
+	end = min3(pw->end, vma->vm_end,
+		   addr + ((unsigned long)FILE_PREMAP_CHUNK << PAGE_SHIFT));
+
+	ret = get_user_pages_remote(NULL, mm, addr, (end - addr) >> PAGE_SHIFT,
+				    0, NULL, NULL, &locked);
+	if (locked)
+		up_read(&mm->mmap_sem);
+
+	if (ret <= 0)
+		return 0;
+	return addr + (ret << PAGE_SHIFT);
+}
+
+static void file_premap_workfn(struct work_struct *work)
+{
+	struct file_premap_work *pw =
+		container_of(work, struct file_premap_work, work);
+	struct mm_struct *mm = pw->mm;
+	unsigned long addr = pw->start;
+
+	if (mmget_not_zero(mm)) {
+		while (addr && addr < pw->end) {
+			addr = file_premap_chunk(pw, addr);
+			cond_resched();
+		}
+		mmput(mm);
+	}
+
+	fput(pw->file);
+	mmdrop(mm);
+	kfree(pw);
+	atomic_dec(&file_premap_inflight);
+}
+
+static void mm_econ_file_eager(struct file *file, unsigned long mapaddr,
+			       unsigned long pgoff, unsigned long start,
+			       unsigned long end)
+{
+	struct file_premap_work *pw;
+	loff_t off = ((loff_t)pgoff << PAGE_SHIFT) + (start - mapaddr);
+
+	if (start >= end)
+		return;
+
+	vfs_fadvise(file, off, end - start, POSIX_FADV_WILLNEED);
+
+	if (atomic_inc_return(&file_premap_inflight) > FILE_PREMAP_MAX_INFLIGHT)
+		goto out_dec;
+
+	pw = kmalloc(sizeof(*pw), GFP_KERNEL);
+	if (!pw)
+		goto out_dec;
+
+	INIT_WORK(&pw->work, file_premap_workfn);
+	mmgrab(current->mm);
+	pw->mm = current->mm;
+	pw->file = get_file(file);
+	pw->start = start;
+	pw->end = end;
+	pw->pgoff = pgoff + ((start - mapaddr) >> PAGE_SHIFT);
+	queue_work(system_unbound_wq, &pw->work);
+	return;
+
+out_dec:
+	atomic_dec(&file_premap_inflight);
+}
+#endif
+
 unsigned long ksys_mmap_pgoff(unsigned long addr, unsigned long len,
 			      unsigned long prot, unsigned long flags,
 			      unsigned long fd, unsigned long pgoff)
@@ -1685,6 +1813,11 @@ unsigned long ksys_mmap_pgoff(unsigned long addr, unsigned long len,
 		u64 section_off = current->mm->mmap_base - retval;
 		mm_add_memory_range(current->tgid, SectionMmap, retval, section_off,
 				addr, len, prot, flags, fd, pgoff);
+		// The page cache of a file may be huge too (shmem/tmpfs, file
+		// THP), so give the file a profile for this part of it.
+		if (file)
+			mm_add_file_range(current->tgid, file_inode(file),
+					retval, len, pgoff);
 
 		// Determine if we want to eagerly allocate parts of this mmap
 		if ( (flags & MAP_ANONYMOUS) && mm_econ_is_on() && mm_process_is_using_cbmm(current->tgid)) {
@@ -1692,7 +1825,7 @@ unsigned long ksys_mmap_pgoff(unsigned long addr, unsigned long len,
 			mm_action.len = len;
 			mm_action.action = MM_ACTION_EAGER_PAGING;
 			mm_estimate_changes(&mm_action, &mm_cost_delta);
-			should_do = mm_decide(&mm_cost_delta);
+			should_do = mm_decide(&mm_action, &mm_cost_delta);
 
 			if (should_do) {
 				ranges = (struct range*)mm_cost_delta.extra;
@@ -1705,6 +1838,27 @@ unsigned long ksys_mmap_pgoff(unsigned long addr, unsigned long len,
 			if (ranges) vfree(ranges);
 		}
 
+		// Same for file mappings, but via readahead and pre-mapping.
+		// MAP_POPULATE mappings are already populated.
+		if (file && !(flags & (MAP_ANONYMOUS | MAP_POPULATE)) &&
+		    mm_econ_is_on() &&
+		    mm_process_is_using_cbmm(current->tgid)) {
+			mm_action.address = retval;
+			mm_action.len = len;
+			mm_action.action = MM_ACTION_EAGER_PAGING;
+			mm_estimate_changes(&mm_action, &mm_cost_delta);
+			should_do = mm_decide(&mm_action, &mm_cost_delta);
+
+			ranges = (struct range*)mm_cost_delta.extra;
+			for (i = 0; should_do && ranges &&
+			     ranges[i].start != -1 && ranges[i].end != -1; i++) {
+				mm_econ_file_eager(file, retval, pgoff,
+						max_t(u64, ranges[i].start, retval),
+						min_t(u64, ranges[i].end, retval + len));
+			}
+
+			if (ranges) vfree(ranges);
+		}
 	}
 #endif
 out_fput:
@@ -1942,6 +2096,8 @@ unsigned long mmap_region(struct file *file, unsigned long addr,
 
 	vma_set_page_prot(vma);
 
+	badger_trap_vma_event(mm, vma->vm_start, vma->vm_end);
+
 	return addr;
 
 unmap_and_free_vma:
@@ -2504,6 +2660,8 @@ int expand_upwards(struct vm_area_struct *vma, unsigned long address)
 				spin_unlock(&mm->page_table_lock);
 
 				perf_event_mmap(vma);
+				badger_trap_vma_event(mm, vma->vm_start,
+						      vma->vm_end);
 			}
 		}
 	}
@@ -2582,6 +2740,8 @@ int expand_downwards(struct vm_area_struct *vma,
 				spin_unlock(&mm->page_table_lock);
 
 				perf_event_mmap(vma);
+				badger_trap_vma_event(mm, vma->vm_start,
+						      vma->vm_end);
 			}
 		}
 	}
@@ -2787,8 +2947,10 @@ int __split_vma(struct mm_struct *mm, struct vm_area_struct *vma,
 		err = vma_adjust(vma, vma->vm_start, addr, vma->vm_pgoff, new);
 
 	/* Success. */
-	if (!err)
+	if (!err) {
+		badger_trap_vma_stats_split(vma, new);
 		return 0;
+	}
 
 	/* Clean everything up if vma_adjust failed. */
 	if (new->vm_ops && new->vm_ops->close)
@@ -3150,6 +3312,7 @@ static int do_brk_flags(unsigned long addr, unsigned long len, unsigned long fla
 	if (flags & VM_LOCKED)
 		mm->locked_vm += (len >> PAGE_SHIFT);
 	vma->vm_flags |= VM_SOFTDIRTY;
+	badger_trap_vma_event(mm, vma->vm_start, vma->vm_end);
 
 #ifdef CONFIG_MM_ECON
 	// Bijan: If we expand the heap, add the new section to the tracked
@@ -24,6 +24,7 @@
 #include <linux/uaccess.h>
 #include <linux/mm-arch-hooks.h>
 #include <linux/userfaultfd_k.h>
+#include <linux/badger_trap.h>
 
 #include <asm/cacheflush.h>
 #include <asm/tlbflush.h>
@@ -717,6 +718,9 @@ SYSCALL_DEFINE5(mremap, unsigned long, addr, unsigned long, old_len,
 	if (offset_in_page(ret)) {
 		vm_unacct_memory(charged);
 		locked = 0;
+	} else if (ret != addr || new_len > old_len) {
+		/* Moved or grown */
+		badger_trap_vma_event(mm, ret, ret + new_len);
 	}
 	if (downgraded)
 		up_read(&current->mm->mmap_sem);
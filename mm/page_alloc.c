@@ -72,6 +72,7 @@
 #include <linux/cpufreq.h>
 #include <linux/mm_econ.h>
 #include <linux/cpufreq.h>
+#include <linux/zone_lock_stat.h>
 
 #include <asm/sections.h>
 #include <asm/tlbflush.h>
@@ -939,6 +940,19 @@ compaction_capture(struct capture_control *capc, struct page *page,
 }
 #endif /* CONFIG_COMPACTION */
 
+/*
+ * A free block counts towards NR_FREE_ZEROED_PAGES if its head page is
+ * zeroed. Callers must hold zone->lock and account before the block goes
+ * onto a free list and after it comes off one.
+ */
+static inline void account_free_zeroed(struct zone *zone, struct page *page,
+				       unsigned int order, int sign)
+{
+	if (PageZeroed(page))
+		__mod_zone_page_state(zone, NR_FREE_ZEROED_PAGES,
+				      sign * (1L << order));
+}
+
 /*
  * Freeing function for a buddy system allocator.
  *
@@ -1009,8 +1023,10 @@ static inline void __free_one_page(struct page *page,
 		 */
 		if (page_is_guard(buddy))
 			clear_page_guard(zone, buddy, order, migratetype);
-		else
+		else {
+			account_free_zeroed(zone, buddy, order, -1);
 			del_page_from_free_area(buddy, &zone->free_area[order]);
+		}
 		combined_pfn = buddy_pfn & pfn;
 		page = page + (combined_pfn - pfn);
 		pfn = combined_pfn;
@@ -1043,6 +1059,7 @@ static inline void __free_one_page(struct page *page,
 
 done_merging:
 	set_page_order(page, order);
+	account_free_zeroed(zone, page, order, 1);
 
 	/*
 	 * If this is not the largest possible page, check if the buddy
@@ -1194,6 +1211,8 @@ static void kernel_init_free_pages(struct page *page, int numpages)
 		else
 			clear_highpage(page + i);
 
+	count_vm_event(prezeroed ? PGALLOC_ZEROED_HIT : PGALLOC_ZEROED_MISS);
+
 	get_cpu_var(pftrace_alloc_zeroed_page) = true;
 	get_cpu_var(pftrace_alloc_zeroing_duration) = rdtsc() - start;
 	get_cpu_var(pftrace_alloc_prezeroed) = prezeroed;
@@ -1335,6 +1354,7 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 	int prefetch_nr = 0;
 	bool isolated_pageblocks;
 	struct page *page, *tmp;
+	struct zone_lock_sample zls;
 	LIST_HEAD(head);
 
 	while (count) {
@@ -1383,7 +1403,7 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 		} while (--count && --batch_free && !list_empty(list));
 	}
 
-	spin_lock(&zone->lock);
+	zone_lock(zone, &zls);
 	isolated_pageblocks = has_isolate_pageblock(zone);
 
 	/*
@@ -1401,7 +1421,7 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 		__free_one_page(page, page_to_pfn(page), zone, 0, mt);
 		trace_mm_page_pcpu_drain(page, 0, mt);
 	}
-	spin_unlock(&zone->lock);
+	zone_unlock(zone, &zls);
 }
 
 static void free_one_page(struct zone *zone,
@@ -1409,13 +1429,15 @@ static void free_one_page(struct zone *zone,
 				unsigned int order,
 				int migratetype)
 {
-	spin_lock(&zone->lock);
+	struct zone_lock_sample zls;
+
+	zone_lock(zone, &zls);
 	if (unlikely(has_isolate_pageblock(zone) ||
 		is_migrate_isolate(migratetype))) {
 		migratetype = get_pfnblock_migratetype(page, pfn);
 	}
 	__free_one_page(page, pfn, zone, order, migratetype);
-	spin_unlock(&zone->lock);
+	zone_unlock(zone, &zls);
 }
 
 static void __meminit __init_single_page(struct page *page, unsigned long pfn,
@@ -2121,6 +2143,7 @@ static inline void expand(struct zone *zone, struct page *page,
 
 		add_to_free_area(&page[size], area, migratetype);
 		set_page_order(&page[size], high);
+		account_free_zeroed(zone, &page[size], high, 1);
 	}
 }
 
@@ -2277,6 +2300,7 @@ struct page *__rmqueue_smallest(struct zone *zone, unsigned int order,
 		page = get_page_from_free_area(area, migratetype, front);
 		if (!page)
 			continue;
+		account_free_zeroed(zone, page, current_order, -1);
 		del_page_from_free_area(page, area);
 		expand(zone, page, order, current_order, area, migratetype);
 		set_pcppage_migratetype(page, migratetype);
@@ -2822,8 +2846,9 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 			bool front)
 {
 	int i, alloced = 0;
+	struct zone_lock_sample zls;
 
-	spin_lock(&zone->lock);
+	zone_lock(zone, &zls);
 	for (i = 0; i < count; ++i) {
 		struct page *page = __rmqueue(zone, order, migratetype,
 						alloc_flags, front);
@@ -2857,7 +2882,7 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 	 * pages added to the pcp list.
 	 */
 	__mod_zone_page_state(zone, NR_FREE_PAGES, -(i << order));
-	spin_unlock(&zone->lock);
+	zone_unlock(zone, &zls);
 	return alloced;
 }
 
@@ -3239,6 +3264,7 @@ int __isolate_free_page(struct page *page, unsigned int order)
 
 	/* Remove page from free list */
 
+	account_free_zeroed(zone, page, order, -1);
 	del_page_from_free_area(page, area);
 
 	/*
@@ -3346,6 +3372,7 @@ struct page *rmqueue(struct zone *preferred_zone,
 {
 	unsigned long flags;
 	struct page *page;
+	struct zone_lock_sample zls;
 
 	if (likely(order == 0)) {
 		page = rmqueue_pcplist(preferred_zone, zone, gfp_flags,
@@ -3358,7 +3385,7 @@ struct page *rmqueue(struct zone *preferred_zone,
 	 * allocate greater than order-1 page units with __GFP_NOFAIL.
 	 */
 	WARN_ON_ONCE((gfp_flags & __GFP_NOFAIL) && (order > 1));
-	spin_lock_irqsave(&zone->lock, flags);
+	zone_lock_irqsave(zone, flags, &zls);
 
 	do {
 		page = NULL;
@@ -3370,6 +3397,7 @@ struct page *rmqueue(struct zone *preferred_zone,
 		if (!page)
 			page = __rmqueue(zone, order, migratetype, alloc_flags, front);
 	} while (page && check_new_pages(page, order));
+	zone_lock_sample_release(zone, &zls);
 	spin_unlock(&zone->lock);
 	if (!page)
 		goto failed;
@@ -3404,6 +3432,77 @@ struct page *rmqueue(struct zone *preferred_zone,
 	return NULL;
 }
 
+/*
+ * See linux/zone_lock_stat.h. Called with zone->lock held, which keeps
+ * concurrent rollovers out. This is racy against other CPUs updating their
+ * counters, but it only needs to be a good estimate.
+ */
+void zone_lock_window_roll(struct zone *zone, u64 now)
+{
+	struct zone_lock_window *w = &zone->lock_window;
+	u64 elapsed = now - w->start_tsc;
+	u64 hold = 0, wait = 0, samples = 0;
+	u64 dhold, dwait, dsamples;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct per_cpu_pageset *p = per_cpu_ptr(zone->pageset, cpu);
+
+		hold += p->lock_hold_cycles;
+		wait += p->lock_wait_cycles;
+		samples += p->lock_samples;
+	}
+
+	// Only one in ZONE_LOCK_SAMPLE_INTERVAL acquisitions is timed.
+	hold *= ZONE_LOCK_SAMPLE_INTERVAL;
+	wait *= ZONE_LOCK_SAMPLE_INTERVAL;
+
+	// The pagesets may have been replaced (e.g. memory hotplug), in
+	// which case we just start over.
+	if (hold >= w->hold_cycles && wait >= w->wait_cycles
+		&& samples >= w->samples && w->start_tsc)
+	{
+		dhold = hold - w->hold_cycles;
+		dwait = wait - w->wait_cycles;
+		dsamples = samples - w->samples;
+
+		write_seqcount_begin(&w->seq);
+		w->load.hold_permille = min_t(u64, 1000,
+					      div64_u64(dhold * 1000, elapsed));
+		w->load.avg_hold_cycles = dsamples ?
+			div64_u64(dhold, dsamples * ZONE_LOCK_SAMPLE_INTERVAL) : 0;
+		w->load.avg_wait_cycles = dsamples ?
+			div64_u64(dwait, dsamples * ZONE_LOCK_SAMPLE_INTERVAL) : 0;
+		write_seqcount_end(&w->seq);
+	}
+
+	w->start_tsc = now;
+	w->hold_cycles = hold;
+	w->wait_cycles = wait;
+	w->samples = samples;
+}
+EXPORT_SYMBOL(zone_lock_window_roll);
+
+void zone_lock_window_read(struct zone *zone, struct zone_lock_load *load)
+{
+	struct zone_lock_window *w = &zone->lock_window;
+	unsigned int seq;
+
+	// Nothing rolls the window over while the lock is idle, so a window
+	// that should have ended long ago means the lock has barely been used.
+	if (rdtsc() - READ_ONCE(w->start_tsc) >=
+	    2 * (u64)tsc_khz * ZONE_LOCK_WINDOW_MS) {
+		memset(load, 0, sizeof(*load));
+		return;
+	}
+
+	do {
+		seq = read_seqcount_begin(&w->seq);
+		*load = w->load;
+	} while (read_seqcount_retry(&w->seq, seq));
+}
+EXPORT_SYMBOL(zone_lock_window_read);
+
 #ifdef CONFIG_FAIL_PAGE_ALLOC
 
 static struct {
@@ -6841,6 +6940,7 @@ static void __meminit zone_init_internals(struct zone *zone, enum zone_type idx,
 	zone->zone_pgdat = NODE_DATA(nid);
 	spin_lock_init(&zone->lock);
 	zone_seqlock_init(zone);
+	seqcount_init(&zone->lock_window.seq);
 	zone_pcp_init(zone);
 }
 
@@ -8830,6 +8930,7 @@ __offline_isolated_pages(unsigned long start_pfn, unsigned long end_pfn)
 		pr_info("remove from free list %lx %d %lx\n",
 			pfn, 1 << order, end_pfn);
 #endif
+		account_free_zeroed(zone, page, order, -1);
 		del_page_from_free_area(page, &zone->free_area[order]);
 		pfn += (1 << order);
 	}
@@ -80,6 +80,7 @@ static struct vfsmount *shm_mnt;
 #include <linux/userfaultfd_k.h>
 #include <linux/rmap.h>
 #include <linux/uuid.h>
+#include <linux/mm_econ.h>
 
 #include <linux/uaccess.h>
 #include <asm/pgtable.h>
@@ -1502,6 +1503,35 @@ static struct page *shmem_alloc_page(gfp_t gfp,
 	return page;
 }
 
+#if defined(CONFIG_MM_ECON) && defined(CONFIG_TRANSPARENT_HUGE_PAGECACHE)
+/*
+ * Ask mm_econ whether a huge page is worth it for @index of @inode. The
+ * benefit comes from the file's profile, which is keyed on file offsets, so
+ * this gives the same answer whether the page is allocated by a fault, by
+ * write() or by fallocate().
+ */
+static bool shmem_econ_huge(struct inode *inode, pgoff_t index)
+{
+	struct mm_cost_delta mm_cost_delta;
+	struct mm_action mm_action;
+
+	if (!mm_econ_is_on())
+		return true;
+
+	mm_action.action = MM_ACTION_PROMOTE_HUGE_FILE;
+	mm_action.address = (u64)round_down(index, HPAGE_PMD_NR) << PAGE_SHIFT;
+	mm_action.huge_page_order = HPAGE_PMD_ORDER;
+	mm_action.inode = inode;
+	mm_estimate_changes(&mm_action, &mm_cost_delta);
+	return mm_decide(&mm_action, &mm_cost_delta);
+}
+#else
+static inline bool shmem_econ_huge(struct inode *inode, pgoff_t index)
+{
+	return true;
+}
+#endif
+
 static struct page *shmem_alloc_and_acct_page(gfp_t gfp,
 		struct inode *inode,
 		pgoff_t index, bool huge)
@@ -1822,15 +1852,19 @@ static int shmem_getpage_gfp(struct inode *inode, pgoff_t index,
 		i_size = round_up(i_size_read(inode), PAGE_SIZE);
 		if (i_size >= HPAGE_PMD_SIZE &&
 		    i_size >> PAGE_SHIFT >= off)
-			goto alloc_huge;
+			break;
 		/* fallthrough */
 	case SHMEM_HUGE_ADVISE:
 		if (sgp_huge == SGP_HUGE)
-			goto alloc_huge;
+			break;
 		/* TODO: implement fadvise() hints */
 		goto alloc_nohuge;
 	}
 
+	/* The mount policy allows a huge page, but is it worth it? */
+	if (!shmem_econ_huge(inode, index))
+		goto alloc_nohuge;
+
 alloc_huge:
 	page = shmem_alloc_and_acct_page(gfp, inode, index, true);
 	if (IS_ERR(page)) {
@@ -28,6 +28,7 @@
 #include <linux/mm_inline.h>
 #include <linux/page_ext.h>
 #include <linux/page_owner.h>
+#include <linux/zone_lock_stat.h>
 
 #include "internal.h"
 
@@ -1110,6 +1111,7 @@ int fragmentation_index(struct zone *zone, unsigned int order)
 const char * const vmstat_text[] = {
 	/* enum zone_stat_item countes */
 	"nr_free_pages",
+	"nr_free_zeroed_pages",
 	"nr_zone_inactive_anon",
 	"nr_zone_active_anon",
 	"nr_zone_inactive_file",
@@ -1183,6 +1185,8 @@ const char * const vmstat_text[] = {
 	TEXTS_FOR_ZONES("pgalloc")
 	TEXTS_FOR_ZONES("allocstall")
 	TEXTS_FOR_ZONES("pgskip")
+	"pgalloc_zeroed_hit",
+	"pgalloc_zeroed_miss",
 
 	"pgfree",
 	"pgactivate",
@@ -1632,6 +1636,18 @@ static void zoneinfo_show_print(struct seq_file *m, pg_data_t *pgdat,
 		   "\n  start_pfn:           %lu",
 		   pgdat->kswapd_failures >= MAX_RECLAIM_RETRIES,
 		   zone->zone_start_pfn);
+	if (populated_zone(zone)) {
+		struct zone_lock_load load;
+
+		zone_lock_window_read(zone, &load);
+		seq_printf(m,
+			   "\n  lock_hold_permille:  %u"
+			   "\n  lock_avg_hold:       %llu"
+			   "\n  lock_avg_wait:       %llu",
+			   load.hold_permille,
+			   load.avg_hold_cycles,
+			   load.avg_wait_cycles);
+	}
 	seq_putc(m, '\n');
 }
 
@@ -0,0 +1,5 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * mm/estimator.c, built against the shims in this directory.
+ */
+#include "../../mm/estimator.c"
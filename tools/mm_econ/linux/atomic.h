@@ -0,0 +1,37 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _MM_ECON_SHIM_ATOMIC_H
+#define _MM_ECON_SHIM_ATOMIC_H
+
+#include <linux/types.h>
+
+/* The harness is single threaded. */
+typedef struct {
+	s64 counter;
+} atomic64_t;
+
+#define ATOMIC64_INIT(i)	{ (i) }
+
+static inline s64 atomic64_read(const atomic64_t *v)
+{
+	return v->counter;
+}
+
+static inline void atomic64_set(atomic64_t *v, s64 i)
+{
+	v->counter = i;
+}
+
+static inline void atomic64_add(s64 i, atomic64_t *v)
+{
+	v->counter += i;
+}
+
+static inline s64 atomic64_xchg(atomic64_t *v, s64 i)
+{
+	s64 old = v->counter;
+
+	v->counter = i;
+	return old;
+}
+
+#endif /* _MM_ECON_SHIM_ATOMIC_H */
@@ -0,0 +1,12 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _MM_ECON_SHIM_CPUSET_H
+#define _MM_ECON_SHIM_CPUSET_H
+
+#include <linux/types.h>
+
+static inline bool cpuset_node_allowed(int node, gfp_t gfp_mask)
+{
+	return true;
+}
+
+#endif /* _MM_ECON_SHIM_CPUSET_H */
@@ -0,0 +1,7 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _MM_ECON_SHIM_ERROR_INJECTION_H
+#define _MM_ECON_SHIM_ERROR_INJECTION_H
+
+#define ALLOW_ERROR_INJECTION(fname, _etype)
+
+#endif /* _MM_ECON_SHIM_ERROR_INJECTION_H */
@@ -0,0 +1,41 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _MM_ECON_SHIM_FS_H
+#define _MM_ECON_SHIM_FS_H
+
+#include <string.h>
+#include <sys/types.h>
+#include <linux/types.h>
+#include <linux/compiler.h>
+
+/* A proc file is identified by the pid of the /proc/<pid> directory. */
+struct inode {
+	pid_t pid;
+};
+
+struct file {
+	struct inode *f_inode;
+};
+
+struct file_operations {
+	ssize_t (*read)(struct file *, char __user *, size_t, loff_t *);
+	ssize_t (*write)(struct file *, const char __user *, size_t, loff_t *);
+	loff_t (*llseek)(struct file *, loff_t, int);
+};
+
+static inline struct inode *file_inode(const struct file *f)
+{
+	return f->f_inode;
+}
+
+loff_t default_llseek(struct file *file, loff_t offset, int whence);
+ssize_t simple_read_from_buffer(void __user *to, size_t count, loff_t *ppos,
+				const void *from, size_t available);
+
+static inline unsigned long copy_from_user(void *to, const void __user *from,
+					   unsigned long n)
+{
+	memcpy(to, from, n);
+	return 0;
+}
+
+#endif /* _MM_ECON_SHIM_FS_H */
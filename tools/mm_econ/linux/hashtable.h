@@ -0,0 +1,2 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Nothing: the estimator includes this but doesn't use it. */
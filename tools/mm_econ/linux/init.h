@@ -0,0 +1,10 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _MM_ECON_SHIM_INIT_H
+#define _MM_ECON_SHIM_INIT_H
+
+#define __init
+
+/* There is one initcall (mm_econ_init); shim_init() calls it. */
+#define subsys_initcall(fn) int (*shim_initcall)(void) = fn
+
+#endif /* _MM_ECON_SHIM_INIT_H */
@@ -0,0 +1,16 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _MM_ECON_SHIM_JIFFIES_H
+#define _MM_ECON_SHIM_JIFFIES_H
+
+/*
+ * Simulated time, in milliseconds. It only moves when the replay driver
+ * advances it with shim_advance_time().
+ */
+#define HZ 1000
+
+extern unsigned long jiffies;
+
+#define msecs_to_jiffies(m)	((unsigned long)(m))
+#define time_after_eq(a, b)	((long)((a) - (b)) >= 0)
+
+#endif /* _MM_ECON_SHIM_JIFFIES_H */
@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _MM_ECON_SHIM_KOBJECT_H
+#define _MM_ECON_SHIM_KOBJECT_H
+
+#include <sys/types.h>
+#include <stdbool.h>
+#include <linux/stringify.h>
+
+struct kobject {
+	const char *name;
+	const struct attribute_group *group;
+};
+
+struct attribute {
+	const char *name;
+	unsigned short mode;
+};
+
+struct kobj_attribute {
+	struct attribute attr;
+	ssize_t (*show)(struct kobject *kobj, struct kobj_attribute *attr,
+			char *buf);
+	ssize_t (*store)(struct kobject *kobj, struct kobj_attribute *attr,
+			 const char *buf, size_t count);
+};
+
+#define __ATTR(_name, _mode, _show, _store) {				\
+	.attr = {.name = __stringify(_name), .mode = _mode },		\
+	.show	= _show,						\
+	.store	= _store,						\
+}
+
+struct attribute_group {
+	const char *name;
+	struct attribute **attrs;
+};
+
+extern struct kobject *mm_kobj;
+
+struct kobject *kobject_create_and_add(const char *name, struct kobject *parent);
+void kobject_put(struct kobject *kobj);
+int sysfs_create_group(struct kobject *kobj, const struct attribute_group *grp);
+bool sysfs_streq(const char *s1, const char *s2);
+
+#endif /* _MM_ECON_SHIM_KOBJECT_H */
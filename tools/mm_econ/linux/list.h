@@ -0,0 +1,11 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _MM_ECON_SHIM_LIST_H
+#define _MM_ECON_SHIM_LIST_H
+
+#include "../../include/linux/list.h"
+
+#define list_last_entry_or_null(ptr, type, member) ({ \
+	list_empty(ptr) ? NULL : list_last_entry(ptr, type, member) ;\
+})
+
+#endif /* _MM_ECON_SHIM_LIST_H */
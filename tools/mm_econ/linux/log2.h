@@ -0,0 +1,7 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _MM_ECON_SHIM_LOG2_H
+#define _MM_ECON_SHIM_LOG2_H
+
+#define ilog2(n)	((int)(63 - __builtin_clzll((unsigned long long)(n))))
+
+#endif /* _MM_ECON_SHIM_LOG2_H */
@@ -0,0 +1,19 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _MM_ECON_SHIM_MEMCONTROL_H
+#define _MM_ECON_SHIM_MEMCONTROL_H
+
+/*
+ * There are no memcgs here (CONFIG_MEMCG is off), so every task runs with the
+ * global mm_econ mode. The estimator still takes the RCU read lock around its
+ * memcg lookups.
+ */
+
+static inline void rcu_read_lock(void)
+{
+}
+
+static inline void rcu_read_unlock(void)
+{
+}
+
+#endif /* _MM_ECON_SHIM_MEMCONTROL_H */
@@ -0,0 +1,2 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Nothing: the harness builds without CONFIG_NUMA. */
@@ -0,0 +1,59 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _MM_ECON_SHIM_MM_H
+#define _MM_ECON_SHIM_MM_H
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/kernel.h>
+#include <linux/compiler.h>
+#include <linux/export.h>
+#include <linux/types.h>
+#include <linux/list.h>
+#include <linux/rbtree.h>
+#include <linux/printk.h>
+#include <linux/spinlock.h>
+#include <linux/mmzone.h>
+#include <linux/topology.h>
+#include <linux/sched/task.h>
+
+#define PAGE_SHIFT	12
+#define PAGE_SIZE	(1UL << PAGE_SHIFT)
+#define PAGE_MASK	(~(PAGE_SIZE - 1))
+#define HPAGE_SHIFT	21
+
+#ifndef U64_MAX
+#define U64_MAX		((u64)~0ULL)
+#endif
+
+#define GFP_TRANSHUGE_LIGHT	GFP_KERNEL
+
+extern int shim_nr_cpus;
+#define num_online_cpus()	(shim_nr_cpus)
+
+void *vmalloc(unsigned long size);
+void vfree(const void *addr);
+
+static inline int kstrtoull(const char *s, unsigned int base, u64 *res)
+{
+	char *end;
+
+	*res = strtoull(s, &end, base);
+	if (end == s || (*end && *end != '\n'))
+		return -EINVAL;
+	return 0;
+}
+
+#define kstrtou64 kstrtoull
+
+static inline int kstrtoint(const char *s, unsigned int base, int *res)
+{
+	char *end;
+
+	*res = strtol(s, &end, base);
+	if (end == s || (*end && *end != '\n'))
+		return -EINVAL;
+	return 0;
+}
+
+#endif /* _MM_ECON_SHIM_MM_H */
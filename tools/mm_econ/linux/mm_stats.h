@@ -0,0 +1,22 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _MM_ECON_SHIM_MM_STATS_H
+#define _MM_ECON_SHIM_MM_STATS_H
+
+#include <assert.h>
+#include <linux/types.h>
+
+#define DECLARE_PER_CPU(type, name)	extern type name
+#define get_cpu_var(var)		(var)
+
+struct pt_regs;
+
+#include "../../../include/linux/mm_stats.h"
+
+/* Only the estimator's histograms are kept, as plain summaries. */
+struct mm_hist {
+	u64 count;
+	u64 sum;
+	u64 max;
+};
+
+#endif /* _MM_ECON_SHIM_MM_STATS_H */
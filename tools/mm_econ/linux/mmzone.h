@@ -0,0 +1,115 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _MM_ECON_SHIM_MMZONE_H
+#define _MM_ECON_SHIM_MMZONE_H
+
+/*
+ * Just enough of the zone and node layout for the estimator to look at free
+ * huge pages and zone->lock load. The replay driver fills these in through
+ * the shim_*() calls in shim.h.
+ */
+
+#include <linux/types.h>
+#include <linux/list.h>
+#include <linux/numa.h>
+
+#define MAX_ORDER 11
+
+#define MIGRATE_MOVABLE	1
+#define MIGRATE_TYPES	4
+
+enum zone_type {
+	ZONE_DMA,
+	ZONE_DMA32,
+	ZONE_NORMAL,
+	ZONE_MOVABLE,
+	MAX_NR_ZONES
+};
+
+enum node_states {
+	N_MEMORY,
+};
+
+typedef struct {
+	unsigned long bits[(MAX_NUMNODES + 63) / 64];
+} nodemask_t;
+
+#define node_isset(node, nodemask) \
+	(!!((nodemask).bits[(node) / 64] & (1UL << ((node) % 64))))
+
+struct page {
+	unsigned long flags;
+	struct list_head lru;
+};
+
+#define PG_zeroed 0
+
+static inline bool PageZeroed(struct page *page)
+{
+	return page->flags & (1UL << PG_zeroed);
+}
+
+static inline void SetPageZeroed(struct page *page)
+{
+	page->flags |= 1UL << PG_zeroed;
+}
+
+static inline void ClearPageZeroed(struct page *page)
+{
+	page->flags &= ~(1UL << PG_zeroed);
+}
+
+struct free_area {
+	struct list_head free_list[MIGRATE_TYPES];
+	unsigned long nr_free;
+};
+
+/* Keep in sync with include/linux/mmzone.h. */
+struct zone_lock_load {
+	unsigned int hold_permille;
+	u64 avg_hold_cycles;
+	u64 avg_wait_cycles;
+};
+
+struct zone_lock_window {
+	struct zone_lock_load load;
+};
+
+struct pglist_data;
+
+struct zone {
+	struct pglist_data *zone_pgdat;
+	const char *name;
+	bool populated;
+	int lock;
+	unsigned long managed_pages;
+	struct free_area free_area[MAX_ORDER];
+	struct zone_lock_window lock_window;
+};
+
+typedef struct pglist_data {
+	struct zone node_zones[MAX_NR_ZONES];
+	int node_id;
+} pg_data_t;
+
+extern pg_data_t shim_nodes[MAX_NUMNODES];
+extern int shim_nr_nodes;
+
+static inline unsigned long zone_managed_pages(struct zone *zone)
+{
+	return zone->managed_pages;
+}
+
+#define NODE_DATA(nid)	(&shim_nodes[(nid)])
+#define zone_idx(zone)	((zone) - (zone)->zone_pgdat->node_zones)
+
+#define for_each_node_state(node, state) \
+	for ((node) = 0; (node) < shim_nr_nodes; (node)++)
+
+struct zone *shim_next_populated_zone(struct zone *zone);
+
+#define for_each_populated_zone(zone)				\
+	for (zone = shim_next_populated_zone(NULL);		\
+	     zone;						\
+	     zone = shim_next_populated_zone(zone))
+
+#endif /* _MM_ECON_SHIM_MMZONE_H */
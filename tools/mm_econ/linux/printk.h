@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _MM_ECON_SHIM_PRINTK_H
+#define _MM_ECON_SHIM_PRINTK_H
+
+#include <stdio.h>
+
+#define KERN_WARNING ""
+
+/* The estimator is chatty; only print when asked to. */
+extern int shim_verbose;
+
+#define printk(fmt, ...)						\
+	do {								\
+		if (shim_verbose)					\
+			fprintf(stderr, fmt, ##__VA_ARGS__);		\
+	} while (0)
+#define pr_warn printk
+#define pr_info printk
+#define pr_cont printk
+#define pr_err(fmt, ...) fprintf(stderr, fmt, ##__VA_ARGS__)
+#define pr_err_once pr_err
+
+#endif /* _MM_ECON_SHIM_PRINTK_H */
@@ -0,0 +1,12 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _MM_ECON_SHIM_RANGE_H
+#define _MM_ECON_SHIM_RANGE_H
+
+#include <linux/types.h>
+
+struct range {
+	u64	start;
+	u64	end;
+};
+
+#endif /* _MM_ECON_SHIM_RANGE_H */
@@ -0,0 +1,16 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _MM_ECON_SHIM_RWSEM_H
+#define _MM_ECON_SHIM_RWSEM_H
+
+/* The harness is single threaded. */
+struct rw_semaphore {
+	int unused;
+};
+
+#define DECLARE_RWSEM(name) struct rw_semaphore name
+#define down_read(sem)	((void)(sem))
+#define up_read(sem)	((void)(sem))
+#define down_write(sem)	((void)(sem))
+#define up_write(sem)	((void)(sem))
+
+#endif /* _MM_ECON_SHIM_RWSEM_H */
@@ -0,0 +1,11 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _MM_ECON_SHIM_LOADAVG_H
+#define _MM_ECON_SHIM_LOADAVG_H
+
+#define FSHIFT		11
+#define FIXED_1		(1 << FSHIFT)
+#define LOAD_INT(x)	((x) >> FSHIFT)
+
+void get_avenrun(unsigned long *loads, unsigned long offset, int shift);
+
+#endif /* _MM_ECON_SHIM_LOADAVG_H */
@@ -0,0 +1,18 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _MM_ECON_SHIM_TASK_H
+#define _MM_ECON_SHIM_TASK_H
+
+#include <sys/types.h>
+
+struct task_struct {
+	pid_t pid;
+	pid_t tgid;
+};
+
+/* The task on whose behalf the estimator is being asked. */
+extern struct task_struct shim_current;
+#define current (&shim_current)
+
+#define put_task_struct(t) ((void)(t))
+
+#endif /* _MM_ECON_SHIM_TASK_H */
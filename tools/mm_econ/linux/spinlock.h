@@ -0,0 +1,14 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _MM_ECON_SHIM_SPINLOCK_H
+#define _MM_ECON_SHIM_SPINLOCK_H
+
+/* The harness is single threaded. */
+typedef int spinlock_t;
+
+#define DEFINE_SPINLOCK(x)	spinlock_t x
+#define spin_lock(lock)		((void)(lock))
+#define spin_unlock(lock)	((void)(lock))
+#define spin_lock_irqsave(lock, flags)		((void)(lock), (flags) = 0)
+#define spin_unlock_irqrestore(lock, flags)	((void)(lock), (void)(flags))
+
+#endif /* _MM_ECON_SHIM_SPINLOCK_H */
@@ -0,0 +1,16 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _MM_ECON_SHIM_TOPOLOGY_H
+#define _MM_ECON_SHIM_TOPOLOGY_H
+
+#include <linux/numa.h>
+
+#define LOCAL_DISTANCE	10
+#define REMOTE_DISTANCE	20
+
+extern int shim_node_distance[MAX_NUMNODES][MAX_NUMNODES];
+extern int shim_numa_node;
+
+#define node_distance(a, b)	(shim_node_distance[(a)][(b)])
+#define numa_node_id()		(shim_numa_node)
+
+#endif /* _MM_ECON_SHIM_TOPOLOGY_H */
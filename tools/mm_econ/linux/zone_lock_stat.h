@@ -0,0 +1,12 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _MM_ECON_SHIM_ZONE_LOCK_STAT_H
+#define _MM_ECON_SHIM_ZONE_LOCK_STAT_H
+
+#include <linux/mmzone.h>
+
+/* Keep in sync with include/linux/zone_lock_stat.h. */
+#define ZONE_LOCK_WINDOW_MS 10
+
+void zone_lock_window_read(struct zone *zone, struct zone_lock_load *load);
+
+#endif /* _MM_ECON_SHIM_ZONE_LOCK_STAT_H */
@@ -0,0 +1,7 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <linux/rbtree_augmented.h>
+
+/* The tools copy of rbtree_augmented.h has no RCU variants. */
+#define __rb_change_child_rcu __rb_change_child
+
+#include "../../lib/rbtree.c"
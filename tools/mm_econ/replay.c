@@ -0,0 +1,803 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Replay recorded memory management events through the mm_econ estimator
+ * and report the decisions it makes.
+ *
+ * Usage: replay [-v] [-f freq_mhz] [-k kbadgerd_results] [-p pftrace]
+ *               [-i prezero_interval_ms] [-c prezero_count] [events]
+ *
+ * The events file is a text stream with one event per line. Blank lines and
+ * anything after a '#' are ignored. Numbers may be given in any base strtoull
+ * understands.
+ *
+ *   Machine state:
+ *     nodes <n>                        number of NUMA nodes (default 1)
+ *     distance <from> <to> <distance>  node distance (default 10/20)
+ *     free <nid> <nr_free> <nr_zeroed> free 2MB pages on a node
+ *     managed <nid> <nr_pages>         total 4KB pages on a node (default 16GB)
+ *     load <nr_cpus> <nr_running>      load average seen by daemon costs
+ *     zonelock <nid> <permille> <avg_hold> <avg_wait>
+ *                                      zone->lock window of a node
+ *     prezeroed_used <n>               prezeroed pages used per LTU
+ *     knob <name> <value>              write /sys/kernel/mm/mm_econ/<name>
+ *     tick <ms>                        advance time, e.g. to the next LTU
+ *
+ *   Process events:
+ *     filter <pid> <filter>            append a line to /proc/<pid>/mmap_filters
+ *     mmap <pid> <section> <mapaddr> <section_off> <addr> <len> <prot>
+ *          <flags> <fd> <off>          a new mapping (section: code, data,
+ *                                      heap or mmap), as passed to
+ *                                      mm_add_memory_range()
+ *     brk <pid> <oldbrk> <newbrk>      heap growth
+ *     fault <pid> <addr> [<nid>]       an anonymous fault that may be huge,
+ *                                      on a CPU of the given node
+ *     gfault <pid> <addr> [<nid>]      a fault in a region that may be mapped
+ *                                      with a 1GB page, falling back to a
+ *                                      2MB fault if the estimator says no
+ *     filemap <pid> <file> <mapaddr> <len> <pgoff>
+ *                                      the mapping at mapaddr (added with
+ *                                      mmap first) is of a shmem file, given
+ *                                      as a small integer id
+ *     filefault <file> <off> [<nid>]   a shmem page cache allocation at byte
+ *                                      offset off that may be huge
+ *     fork <parent> <child>            copy the parent's profile
+ *     exit <pid>                       drop the profile
+ *     prezero <n>                      ask whether to prezero n huge pages
+ *     ranges <pid>                     print /proc/<pid>/mem_ranges
+ *
+ * With -k, the binary export of /proc/kbadgerd_results_raw is registered
+ * as the TLB miss estimator for its pid, just like kbadgerd does while it is
+ * running.
+ *
+ * With -p, the faults in a pftrace file are replayed in time order after the
+ * events file. Every prezero interval, the estimator is asked whether
+ * asynczero should zero another batch of pages, with prezeroed_used set from
+ * the rate of huge page faults in the trace. Each huge page fault takes a page
+ * from node 0's free pool, so the pool should be set up in the events file.
+ * Time advances by one prezero interval at a time as the trace goes on. Both
+ * versioned traces and the old headerless ones are accepted.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/mm.h>
+#include <linux/mm_econ.h>
+#include <linux/mm_stats.h>
+#include <linux/range.h>
+
+#include "../../include/uapi/linux/kbadgerd.h"
+#include "../../include/uapi/linux/pftrace.h"
+#include "shim.h"
+
+#define MAP_ANONYMOUS_FLAG	0x20
+#define MAP_POPULATE_FLAG	0x8000
+#define HUGE_PAGE_ORDER		9
+#define GIGANTIC_PAGE_ORDER	18
+#define MAX_FILES		64
+
+extern const struct file_operations proc_mmap_filters_operations;
+extern const struct file_operations proc_mem_ranges_operations;
+
+static u64 freq_mhz = 3000;
+static u64 prezero_interval_ms = 1000;
+static u64 prezero_count = 10;
+
+///////////////////////////////////////////////////////////////////////////////
+// Results.
+
+enum replay_action {
+	RA_PROMOTE,
+	RA_PROMOTE_GIGANTIC,
+	RA_PROMOTE_FILE,
+	RA_EAGER,
+	RA_PREZERO,
+	RA_NR,
+};
+
+static const char *const replay_action_names[RA_NR] = {
+	[RA_PROMOTE]	= "promote_huge",
+	[RA_PROMOTE_GIGANTIC] = "promote_gigantic",
+	[RA_PROMOTE_FILE] = "promote_file",
+	[RA_EAGER]	= "eager_paging",
+	[RA_PREZERO]	= "run_prezeroing",
+};
+
+struct replay_stats {
+	u64 decisions;
+	u64 yes;
+	s64 savings;	/* sum of benefit - cost over yes decisions */
+};
+
+static struct replay_stats stats[RA_NR];
+static u64 decide_ns;
+
+static u64 hp_placed, hp_placed_remote, hp_placed_zeroed, hp_no_memory;
+static u64 eager_bytes;
+static u64 pf_huge, pf_huge_zeroed;
+static u64 nr_events, nr_pftrace;
+
+/* Files are only compared by inode address, so any distinct inodes will do. */
+static struct inode files[MAX_FILES];
+
+static u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* Estimate and decide, recording the outcome under `ra`. */
+static bool replay_decide(enum replay_action ra, const struct mm_action *action,
+			  struct mm_cost_delta *cost)
+{
+	u64 start;
+	bool yes;
+
+	memset(cost, 0, sizeof(*cost));
+
+	start = now_ns();
+	mm_estimate_changes(action, cost);
+	yes = mm_decide(action, cost);
+	decide_ns += now_ns() - start;
+
+	stats[ra].decisions++;
+	if (yes) {
+		stats[ra].yes++;
+		stats[ra].savings += (s64)(cost->benefit - cost->cost);
+	}
+
+	return yes;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Events.
+
+/* Take a free huge page for a yes decision. False if there are none. */
+static bool replay_place_huge_page(const struct mm_cost_delta *cost)
+{
+	bool zeroed;
+	int target;
+
+	target = cost->nid == NUMA_NO_NODE ? numa_node_id() : cost->nid;
+	if (!shim_take_huge_page(target, &zeroed)) {
+		hp_no_memory++;
+		return false;
+	}
+
+	hp_placed++;
+	if (target != numa_node_id())
+		hp_placed_remote++;
+	if (zeroed)
+		hp_placed_zeroed++;
+	return true;
+}
+
+static void replay_fault(pid_t pid, u64 addr, int nid)
+{
+	struct mm_action action = {
+		.action = MM_ACTION_PROMOTE_HUGE,
+		.address = addr & ~((1ull << HPAGE_SHIFT) - 1),
+		.huge_page_order = HUGE_PAGE_ORDER,
+	};
+	struct mm_cost_delta cost;
+
+	shim_set_current(pid, nid);
+
+	if (replay_decide(RA_PROMOTE, &action, &cost) &&
+	    replay_place_huge_page(&cost))
+		mm_register_promotion(NULL, action.address);
+}
+
+/* Like shmem_getpage_gfp() when the mount policy allows a huge page. */
+static void replay_file_fault(struct inode *inode, u64 off, int nid)
+{
+	struct mm_action action = {
+		.action = MM_ACTION_PROMOTE_HUGE_FILE,
+		.address = off & ~((1ull << HPAGE_SHIFT) - 1),
+		.huge_page_order = HUGE_PAGE_ORDER,
+		.inode = inode,
+	};
+	struct mm_cost_delta cost;
+
+	if (nid >= 0)
+		shim_set_current(current->tgid, nid);
+
+	if (replay_decide(RA_PROMOTE_FILE, &action, &cost))
+		replay_place_huge_page(&cost);
+}
+
+/*
+ * Like the PUD level of __handle_mm_fault(). A 1GB page isn't taken from the
+ * 2MB free pool, since the estimator expects it to be carved out of the rest
+ * of the node.
+ */
+static void replay_gigantic_fault(pid_t pid, u64 addr, int nid)
+{
+	struct mm_action action = {
+		.action = MM_ACTION_PROMOTE_HUGE,
+		.address = addr & ~((1ull << (PAGE_SHIFT + GIGANTIC_PAGE_ORDER)) - 1),
+		.huge_page_order = GIGANTIC_PAGE_ORDER,
+	};
+	struct mm_cost_delta cost;
+
+	shim_set_current(pid, nid);
+
+	if (replay_decide(RA_PROMOTE_GIGANTIC, &action, &cost))
+		mm_register_promotion(NULL, action.address);
+	else
+		replay_fault(pid, addr, nid);
+}
+
+static void replay_eager(u64 addr, u64 len)
+{
+	struct mm_action action = {
+		.action = MM_ACTION_EAGER_PAGING,
+		.address = addr,
+		.len = len,
+	};
+	struct mm_cost_delta cost;
+	struct range *ranges;
+	bool yes;
+	int i;
+
+	if (!mm_econ_is_on() || !mm_process_is_using_cbmm(current->tgid))
+		return;
+
+	yes = replay_decide(RA_EAGER, &action, &cost);
+	ranges = (struct range *)cost.extra;
+	if (!ranges)
+		return;
+
+	for (i = 0; yes && ranges[i].start != -1 && ranges[i].end != -1; i++)
+		eager_bytes += ranges[i].end - ranges[i].start;
+
+	vfree(ranges);
+}
+
+/* Zero up to n free huge pages, like asynczero would. */
+static void replay_prezero(u64 n)
+{
+	struct mm_action action = {
+		.action = MM_ACTION_RUN_PREZEROING,
+		.prezero_n = n,
+	};
+	struct mm_cost_delta cost;
+	unsigned long nr_free, nr_zeroed, todo;
+	int nid;
+
+	if (!replay_decide(RA_PREZERO, &action, &cost))
+		return;
+
+	for (nid = 0; nid < shim_nr_nodes && n; nid++) {
+		shim_get_free_huge_pages(nid, &nr_free, &nr_zeroed);
+		todo = min((u64)(nr_free - nr_zeroed), n);
+		shim_set_free_huge_pages(nid, nr_free, nr_zeroed + todo);
+		n -= todo;
+	}
+}
+
+static int parse_section(const char *s, enum mm_memory_section *section)
+{
+	if (!strcmp(s, "code"))
+		*section = SectionCode;
+	else if (!strcmp(s, "data"))
+		*section = SectionData;
+	else if (!strcmp(s, "heap"))
+		*section = SectionHeap;
+	else if (!strcmp(s, "mmap"))
+		*section = SectionMmap;
+	else
+		return -EINVAL;
+	return 0;
+}
+
+#define MAX_ARGS 12
+
+static int replay_line(char *line, const char *fname, int lineno)
+{
+	char *argv[MAX_ARGS], *rest = NULL, *p;
+	u64 v[MAX_ARGS] = { 0 };
+	enum mm_memory_section section;
+	char buf[1 << 16];
+	int argc = 0, i;
+	ssize_t ret;
+
+	if ((p = strchr(line, '#')))
+		*p = '\0';
+
+	while (argc < MAX_ARGS && (p = strsep(&line, " \t\n"))) {
+		if (!*p)
+			continue;
+		argv[argc++] = p;
+		/* filter lines keep everything after the pid as is */
+		if (argc == 2 && !strcmp(argv[0], "filter")) {
+			rest = line;
+			break;
+		}
+	}
+	if (!argc)
+		return 0;
+
+	for (i = 1; i < argc; i++)
+		v[i] = strtoull(argv[i], NULL, 0);
+
+	nr_events++;
+
+#define NEED(n)								\
+	do {								\
+		if (argc < (n) + 1) {					\
+			fprintf(stderr, "%s:%d: %s needs %d arguments\n",\
+				fname, lineno, argv[0], (n));		\
+			return -EINVAL;					\
+		}							\
+	} while (0)
+
+	if (!strcmp(argv[0], "nodes")) {
+		NEED(1);
+		if (v[1] < 1 || v[1] > MAX_NUMNODES) {
+			fprintf(stderr, "%s:%d: at most %d nodes\n",
+				fname, lineno, MAX_NUMNODES);
+			return -EINVAL;
+		}
+		shim_set_nr_nodes(v[1]);
+	} else if (!strcmp(argv[0], "distance")) {
+		NEED(3);
+		shim_set_node_distance(v[1], v[2], v[3]);
+	} else if (!strcmp(argv[0], "free")) {
+		NEED(3);
+		shim_set_free_huge_pages(v[1], v[2], v[3]);
+	} else if (!strcmp(argv[0], "managed")) {
+		NEED(2);
+		shim_set_managed_pages(v[1], v[2]);
+	} else if (!strcmp(argv[0], "load")) {
+		NEED(2);
+		shim_set_load(v[1], v[2]);
+	} else if (!strcmp(argv[0], "zonelock")) {
+		NEED(4);
+		shim_set_zone_lock(v[1], v[2], v[3], v[4]);
+	} else if (!strcmp(argv[0], "prezeroed_used")) {
+		NEED(1);
+		shim_set_prezeroed_used(v[1]);
+	} else if (!strcmp(argv[0], "knob")) {
+		NEED(2);
+		ret = shim_sysfs_write(argv[1], argv[2]);
+		if (ret < 0) {
+			fprintf(stderr, "%s:%d: knob %s: %s\n", fname, lineno,
+				argv[1], strerror(-ret));
+			return ret;
+		}
+		if (!strcmp(argv[1], "freq_mhz"))
+			freq_mhz = v[2];
+	} else if (!strcmp(argv[0], "tick")) {
+		NEED(1);
+		shim_advance_time(v[1]);
+	} else if (!strcmp(argv[0], "filter")) {
+		NEED(1);
+		if (!rest || !*rest) {
+			fprintf(stderr, "%s:%d: empty filter\n", fname, lineno);
+			return -EINVAL;
+		}
+		snprintf(buf, sizeof(buf), "%s\n", strsep(&rest, "\n"));
+		ret = shim_proc_write(&proc_mmap_filters_operations, v[1],
+				      buf, strlen(buf));
+		if (ret < 0) {
+			fprintf(stderr, "%s:%d: bad filter\n", fname, lineno);
+			return ret;
+		}
+	} else if (!strcmp(argv[0], "mmap")) {
+		NEED(10);
+		if (parse_section(argv[2], &section)) {
+			fprintf(stderr, "%s:%d: bad section %s\n", fname,
+				lineno, argv[2]);
+			return -EINVAL;
+		}
+		shim_set_current(v[1], -1);
+		mm_add_memory_range(v[1], section, v[3], v[4], v[5], v[6],
+				    v[7], v[8], v[9], v[10]);
+		/* File mappings are read ahead unless already populated. */
+		if (section == SectionMmap && ((v[8] & MAP_ANONYMOUS_FLAG) ||
+					       !(v[8] & MAP_POPULATE_FLAG)))
+			replay_eager(v[3], v[6]);
+	} else if (!strcmp(argv[0], "brk")) {
+		NEED(3);
+		shim_set_current(v[1], -1);
+		if (v[3] > v[2])
+			replay_eager(v[2], v[3] - v[2]);
+	} else if (!strcmp(argv[0], "fault")) {
+		NEED(2);
+		replay_fault(v[1], v[2], argc > 3 ? (int)v[3] : -1);
+	} else if (!strcmp(argv[0], "gfault")) {
+		NEED(2);
+		replay_gigantic_fault(v[1], v[2], argc > 3 ? (int)v[3] : -1);
+	} else if (!strcmp(argv[0], "filemap")) {
+		NEED(5);
+		if (v[2] >= MAX_FILES)
+			goto bad_file;
+		mm_add_file_range(v[1], &files[v[2]], v[3], v[4], v[5]);
+	} else if (!strcmp(argv[0], "filefault")) {
+		NEED(2);
+		if (v[1] >= MAX_FILES)
+			goto bad_file;
+		replay_file_fault(&files[v[1]], v[2], argc > 3 ? (int)v[3] : -1);
+	} else if (!strcmp(argv[0], "fork")) {
+		NEED(2);
+		mm_copy_profile(v[1], v[2]);
+	} else if (!strcmp(argv[0], "exit")) {
+		NEED(1);
+		mm_profile_check_exiting_proc(v[1]);
+	} else if (!strcmp(argv[0], "prezero")) {
+		NEED(1);
+		replay_prezero(v[1]);
+	} else if (!strcmp(argv[0], "ranges")) {
+		NEED(1);
+		ret = shim_proc_read(&proc_mem_ranges_operations, v[1],
+				     buf, sizeof(buf) - 1);
+		if (ret > 0) {
+			buf[ret] = '\0';
+			printf("ranges of %llu:\n%s", v[1], buf);
+		}
+	} else {
+		fprintf(stderr, "%s:%d: unknown event %s\n", fname, lineno,
+			argv[0]);
+		return -EINVAL;
+	}
+#undef NEED
+
+	return 0;
+
+bad_file:
+	fprintf(stderr, "%s:%d: file ids must be below %d\n", fname, lineno,
+		MAX_FILES);
+	return -EINVAL;
+}
+
+static int replay_events(const char *fname)
+{
+	FILE *f = strcmp(fname, "-") ? fopen(fname, "r") : stdin;
+	char *line = NULL;
+	size_t len = 0;
+	int lineno = 0, ret = 0;
+
+	if (!f) {
+		perror(fname);
+		return -errno;
+	}
+
+	while (getline(&line, &len, f) >= 0) {
+		ret = replay_line(line, fname, ++lineno);
+		if (ret)
+			break;
+	}
+
+	free(line);
+	if (f != stdin)
+		fclose(f);
+	return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// kbadgerd results.
+
+static struct kbadgerd_results_header kb_header;
+static struct kbadgerd_result *kb_results;
+
+static u64 kb_total_misses(const struct kbadgerd_result *r)
+{
+	return r->dtlb_4kb_load_misses + r->dtlb_4kb_store_misses
+		+ r->dtlb_2mb_load_misses + r->dtlb_2mb_store_misses
+		+ r->dtlb_1gb_load_misses + r->dtlb_1gb_store_misses;
+}
+
+static const struct kbadgerd_result *kb_search(u64 addr, bool old)
+{
+	u32 i;
+
+	for (i = 0; i < kb_header.nr_records; i++) {
+		const struct kbadgerd_result *r = &kb_results[i];
+
+		if (!!(r->flags & KBADGERD_RESULT_OLD) != old)
+			continue;
+		if (r->start <= addr && addr < r->end)
+			return r;
+	}
+
+	return NULL;
+}
+
+/* Same as kbadgerd's tlb_miss_est_fn, but from the exported results. */
+static u64 kb_tlb_miss_est_fn(const struct mm_action *action)
+{
+	const struct kbadgerd_result *r, *old;
+	u64 npages, ret;
+
+	if (kb_header.pid && current->tgid != kb_header.pid)
+		return 0;
+
+	r = kb_search(action->address, false);
+	if (!r || kb_total_misses(r) == 0) {
+		old = kb_search(action->address, true);
+		if (old)
+			r = old;
+	}
+	if (!r)
+		return 0;
+
+	npages = (r->end - r->start) >> HPAGE_SHIFT;
+	ret = kb_total_misses(r) / (npages ? npages : 1);
+	if (ret > 0 && kb_header.sleep_interval_ms)
+		ret = ret * kb_header.ltu_ms / ((u64)kb_header.sleep_interval_ms
+			* (r->nsamples ? r->nsamples : 1));
+
+	return ret;
+}
+
+static int load_kbadgerd_results(const char *fname)
+{
+	FILE *f = fopen(fname, "r");
+	char *rec;
+	u32 i;
+	int ret = -EINVAL;
+
+	if (!f) {
+		perror(fname);
+		return -errno;
+	}
+
+	if (fread(&kb_header, sizeof(kb_header), 1, f) != 1
+	    || kb_header.magic != KBADGERD_RESULTS_MAGIC
+	    || kb_header.record_size < KBADGERD_RESULT_V1_SIZE) {
+		fprintf(stderr, "%s: not a kbadgerd results file\n", fname);
+		goto out;
+	}
+
+	kb_results = calloc(kb_header.nr_records ?: 1, sizeof(*kb_results));
+	rec = malloc(kb_header.record_size);
+	if (!kb_results || !rec) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < kb_header.nr_records; i++) {
+		if (fread(rec, kb_header.record_size, 1, f) != 1) {
+			fprintf(stderr, "%s: truncated at record %u\n", fname, i);
+			free(rec);
+			goto out;
+		}
+		memcpy(&kb_results[i], rec,
+		       min((size_t)kb_header.record_size, sizeof(*kb_results)));
+	}
+	free(rec);
+
+	register_mm_econ_tlb_miss_estimator(kb_tlb_miss_est_fn);
+	ret = 0;
+out:
+	fclose(f);
+	return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pftrace.
+
+static int pftrace_cmp(const void *a, const void *b)
+{
+	const struct mm_stats_pftrace *ta = a, *tb = b;
+
+	return ta->start_tsc < tb->start_tsc ? -1 : ta->start_tsc > tb->start_tsc;
+}
+
+static bool pftrace_wants_zeroed_huge_page(const struct mm_stats_pftrace *t)
+{
+	return (t->bitflags & (1ull << MM_STATS_PF_HUGE_PAGE))
+		&& !(t->bitflags & (1ull << MM_STATS_PF_HUGE_PROMOTION))
+		&& !(t->bitflags & (1ull << MM_STATS_PF_ZERO));
+}
+
+/*
+ * Version 0 traces are bare records, so if the file doesn't start with a
+ * header, go back to the start and read it as one of those.
+ */
+static int pftrace_read_header(FILE *f, const char *fname, size_t *record_size)
+{
+	struct pftrace_header h;
+
+	if (fread(&h, sizeof(h), 1, f) != 1 || h.magic != PFTRACE_MAGIC) {
+		*record_size = PFTRACE_RECORD_V0_SIZE;
+		rewind(f);
+		return 0;
+	}
+
+	if (h.record_size < PFTRACE_RECORD_V0_SIZE) {
+		fprintf(stderr, "%s: bad record size %u\n", fname, h.record_size);
+		return -EINVAL;
+	}
+
+	*record_size = h.record_size;
+	return 0;
+}
+
+static int replay_pftrace(const char *fname)
+{
+	FILE *f = fopen(fname, "r");
+	struct mm_stats_pftrace *traces = NULL;
+	size_t n = 0, cap = 0, i, tail = 0, record_size;
+	u64 interval, ltu, next, used = 0;
+	char record[256];
+	bool zeroed;
+	int err;
+
+	if (!f) {
+		perror(fname);
+		return -errno;
+	}
+
+	err = pftrace_read_header(f, fname, &record_size);
+	if (err) {
+		fclose(f);
+		return err;
+	}
+
+	for (;;) {
+		if (n == cap) {
+			cap = cap ? cap * 2 : 4096;
+			traces = realloc(traces, cap * sizeof(*traces));
+			if (!traces) {
+				fclose(f);
+				return -ENOMEM;
+			}
+		}
+		if (record_size > sizeof(record)) {
+			if (fread(record, sizeof(record), 1, f) != 1 ||
+			    fseek(f, record_size - sizeof(record), SEEK_CUR))
+				break;
+		} else if (fread(record, record_size, 1, f) != 1) {
+			break;
+		}
+		memset(&traces[n], 0, sizeof(*traces));
+		memcpy(&traces[n], record, min(record_size, sizeof(*traces)));
+		n++;
+	}
+	fclose(f);
+
+	qsort(traces, n, sizeof(*traces), pftrace_cmp);
+
+	interval = prezero_interval_ms * freq_mhz * 1000;
+	ltu = (u64)MM_ECON_LTU * freq_mhz * 1000;
+	next = n ? traces[0].start_tsc + interval : 0;
+
+	for (i = 0; i < n; i++) {
+		const struct mm_stats_pftrace *t = &traces[i];
+
+		while (t->start_tsc >= next) {
+			/* Huge page faults over the trailing LTU. */
+			for (; tail < i && traces[tail].start_tsc + ltu < next;
+			     tail++)
+				if (pftrace_wants_zeroed_huge_page(&traces[tail]))
+					used--;
+			shim_set_prezeroed_used(used);
+			replay_prezero(prezero_count);
+			shim_advance_time(prezero_interval_ms);
+			next += interval;
+		}
+
+		nr_pftrace++;
+		if (!pftrace_wants_zeroed_huge_page(t))
+			continue;
+
+		used++;
+		pf_huge++;
+		if (shim_take_huge_page(0, &zeroed) && zeroed)
+			pf_huge_zeroed++;
+	}
+
+	free(traces);
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void report(void)
+{
+	u64 total = 0;
+	char buf[4096];
+	int i;
+
+	printf("%-16s %12s %12s %20s\n", "action", "decisions", "yes",
+	       "predicted_savings");
+	for (i = 0; i < RA_NR; i++) {
+		printf("%-16s %12llu %12llu %20lld\n", replay_action_names[i],
+		       stats[i].decisions, stats[i].yes, stats[i].savings);
+		total += stats[i].decisions;
+	}
+
+	printf("\nevents=%llu pftrace_records=%llu\n", nr_events, nr_pftrace);
+	printf("huge_pages_placed=%llu remote=%llu zeroed=%llu no_memory=%llu\n",
+	       hp_placed, hp_placed_remote, hp_placed_zeroed, hp_no_memory);
+	printf("eager_bytes=%llu\n", eager_bytes);
+	if (nr_pftrace)
+		printf("pftrace_huge_faults=%llu prezeroed=%llu\n", pf_huge,
+		       pf_huge_zeroed);
+	printf("cost: n=%llu mean=%llu max=%llu\n", mm_econ_cost.count,
+	       mm_econ_cost.count ? mm_econ_cost.sum / mm_econ_cost.count : 0,
+	       mm_econ_cost.max);
+	printf("benefit: n=%llu mean=%llu max=%llu\n", mm_econ_benefit.count,
+	       mm_econ_benefit.count ?
+	       mm_econ_benefit.sum / mm_econ_benefit.count : 0,
+	       mm_econ_benefit.max);
+
+	printf("\ndecisions=%llu time=%lluns", total, decide_ns);
+	if (decide_ns)
+		printf(" throughput=%.0f/s", total * 1e9 / decide_ns);
+	printf("\n");
+
+	if (shim_sysfs_read("stats", buf) > 0)
+		printf("\nmm_econ stats:\n%s", buf);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-v] [-f freq_mhz] [-k kbadgerd_results] [-p pftrace]\n"
+		"          [-i prezero_interval_ms] [-c prezero_count] [events]\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	const char *kbadgerd = NULL, *pftrace = NULL;
+	char buf[32];
+	int opt, ret;
+
+	while ((opt = getopt(argc, argv, "vf:k:p:i:c:")) != -1) {
+		switch (opt) {
+		case 'v':
+			shim_verbose = 1;
+			break;
+		case 'f':
+			freq_mhz = strtoull(optarg, NULL, 0);
+			break;
+		case 'k':
+			kbadgerd = optarg;
+			break;
+		case 'p':
+			pftrace = optarg;
+			break;
+		case 'i':
+			prezero_interval_ms = strtoull(optarg, NULL, 0);
+			break;
+		case 'c':
+			prezero_count = strtoull(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (optind + 1 < argc || (optind == argc && !pftrace))
+		usage(argv[0]);
+
+	ret = shim_init();
+	if (ret) {
+		fprintf(stderr, "mm_econ init failed: %d\n", ret);
+		return 1;
+	}
+
+	snprintf(buf, sizeof(buf), "%llu", freq_mhz);
+	shim_sysfs_write("freq_mhz", buf);
+	/* Replays are about what the estimator would do, so turn it on. */
+	shim_sysfs_write("enabled", "1");
+
+	if (kbadgerd && load_kbadgerd_results(kbadgerd))
+		return 1;
+	if (optind < argc && replay_events(argv[optind]))
+		return 1;
+	if (pftrace && replay_pftrace(pftrace))
+		return 1;
+
+	report();
+	return 0;
+}
@@ -0,0 +1,340 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Simulated kernel environment for running mm/estimator.c in userspace.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <linux/mm.h>
+#include <linux/kobject.h>
+#include <linux/fs.h>
+#include <linux/sched/loadavg.h>
+#include <linux/zone_lock_stat.h>
+#include <linux/jiffies.h>
+
+#include "shim.h"
+
+int shim_verbose;
+
+struct task_struct shim_current = { .pid = 1, .tgid = 1 };
+int shim_numa_node;
+int shim_nr_cpus = 1;
+unsigned long jiffies;
+static unsigned long shim_nr_running;
+static u64 shim_prezeroed_used;
+
+pg_data_t shim_nodes[MAX_NUMNODES];
+int shim_nr_nodes;
+int shim_node_distance[MAX_NUMNODES][MAX_NUMNODES];
+
+/*
+ * Each node has one populated zone with all of its free huge pages on the
+ * order-9 movable list. The estimator only looks at the tail page of the
+ * list, so a single page stands in for all of them and is marked zeroed if
+ * any are.
+ */
+static struct page shim_free_page[MAX_NUMNODES];
+static unsigned long shim_nr_zeroed[MAX_NUMNODES];
+
+#define SHIM_HUGE_PAGE_ORDER 9
+#define SHIM_DEFAULT_MANAGED_PAGES (16UL << (30 - PAGE_SHIFT))
+
+struct mm_hist mm_econ_cost;
+struct mm_hist mm_econ_benefit;
+
+static struct kobject shim_mm_kobj = { .name = "mm" };
+struct kobject *mm_kobj = &shim_mm_kobj;
+static struct kobject shim_mm_econ_kobj;
+
+extern int (*shim_initcall)(void);
+
+///////////////////////////////////////////////////////////////////////////////
+// Kernel functions used by the estimator.
+
+void *vmalloc(unsigned long size)
+{
+	return malloc(size);
+}
+
+void vfree(const void *addr)
+{
+	free((void *)addr);
+}
+
+void mm_stats_hist_measure(struct mm_hist *hist, u64 val)
+{
+	hist->count++;
+	hist->sum += val;
+	if (val > hist->max)
+		hist->max = val;
+}
+
+void get_avenrun(unsigned long *loads, unsigned long offset, int shift)
+{
+	loads[0] = loads[1] = loads[2] = (shim_nr_running << FSHIFT) + offset;
+}
+
+u64 mm_estimated_prezeroed_used(void)
+{
+	return shim_prezeroed_used;
+}
+
+void zone_lock_window_read(struct zone *zone, struct zone_lock_load *load)
+{
+	*load = zone->lock_window.load;
+}
+
+struct zone *shim_next_populated_zone(struct zone *zone)
+{
+	int nid = zone ? zone->zone_pgdat->node_id : 0;
+	int idx = zone ? zone_idx(zone) + 1 : 0;
+
+	for (; nid < shim_nr_nodes; nid++, idx = 0)
+		for (; idx < MAX_NR_ZONES; idx++)
+			if (shim_nodes[nid].node_zones[idx].populated)
+				return &shim_nodes[nid].node_zones[idx];
+
+	return NULL;
+}
+
+struct task_struct *extern_get_proc_task(const struct inode *inode)
+{
+	static struct task_struct task;
+
+	task.pid = task.tgid = inode->pid;
+	return &task;
+}
+
+loff_t default_llseek(struct file *file, loff_t offset, int whence)
+{
+	return -EINVAL;
+}
+
+ssize_t simple_read_from_buffer(void __user *to, size_t count, loff_t *ppos,
+				const void *from, size_t available)
+{
+	loff_t pos = *ppos;
+
+	if (pos < 0)
+		return -EINVAL;
+	if (pos >= available || !count)
+		return 0;
+	if (count > available - pos)
+		count = available - pos;
+	memcpy(to, from + pos, count);
+	*ppos = pos + count;
+	return count;
+}
+
+struct kobject *kobject_create_and_add(const char *name, struct kobject *parent)
+{
+	shim_mm_econ_kobj.name = name;
+	return &shim_mm_econ_kobj;
+}
+
+void kobject_put(struct kobject *kobj)
+{
+}
+
+int sysfs_create_group(struct kobject *kobj, const struct attribute_group *grp)
+{
+	kobj->group = grp;
+	return 0;
+}
+
+bool sysfs_streq(const char *s1, const char *s2)
+{
+	size_t n1 = strcspn(s1, "\n"), n2 = strcspn(s2, "\n");
+
+	return n1 == n2 && !strncmp(s1, s2, n1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Harness interface.
+
+int shim_init(void)
+{
+	shim_set_nr_nodes(1);
+	return shim_initcall();
+}
+
+void shim_set_nr_nodes(int nr_nodes)
+{
+	int nid, other, order, mt;
+
+	BUG_ON(nr_nodes < 1 || nr_nodes > MAX_NUMNODES);
+
+	shim_nr_nodes = nr_nodes;
+	for (nid = 0; nid < nr_nodes; nid++) {
+		pg_data_t *pgdat = &shim_nodes[nid];
+		struct zone *zone = &pgdat->node_zones[ZONE_NORMAL];
+
+		memset(pgdat, 0, sizeof(*pgdat));
+		pgdat->node_id = nid;
+		for (mt = 0; mt < MAX_NR_ZONES; mt++)
+			pgdat->node_zones[mt].zone_pgdat = pgdat;
+
+		zone->name = "Normal";
+		zone->populated = true;
+		zone->managed_pages = SHIM_DEFAULT_MANAGED_PAGES;
+		for (order = 0; order < MAX_ORDER; order++)
+			for (mt = 0; mt < MIGRATE_TYPES; mt++)
+				INIT_LIST_HEAD(&zone->free_area[order].free_list[mt]);
+
+		INIT_LIST_HEAD(&shim_free_page[nid].lru);
+		shim_free_page[nid].flags = 0;
+		shim_nr_zeroed[nid] = 0;
+
+		for (other = 0; other < MAX_NUMNODES; other++)
+			shim_node_distance[nid][other] =
+				nid == other ? LOCAL_DISTANCE : REMOTE_DISTANCE;
+	}
+
+	if (shim_numa_node >= nr_nodes)
+		shim_numa_node = 0;
+}
+
+void shim_set_node_distance(int from, int to, int distance)
+{
+	BUG_ON(from >= shim_nr_nodes || to >= shim_nr_nodes);
+	shim_node_distance[from][to] = distance;
+}
+
+void shim_set_free_huge_pages(int nid, unsigned long nr_free,
+			      unsigned long nr_zeroed)
+{
+	struct free_area *area;
+	struct page *page = &shim_free_page[nid];
+
+	BUG_ON(nid >= shim_nr_nodes || nr_zeroed > nr_free);
+
+	area = &shim_nodes[nid].node_zones[ZONE_NORMAL]
+		.free_area[SHIM_HUGE_PAGE_ORDER];
+	area->nr_free = nr_free;
+	shim_nr_zeroed[nid] = nr_zeroed;
+
+	list_del_init(&page->lru);
+	if (nr_free)
+		list_add(&page->lru, &area->free_list[MIGRATE_MOVABLE]);
+	if (nr_zeroed)
+		SetPageZeroed(page);
+	else
+		ClearPageZeroed(page);
+}
+
+void shim_get_free_huge_pages(int nid, unsigned long *nr_free,
+			      unsigned long *nr_zeroed)
+{
+	*nr_free = shim_nodes[nid].node_zones[ZONE_NORMAL]
+		.free_area[SHIM_HUGE_PAGE_ORDER].nr_free;
+	*nr_zeroed = shim_nr_zeroed[nid];
+}
+
+void shim_set_managed_pages(int nid, unsigned long nr_pages)
+{
+	BUG_ON(nid >= shim_nr_nodes);
+	shim_nodes[nid].node_zones[ZONE_NORMAL].managed_pages = nr_pages;
+}
+
+bool shim_take_huge_page(int nid, bool *zeroed)
+{
+	unsigned long nr_free, nr_zeroed;
+
+	shim_get_free_huge_pages(nid, &nr_free, &nr_zeroed);
+	if (!nr_free)
+		return false;
+
+	*zeroed = nr_zeroed > 0;
+	shim_set_free_huge_pages(nid, nr_free - 1,
+				 nr_zeroed ? nr_zeroed - 1 : 0);
+	return true;
+}
+
+void shim_set_zone_lock(int nid, unsigned int hold_permille,
+			u64 avg_hold_cycles, u64 avg_wait_cycles)
+{
+	struct zone_lock_load *load;
+
+	BUG_ON(nid >= shim_nr_nodes);
+
+	load = &shim_nodes[nid].node_zones[ZONE_NORMAL].lock_window.load;
+	load->hold_permille = hold_permille;
+	load->avg_hold_cycles = avg_hold_cycles;
+	load->avg_wait_cycles = avg_wait_cycles;
+}
+
+void shim_set_load(int nr_cpus, unsigned long nr_running)
+{
+	shim_nr_cpus = nr_cpus;
+	shim_nr_running = nr_running;
+}
+
+void shim_set_prezeroed_used(u64 pages_per_ltu)
+{
+	shim_prezeroed_used = pages_per_ltu;
+}
+
+void shim_advance_time(unsigned long ms)
+{
+	jiffies += msecs_to_jiffies(ms);
+}
+
+void shim_set_current(pid_t tgid, int nid)
+{
+	shim_current.pid = shim_current.tgid = tgid;
+	if (nid >= 0 && nid < shim_nr_nodes)
+		shim_numa_node = nid;
+}
+
+static struct kobj_attribute *shim_find_attr(const char *name)
+{
+	struct attribute **attr;
+
+	if (!shim_mm_econ_kobj.group)
+		return NULL;
+
+	for (attr = shim_mm_econ_kobj.group->attrs; *attr; attr++)
+		if (!strcmp((*attr)->name, name))
+			return container_of(*attr, struct kobj_attribute, attr);
+
+	return NULL;
+}
+
+ssize_t shim_sysfs_write(const char *name, const char *val)
+{
+	struct kobj_attribute *attr = shim_find_attr(name);
+
+	if (!attr || !attr->store)
+		return -ENOENT;
+
+	return attr->store(&shim_mm_econ_kobj, attr, val, strlen(val));
+}
+
+ssize_t shim_sysfs_read(const char *name, char *buf)
+{
+	struct kobj_attribute *attr = shim_find_attr(name);
+
+	if (!attr || !attr->show)
+		return -ENOENT;
+
+	return attr->show(&shim_mm_econ_kobj, attr, buf);
+}
+
+ssize_t shim_proc_write(const struct file_operations *fops, pid_t pid,
+			const char *buf, size_t count)
+{
+	struct inode inode = { .pid = pid };
+	struct file file = { .f_inode = &inode };
+	loff_t pos = 0;
+
+	return fops->write(&file, buf, count, &pos);
+}
+
+ssize_t shim_proc_read(const struct file_operations *fops, pid_t pid,
+		       char *buf, size_t count)
+{
+	struct inode inode = { .pid = pid };
+	struct file file = { .f_inode = &inode };
+	loff_t pos = 0;
+
+	return fops->read(&file, buf, count, &pos);
+}
@@ -0,0 +1,59 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _MM_ECON_SHIM_H
+#define _MM_ECON_SHIM_H
+
+/*
+ * Interface to the simulated kernel that mm/estimator.c runs against in
+ * userspace. The estimator itself is used unmodified; everything it would
+ * normally read from the running system (free huge pages, NUMA distances,
+ * zone->lock load, load average, the current task) comes from here.
+ */
+
+#include <sys/types.h>
+#include <linux/types.h>
+#include <linux/fs.h>
+#include <linux/mm_econ.h>
+#include <linux/mm_stats.h>
+
+extern int shim_verbose;
+
+/* Runs mm_econ's initcall. Must be called before anything else. */
+int shim_init(void);
+
+/* Machine state. Nodes default to REMOTE_DISTANCE from each other. */
+void shim_set_nr_nodes(int nr_nodes);
+void shim_set_node_distance(int from, int to, int distance);
+void shim_set_free_huge_pages(int nid, unsigned long nr_free,
+			      unsigned long nr_zeroed);
+void shim_get_free_huge_pages(int nid, unsigned long *nr_free,
+			      unsigned long *nr_zeroed);
+/* Total pages on a node, used for gigantic page estimates. Default 16GB. */
+void shim_set_managed_pages(int nid, unsigned long nr_pages);
+/* Take one free huge page from nid, zeroed first. False if there are none. */
+bool shim_take_huge_page(int nid, bool *zeroed);
+void shim_set_zone_lock(int nid, unsigned int hold_permille,
+			u64 avg_hold_cycles, u64 avg_wait_cycles);
+void shim_set_load(int nr_cpus, unsigned long nr_running);
+/* Value returned by mm_estimated_prezeroed_used(). */
+void shim_set_prezeroed_used(u64 pages_per_ltu);
+
+/* Advance simulated time (jiffies). Time only moves when this is called. */
+void shim_advance_time(unsigned long ms);
+
+/* The task and CPU node subsequent estimates are made for. */
+void shim_set_current(pid_t tgid, int nid);
+
+/* /sys/kernel/mm/mm_econ/<name>. Return the show/store result. */
+ssize_t shim_sysfs_write(const char *name, const char *val);
+ssize_t shim_sysfs_read(const char *name, char *buf);
+
+/* Reads and writes of /proc/<pid>/<file> with the given fops. */
+ssize_t shim_proc_write(const struct file_operations *fops, pid_t pid,
+			const char *buf, size_t count);
+ssize_t shim_proc_read(const struct file_operations *fops, pid_t pid,
+		       char *buf, size_t count);
+
+extern struct mm_hist mm_econ_cost;
+extern struct mm_hist mm_econ_benefit;
+
+#endif /* _MM_ECON_SHIM_H */
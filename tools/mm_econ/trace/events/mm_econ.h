@@ -0,0 +1,18 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _MM_ECON_SHIM_TRACE_MM_ECON_H
+#define _MM_ECON_SHIM_TRACE_MM_ECON_H
+
+#include <linux/mm_econ.h>
+
+static inline void trace_mm_econ_estimate(const struct mm_action *action,
+					  const struct mm_cost_delta *cost)
+{
+}
+
+static inline void trace_mm_econ_decide(const struct mm_action *action,
+					const struct mm_cost_delta *cost,
+					int mode, bool decision)
+{
+}
+
+#endif /* _MM_ECON_SHIM_TRACE_MM_ECON_H */